@@ -0,0 +1,46 @@
+# Generates a random program of byte codes in stdout, used as training corpus
+# of the profile guided build. It must run with LC_ALL=C, so every byte is
+# printed as is. Variables (given with -v):
+#   seed: seed of the generator (default 1)
+#   statements: quantity of statements of the program (default 1000)
+#   variables: quantity of variables N the program runs with (default 16)
+#   chains: quantity of independent computations (default 1). The statement i
+#     only uses variables v with v % chains == i % chains, so each computation
+#     keeps to its own variables
+# Every statement loads a variable or pushes a constant, combines it with a
+# positive constant (so no division is by zero) and stores it, as in:
+#   iload 3; bipush 7; imul; istore 5
+
+function emit(byte) {
+	printf "%c", byte
+}
+
+# Returns a random variable of the computation of the statement i
+function variable(i) {
+	if (chains == 1) return int(rand() * variables)
+	return i % chains + chains * int(rand() * int(variables / chains))
+}
+
+BEGIN {
+	ISTORE = 54; ILOAD = 21; BIPUSH = 16; DUP = 89; INEG = 116
+	split("96 100 104 108 112 126 128 130", operations, " ")
+	if (seed == "") seed = 1
+	if (statements == "") statements = 1000
+	if (variables == "") variables = 16
+	if (chains == "") chains = 1
+	srand(seed)
+	for (i = 0; i < statements; i++) {
+		if (rand() < 0.75) {
+			emit(ILOAD); emit(variable(i))
+		} else {
+			emit(BIPUSH); emit(int(rand() * 256))
+		}
+		if (rand() < 0.2) {
+			emit(DUP); emit(INEG)
+			emit(operations[1 + int(rand() * 3)])
+		}
+		emit(BIPUSH); emit(1 + int(rand() * 127))
+		emit(operations[1 + int(rand() * 8)])
+		emit(ISTORE); emit(variable(i))
+	}
+}
@@ -0,0 +1,86 @@
+#include <string.h>
+
+#include "hdr_histogram.h"
+
+#define HALF_SUB_BUCKETS (HDR_HISTOGRAM_SUB_BUCKETS / 2)
+// Bit length of the values counted exactly
+#define SUB_BUCKET_BITS 7
+#define VALUE_BITS 64
+#define HUNDRED 100.0
+
+/**
+ * Static function that returns the position of the counter of {@param value}.
+ * A value of the range [2^k, 2^(k+1)) (with k >= 7) is shifted right k - 6
+ * bits, keeping its 7 most significant ones
+ */
+static int index_of(uint64_t value) {
+	if (value < HDR_HISTOGRAM_SUB_BUCKETS) {
+		return (int) value;
+	}
+	int shift = VALUE_BITS - __builtin_clzll(value) - SUB_BUCKET_BITS;
+	int sub_bucket = (int) (value >> shift);
+	return HDR_HISTOGRAM_SUB_BUCKETS + (shift - 1) * HALF_SUB_BUCKETS +
+		   (sub_bucket - HALF_SUB_BUCKETS);
+}
+
+/**
+ * Static function that returns the greatest value counted at {@param index}
+ */
+static uint64_t highest_of(int index) {
+	if (index < HDR_HISTOGRAM_SUB_BUCKETS) {
+		return (uint64_t) index;
+	}
+	int shift = (index - HDR_HISTOGRAM_SUB_BUCKETS) / HALF_SUB_BUCKETS + 1;
+	uint64_t sub_bucket = (uint64_t) ((index - HDR_HISTOGRAM_SUB_BUCKETS) %
+									  HALF_SUB_BUCKETS + HALF_SUB_BUCKETS);
+	return ((sub_bucket + 1) << shift) - 1;
+}
+
+void hdr_histogram_init(hdr_histogram *self) {
+	memset(self, 0, sizeof(hdr_histogram));
+	self->min = UINT64_MAX;
+}
+
+void hdr_histogram_record(hdr_histogram *self, uint64_t value) {
+	// The greatest bucket holds up to 2^63 - 1
+	if (value > INT64_MAX) {
+		value = INT64_MAX;
+	}
+	self->_counts[index_of(value)]++;
+	self->count++;
+	self->sum += (double) value;
+	self->min = (value < self->min) ? value : self->min;
+	self->max = (value > self->max) ? value : self->max;
+}
+
+void hdr_histogram_merge(hdr_histogram *self, const hdr_histogram *other) {
+	for (int i = 0; i < HDR_HISTOGRAM_BUCKETS; i++) {
+		self->_counts[i] += other->_counts[i];
+	}
+	self->count += other->count;
+	self->sum += other->sum;
+	self->min = (other->min < self->min) ? other->min : self->min;
+	self->max = (other->max > self->max) ? other->max : self->max;
+}
+
+uint64_t hdr_histogram_percentile(const hdr_histogram *self,
+								  double percentile) {
+	if (self->count == 0) {
+		return 0;
+	}
+	// The rank of the value, from 1 to count
+	uint64_t rank = (uint64_t) (percentile / HUNDRED * (double) self->count);
+	if ((double) rank < percentile / HUNDRED * (double) self->count) {
+		rank++;
+	}
+	rank = (rank == 0) ? 1 : rank;
+	uint64_t seen = 0;
+	for (int i = 0; i < HDR_HISTOGRAM_BUCKETS; i++) {
+		seen += self->_counts[i];
+		if (seen >= rank) {
+			uint64_t highest = highest_of(i);
+			return (highest < self->max) ? highest : self->max;
+		}
+	}
+	return self->max;
+}
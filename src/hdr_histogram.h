@@ -0,0 +1,53 @@
+#ifndef __HDR_HISTOGRAM_H__
+#define __HDR_HISTOGRAM_H__
+
+#include <stdint.h>
+
+// Values below it are counted exactly
+#define HDR_HISTOGRAM_SUB_BUCKETS 128
+// Values from HDR_HISTOGRAM_SUB_BUCKETS on, split in 56 ranges doubling the
+// previous one, with half of the sub buckets each
+#define HDR_HISTOGRAM_BUCKETS (HDR_HISTOGRAM_SUB_BUCKETS + \
+							   56 * HDR_HISTOGRAM_SUB_BUCKETS / 2)
+
+/**
+ * High dynamic range histogram of non negative values: every value up to
+ * 2^63 is counted within a relative error below 1/64 (about 1.6%), so the
+ * high percentiles of latencies spanning microseconds to minutes are kept
+ * without storing the values
+ *          - count: quantity of values recorded
+ *          - min, max: the smallest and the greatest value recorded, exact
+ *          - sum: the sum of the values recorded
+ */
+typedef struct hdr_histogram {
+	uint64_t count;
+	uint64_t min;
+	uint64_t max;
+	double sum;
+	uint64_t _counts[HDR_HISTOGRAM_BUCKETS];
+} hdr_histogram;
+
+/**
+ * Initializes the {@param self} with no values
+ */
+void hdr_histogram_init(hdr_histogram *self);
+
+/**
+ * Records the {@param value} in {@param self}
+ */
+void hdr_histogram_record(hdr_histogram *self, uint64_t value);
+
+/**
+ * Adds the values recorded in {@param other} to {@param self}
+ */
+void hdr_histogram_merge(hdr_histogram *self, const hdr_histogram *other);
+
+/**
+ * Returns the value below or equal to which the {@param percentile} (between
+ * 0 and 100) of the values of {@param self} are, as the greatest value
+ * counted along with it (0 if there are no values)
+ */
+uint64_t hdr_histogram_percentile(const hdr_histogram *self,
+								  double percentile);
+
+#endif //__HDR_HISTOGRAM_H__
@@ -0,0 +1,62 @@
+#include <string.h>
+
+#include "hex_dump.h"
+
+// Characters written for each value: 8 digits and the new line
+#define HEX_DUMP_LINE 9
+// Quantity of values formatted before writing the buffer
+#define HEX_DUMP_BLOCK 4096
+
+#define HEX_ROW(h) h "0" h "1" h "2" h "3" h "4" h "5" h "6" h "7" \
+				   h "8" h "9" h "a" h "b" h "c" h "d" h "e" h "f"
+
+// The 2 digits of every byte, so each value is formatted with 4 lookups
+static const char HEX_PAIRS[] =
+		HEX_ROW("0") HEX_ROW("1") HEX_ROW("2") HEX_ROW("3")
+		HEX_ROW("4") HEX_ROW("5") HEX_ROW("6") HEX_ROW("7")
+		HEX_ROW("8") HEX_ROW("9") HEX_ROW("a") HEX_ROW("b")
+		HEX_ROW("c") HEX_ROW("d") HEX_ROW("e") HEX_ROW("f");
+
+static void format_value(char *line, unsigned int value) {
+	memcpy(&line[0], &HEX_PAIRS[2 * (value >> 24)], 2);
+	memcpy(&line[2], &HEX_PAIRS[2 * ((value >> 16) & 0xFF)], 2);
+	memcpy(&line[4], &HEX_PAIRS[2 * ((value >> 8) & 0xFF)], 2);
+	memcpy(&line[6], &HEX_PAIRS[2 * (value & 0xFF)], 2);
+	line[8] = '\n';
+}
+
+int hex_dump_write(FILE *out, const int *values, long count) {
+	char buffer[HEX_DUMP_BLOCK * HEX_DUMP_LINE];
+	for (long done = 0; done < count; done += HEX_DUMP_BLOCK) {
+		long quantity = (count - done < HEX_DUMP_BLOCK) ? count - done
+														: HEX_DUMP_BLOCK;
+		for (long i = 0; i < quantity; i++) {
+			format_value(&buffer[i * HEX_DUMP_LINE],
+						 (unsigned int) values[done + i]);
+		}
+		size_t length = (size_t) quantity * HEX_DUMP_LINE;
+		if (fwrite(buffer, 1, length, out) != length) {
+			return EOF;
+		}
+	}
+	return 0;
+}
+
+int hex_dump_write_zeros(FILE *out, long count) {
+	static const char ZERO[HEX_DUMP_LINE] = "00000000\n";
+	char buffer[HEX_DUMP_BLOCK * HEX_DUMP_LINE];
+	long quantity = (count < HEX_DUMP_BLOCK) ? count : HEX_DUMP_BLOCK;
+	for (long i = 0; i < quantity; i++) {
+		memcpy(&buffer[i * HEX_DUMP_LINE], ZERO, HEX_DUMP_LINE);
+	}
+	// The same block is written as many times as needed
+	for (long done = 0; done < count; done += quantity) {
+		size_t length = (size_t) ((count - done < quantity) ? count - done
+															: quantity) *
+						HEX_DUMP_LINE;
+		if (fwrite(buffer, 1, length, out) != length) {
+			return EOF;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,22 @@
+#ifndef __HEX_DUMP_H__
+#define __HEX_DUMP_H__
+
+#include <stdio.h>
+
+/**
+ * Function that writes the {@param count} {@param values} in {@param out}, each
+ * one of them as an hexadecimal number of 8 lowercase digits followed by a new
+ * line. The output is the same than printing them with "%08x\n", but they are
+ * formatted through a table into a large buffer written with few syscalls
+ * @return 0 on success or EOF if {@param out} failed
+ */
+int hex_dump_write(FILE *out, const int *values, long count);
+
+/**
+ * Function that writes {@param count} zeros in {@param out} with the same
+ * format than {@link hex_dump_write}, without formatting them one by one
+ * @return 0 on success or EOF if {@param out} failed
+ */
+int hex_dump_write_zeros(FILE *out, long count);
+
+#endif //__HEX_DUMP_H__
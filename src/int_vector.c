@@ -1,22 +1,95 @@
+#define _DEFAULT_SOURCE
+
+#include <sys/mman.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "int_vector.h"
+#include "hex_dump.h"
+
+// Vectors from this size (in bytes) on are mapped instead of allocated
+#define INT_VECTOR_MAP_THRESHOLD (256 * 1024)
+
+static size_t pages_quantity(int size) {
+	return ((size_t) size + INT_VECTOR_PAGE - 1) / INT_VECTOR_PAGE;
+}
+
+static bool page_touched(const int_vector *v, size_t page) {
+	return (v->_touched[page / 64] >> (page % 64)) & 1;
+}
+
+/**
+ * Static function that allocates the bitmap with every page untouched
+ */
+static operation_result create_bitmap(int_vector *v) {
+	v->_touched = calloc((pages_quantity(v->_size) + 63) / 64 + 1,
+						 sizeof(uint64_t));
+	return v->_touched ? OPERATION_SUCCESS : OPERATION_FAILURE_NO_MEMORY;
+}
 
 operation_result int_vector_create(int_vector *v, int size) {
-	v->_data = malloc(size * sizeof(int));
+	if (size < 0)
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	size_t bytes = (size_t) size * sizeof(int);
 	v->_size = size;
-	if (v->_data) {
-		for (int pos = 0; pos < size; pos++) {
-			int_vector_set(v, pos, 0);
-		}
-		return OPERATION_SUCCESS;
+	v->_owned = true;
+	v->_mapped = 0;
+	if (bytes >= INT_VECTOR_MAP_THRESHOLD) {
+		// The pages aren't committed until written, so zeroing them is free
+		void *data = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+						  MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		v->_data = (data == MAP_FAILED) ? NULL : (int *) data;
+		v->_mapped = v->_data ? bytes : 0;
 	} else {
+		v->_data = calloc(size > 0 ? (size_t) size : 1, sizeof(int));
+	}
+	if (!v->_data) {
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
+	if (create_bitmap(v) != OPERATION_SUCCESS) {
+		int_vector_destroy(v);
 		return OPERATION_FAILURE_NO_MEMORY;
 	}
+	return OPERATION_SUCCESS;
+}
+
+operation_result int_vector_attach(int_vector *v, int *data, int size) {
+	if (!data)
+		return OPERATION_FAILURE_NULL_POINTER;
+	v->_data = data;
+	v->_size = size;
+	v->_owned = false;
+	v->_mapped = 0;
+	memset(data, 0, size * sizeof(int));
+	return create_bitmap(v);
+}
+
+operation_result int_vector_map_file(int_vector *v, int fd, long offset,
+									 int size, const uint64_t *touched) {
+	if (size < 0 || offset < 0)
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	if (size == 0)
+		return int_vector_create(v, 0);
+	size_t bytes = (size_t) size * sizeof(int);
+	void *data = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd,
+					  (off_t) offset);
+	if (data == MAP_FAILED)
+		return OPERATION_FAILURE_NO_MEMORY;
+	v->_data = (int *) data;
+	v->_size = size;
+	v->_owned = true;
+	v->_mapped = bytes;
+	if (create_bitmap(v) != OPERATION_SUCCESS) {
+		int_vector_destroy(v);
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
+	memcpy(v->_touched, touched,
+		   (pages_quantity(size) + 63) / 64 * sizeof(uint64_t));
+	return OPERATION_SUCCESS;
 }
 
 int int_vector_get(const int_vector *v, int pos) {
-	return v->_data[pos];
+	return (pos >= v->_size || pos < 0) ? 0 : v->_data[pos];
 }
 
 operation_result int_vector_set(int_vector *v, int pos, int src) {
@@ -24,11 +97,18 @@ operation_result int_vector_set(int_vector *v, int pos, int src) {
 		return OPERATION_FAILURE_OUT_OF_BOUNDS;
 	} else {
 		v->_data[pos] = src;
+		size_t page = (size_t) pos / INT_VECTOR_PAGE;
+		uint64_t bit = (uint64_t) 1 << (page % 64);
+		// A written page is only read, so threads storing different
+		// variables of it don't write the same word
+		if (!(v->_touched[page / 64] & bit)) {
+			v->_touched[page / 64] |= bit;
+		}
 		return OPERATION_SUCCESS;
 	}
 }
 
-int int_vector_size(int_vector *v) {
+int int_vector_size(const int_vector *v) {
 	if (!v) {
 		return -1;
 	} else {
@@ -36,12 +116,52 @@ int int_vector_size(int_vector *v) {
 	}
 }
 
+const int *int_vector_data(const int_vector *v) {
+	return v->_data;
+}
+
+const uint64_t *int_vector_touched(const int_vector *v, size_t *words) {
+	*words = (pages_quantity(v->_size) + 63) / 64;
+	return v->_touched;
+}
+
+int int_vector_run(const int_vector *v, int from, bool *touched) {
+	size_t pages = pages_quantity(v->_size);
+	size_t page = (size_t) from / INT_VECTOR_PAGE;
+	*touched = page_touched(v, page);
+	uint64_t same_word = *touched ? UINT64_MAX : 0;
+	page++;
+	while (page < pages) {
+		if (page % 64 == 0 && v->_touched[page / 64] == same_word) {
+			// The 64 pages of the word belong to the run
+			page += 64;
+		} else if (page_touched(v, page) == *touched) {
+			page++;
+		} else {
+			break;
+		}
+	}
+	return (page >= pages) ? v->_size : (int) (page * INT_VECTOR_PAGE);
+}
+
 void int_vector_destroy(int_vector *v) {
-	free(v->_data);
+	if (v->_owned && v->_mapped) {
+		munmap(v->_data, v->_mapped);
+	} else if (v->_owned) {
+		free(v->_data);
+	}
+	free(v->_touched);
 }
 
 void int_vector_print_elements(int_vector *vec, FILE* out) {
-	for (int i = 0; i < vec->_size; i++) {
-		fprintf(out, "%08x\n", int_vector_get(vec, i));
+	for (int from = 0; from < vec->_size;) {
+		bool touched;
+		int to = int_vector_run(vec, from, &touched);
+		if (touched) {
+			hex_dump_write(out, &vec->_data[from], to - from);
+		} else {
+			hex_dump_write_zeros(out, to - from);
+		}
+		from = to;
 	}
 }
@@ -2,11 +2,25 @@
 #define __INT_VECTOR_H__
 
 #include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
 #include "result.h"
 
+// Quantity of ints in each page tracked by the vector
+#define INT_VECTOR_PAGE 1024
+
+/**
+ * Vector of ints whose pages are materialized lazily: large vectors are backed
+ * by an anonymous mapping, so the kernel provides zeroed pages only when they
+ * are written. A bitmap records the pages written through {@link
+ * int_vector_set}, every other page holds only zeros
+ */
 typedef struct int_vector {
 	int *_data;
 	int _size;
+	bool _owned;
+	size_t _mapped;
+	uint64_t *_touched;
 } int_vector;
 
 /**
@@ -17,12 +31,35 @@ typedef struct int_vector {
  */
 operation_result int_vector_create(int_vector *v, int size);
 
+/**
+ * Initializes the {@param v} over the {@param size} ints of {@param data}, which
+ * are set to zero. The memory keeps being owned by the caller, so the
+ * variables can live in a region shared with another process
+ * @pre    {@param v} pointer to int_vector already allocated
+ * @post   {@param v} pointer to int_vector ready to be used
+ * @return {@link operation_result} with the result of the operation
+ */
+operation_result int_vector_attach(int_vector *v, int *data, int size);
+
+/**
+ * Initializes the {@param v} over the {@param size} ints stored in the file
+ * {@param fd} from {@param offset}, which must be a multiple of the page size.
+ * The file is mapped privately: its pages are read only when accessed and the
+ * changes aren't written back. {@param touched} is the bitmap of the pages
+ * written, as returned by {@link int_vector_touched}
+ * @pre    {@param v} pointer to int_vector already allocated
+ * @post   {@param v} pointer to int_vector ready to be used
+ * @return {@link operation_result} with the result of the operation
+ */
+operation_result int_vector_map_file(int_vector *v, int fd, long offset,
+									 int size, const uint64_t *touched);
+
 /**
  * Gets an element from the vector {@param v} located in position {@param pos}
  * @param  pos starts from 0 until (_size - 1)
  * @pre    {@param v} pointer to int_vector ready to be used
  * @post   - The element from {@param v} located in position {@param pos} is retrieved and returned
- * @return {@link int} with the value
+ * @return {@link int} with the value, 0 for a position out of bounds
  */
 int int_vector_get(const int_vector *v, int pos);
 
@@ -36,16 +73,40 @@ int int_vector_get(const int_vector *v, int pos);
  */
 operation_result int_vector_set(int_vector *v, int pos, int src);
 
-int int_vector_size(int_vector *v);
+int int_vector_size(const int_vector *v);
+
+/**
+ * Returns the contiguous memory holding the elements of {@param v}, to be read
+ * in bulk
+ * @pre    {@param v} pointer to int_vector ready to be used
+ */
+const int *int_vector_data(const int_vector *v);
+
+/**
+ * Returns the bitmap of the pages of {@param v} written, a bit per page of
+ * INT_VECTOR_PAGE ints
+ * @post   {@param words} contains the quantity of words of the bitmap
+ */
+const uint64_t *int_vector_touched(const int_vector *v, size_t *words);
+
+/**
+ * Returns where the run of pages starting at the element {@param from} ends,
+ * being a run the consecutive pages that were all written or all untouched
+ * @pre    {@param v} pointer to int_vector ready to be used
+ * @post   {@param touched} is false if the elements of the run are all zero
+ * @return the position after the last element of the run
+ */
+int int_vector_run(const int_vector *v, int from, bool *touched);
 
 /**
  * Destroys the allocated memory in {@param v}
- * @post   the allocated memory is released in {@param v}
+ * @post   the allocated memory is released in {@param v}, unless it was attached
  */
 void int_vector_destroy(int_vector *v);
 
 /**
- * Function that prints the variables from the int_vector received as parameter
+ * Function that prints the variables from the int_vector received as parameter.
+ * The untouched pages are printed as zeros without reading them
  * @pre  {@param v} pointer to int_vector ready to be used
  * @return {@link operation_result} with the result of the operation
  */
@@ -0,0 +1,213 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "jvm_capture.h"
+#include "jvm_metrics.h"
+#include "jvm_protocol.h"
+
+#define CAPTURE_MAGIC "JVMR"
+#define CAPTURE_MAGIC_LENGTH 4
+#define CAPTURE_VERSION 1
+// A varint of 64 bits takes at most 10 bytes of 7 bits
+#define VARINT_MAX_BYTES 10
+#define VARINT_CONTINUATION 0x80
+#define VARINT_BITS 7
+
+static void write_varint(FILE *out, uint64_t value) {
+	while (value >= VARINT_CONTINUATION) {
+		fputc((int) (value & (VARINT_CONTINUATION - 1)) | VARINT_CONTINUATION,
+			  out);
+		value >>= VARINT_BITS;
+	}
+	fputc((int) value, out);
+}
+
+// Zigzag encoding keeps the small negative values small
+static void write_signed(FILE *out, int64_t value) {
+	write_varint(out, ((uint64_t) value << 1) ^ (uint64_t) (value >> 63));
+}
+
+static bool read_varint(FILE *in, uint64_t *value) {
+	*value = 0;
+	for (int i = 0; i < VARINT_MAX_BYTES; i++) {
+		int byte = fgetc(in);
+		if (byte == EOF) {
+			return false;
+		}
+		*value |= (uint64_t) (byte & (VARINT_CONTINUATION - 1)) <<
+				  (VARINT_BITS * i);
+		if (!(byte & VARINT_CONTINUATION)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool read_signed(FILE *in, int64_t *value) {
+	uint64_t encoded;
+	if (!read_varint(in, &encoded)) {
+		return false;
+	}
+	*value = (int64_t) (encoded >> 1) ^ -(int64_t) (encoded & 1);
+	return true;
+}
+
+operation_result jvm_capture_create(jvm_capture *self, const char *path) {
+	if (!self || !path)
+		return OPERATION_FAILURE_NULL_POINTER;
+	self->_file = fopen(path, "wb");
+	if (!self->_file)
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	fwrite(CAPTURE_MAGIC, 1, CAPTURE_MAGIC_LENGTH, self->_file);
+	write_varint(self->_file, CAPTURE_VERSION);
+	self->_started = jvm_metrics_now();
+	self->_last_arrival = 0;
+	pthread_mutex_init(&self->_lock, NULL);
+	return OPERATION_SUCCESS;
+}
+
+operation_result jvm_capture_record(jvm_capture *self,
+									const jvm_capture_entry *entry) {
+	int64_t arrival = (int64_t) ((entry->arrival - self->_started) * 1e6);
+	size_t session_length = entry->session ? strlen(entry->session) : 0;
+	pthread_mutex_lock(&self->_lock);
+	// Concurrent requests are recorded as they finish, so an arrival may be
+	// earlier than the previous one
+	write_signed(self->_file, arrival - self->_last_arrival);
+	self->_last_arrival = arrival;
+	write_varint(self->_file, (uint64_t) entry->protocol);
+	write_varint(self->_file, session_length);
+	if (session_length > 0) {
+		fwrite(entry->session, 1, session_length, self->_file);
+	}
+	write_signed(self->_file, entry->var_size);
+	write_varint(self->_file, (uint64_t) entry->program_length);
+	fwrite(entry->program, 1, (size_t) entry->program_length, self->_file);
+	write_signed(self->_file, entry->status);
+	write_varint(self->_file, (uint64_t) entry->variables_count);
+	for (int32_t i = 0; i < entry->variables_count; i++) {
+		write_signed(self->_file, entry->variables[i]);
+	}
+	bool failed = ferror(self->_file);
+	pthread_mutex_unlock(&self->_lock);
+	return failed ? OPERATION_FAILURE_CONNECTION_FAILED : OPERATION_SUCCESS;
+}
+
+operation_result jvm_capture_open(jvm_capture *self, const char *path) {
+	if (!self || !path)
+		return OPERATION_FAILURE_NULL_POINTER;
+	self->_file = fopen(path, "rb");
+	if (!self->_file)
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	char magic[CAPTURE_MAGIC_LENGTH];
+	uint64_t version;
+	if (fread(magic, 1, CAPTURE_MAGIC_LENGTH, self->_file) !=
+		CAPTURE_MAGIC_LENGTH ||
+		memcmp(magic, CAPTURE_MAGIC, CAPTURE_MAGIC_LENGTH) != 0 ||
+		!read_varint(self->_file, &version) || version != CAPTURE_VERSION) {
+		fclose(self->_file);
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	}
+	self->_started = 0;
+	self->_last_arrival = 0;
+	pthread_mutex_init(&self->_lock, NULL);
+	return OPERATION_SUCCESS;
+}
+
+/**
+ * Static function that reads the fields of the next request of {@param self}
+ * in {@param entry}, allocating its session, program and variables
+ * @return  true if the whole request was read
+ */
+static bool read_entry(jvm_capture *self, jvm_capture_entry *entry) {
+	int64_t arrival;
+	uint64_t protocol;
+	uint64_t session_length;
+	int64_t var_size;
+	uint64_t program_length;
+	int64_t status;
+	uint64_t variables_count;
+	if (!read_signed(self->_file, &arrival) ||
+		!read_varint(self->_file, &protocol) || protocol > JVM_CAPTURE_SHM ||
+		!read_varint(self->_file, &session_length) ||
+		session_length > PROTOCOL_MAX_SESSION_NAME) {
+		return false;
+	}
+	self->_last_arrival += arrival;
+	entry->arrival = (double) self->_last_arrival / 1e6;
+	entry->protocol = (jvm_capture_protocol) protocol;
+	if (session_length > 0) {
+		entry->session = (char *) malloc(session_length + 1);
+		if (!entry->session ||
+			fread(entry->session, 1, session_length, self->_file) !=
+			session_length) {
+			return false;
+		}
+		entry->session[session_length] = '\0';
+	}
+	if (!read_signed(self->_file, &var_size) ||
+		var_size < INT32_MIN || var_size > INT32_MAX ||
+		!read_varint(self->_file, &program_length) ||
+		program_length > INT32_MAX) {
+		return false;
+	}
+	entry->var_size = (int32_t) var_size;
+	entry->program_length = (long) program_length;
+	entry->program = (char *) malloc((size_t) program_length + 1);
+	if (!entry->program ||
+		fread(entry->program, 1, (size_t) program_length, self->_file) !=
+		program_length) {
+		return false;
+	}
+	if (!read_signed(self->_file, &status) ||
+		!read_varint(self->_file, &variables_count) ||
+		variables_count > INT32_MAX) {
+		return false;
+	}
+	entry->status = (operation_result) status;
+	entry->variables_count = (int32_t) variables_count;
+	entry->variables = (int *) malloc((size_t) variables_count * sizeof(int) +
+									  1);
+	if (!entry->variables) {
+		return false;
+	}
+	for (uint64_t i = 0; i < variables_count; i++) {
+		int64_t value;
+		if (!read_signed(self->_file, &value)) {
+			return false;
+		}
+		entry->variables[i] = (int) value;
+	}
+	return true;
+}
+
+operation_result jvm_capture_next(jvm_capture *self, jvm_capture_entry *entry,
+								  bool *end) {
+	memset(entry, 0, sizeof(jvm_capture_entry));
+	int next = fgetc(self->_file);
+	*end = next == EOF;
+	if (*end) {
+		return ferror(self->_file) ? OPERATION_FAILURE_CONNECTION_FAILED
+								   : OPERATION_SUCCESS;
+	}
+	ungetc(next, self->_file);
+	if (!read_entry(self, entry)) {
+		jvm_capture_entry_release(entry);
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	}
+	return OPERATION_SUCCESS;
+}
+
+void jvm_capture_entry_release(jvm_capture_entry *entry) {
+	free(entry->session);
+	free(entry->program);
+	free(entry->variables);
+	memset(entry, 0, sizeof(jvm_capture_entry));
+}
+
+operation_result jvm_capture_close(jvm_capture *self) {
+	int closed = fclose(self->_file);
+	pthread_mutex_destroy(&self->_lock);
+	return (closed == 0) ? OPERATION_SUCCESS
+						 : OPERATION_FAILURE_CONNECTION_FAILED;
+}
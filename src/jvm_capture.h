@@ -0,0 +1,103 @@
+#ifndef __JVM_CAPTURE_H__
+#define __JVM_CAPTURE_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "result.h"
+
+/**
+ * Protocol through which a captured request arrived, which decides how it's
+ * replayed
+ */
+typedef enum jvm_capture_protocol {
+	JVM_CAPTURE_LEGACY,
+	JVM_CAPTURE_FRAMED,
+	JVM_CAPTURE_SHM
+} jvm_capture_protocol;
+
+/**
+ * Request executed by the server, as stored in a capture:
+ *          - arrival: seconds since the capture started when it arrived
+ *          - protocol: {@link jvm_capture_protocol} of the request
+ *          - session: name of its session or NULL
+ *          - var_size: quantity of variables requested
+ *          - program, program_length: the byte_codes as they were received
+ *          - status: {@link operation_result} of its execution
+ *          - variables, variables_count: the variables once executed (all of
+ *            them, even if only a projection was sent back)
+ */
+typedef struct jvm_capture_entry {
+	double arrival;
+	jvm_capture_protocol protocol;
+	char *session;
+	int32_t var_size;
+	char *program;
+	long program_length;
+	operation_result status;
+	int *variables;
+	int32_t variables_count;
+} jvm_capture_entry;
+
+/**
+ * Capture file being written by the server or read by the replay. Every
+ * value is a variable length integer (signed ones zigzag encoded), so the
+ * small ones take a byte, and the arrivals are stored as the microseconds
+ * since the previous request
+ */
+typedef struct jvm_capture {
+	FILE *_file;
+	double _started;
+	int64_t _last_arrival;
+	pthread_mutex_t _lock;
+} jvm_capture;
+
+/**
+ * Creates the capture file {@param path} in {@param self}, replacing the
+ * previous one, taking the current time as the start of the capture
+ * @return  {@link operation_result} with the result of the operation
+ */
+operation_result jvm_capture_create(jvm_capture *self, const char *path);
+
+/**
+ * Records the request of the {@param entry} in {@param self}, whose arrival
+ * is given as the monotonic time of {@link jvm_metrics_now}. Many threads can
+ * record at once
+ * @return  {@link operation_result} with the result of the operation
+ */
+operation_result jvm_capture_record(jvm_capture *self,
+									const jvm_capture_entry *entry);
+
+/**
+ * Opens the capture file {@param path} in {@param self} to read its requests
+ * @return  {@link operation_result} with the result of the operation. A file
+ *          that isn't a capture of this version is an illegal argument
+ */
+operation_result jvm_capture_open(jvm_capture *self, const char *path);
+
+/**
+ * Reads the next request of {@param self} in {@param entry}, which must be
+ * released with {@link jvm_capture_entry_release}
+ * @post    {@param end} tells whether every request was already read, in
+ *          which case nothing is read in {@param entry}
+ * @return  {@link operation_result} with the result of the operation. A
+ *          truncated or corrupted capture is an illegal argument
+ */
+operation_result jvm_capture_next(jvm_capture *self, jvm_capture_entry *entry,
+								  bool *end);
+
+/**
+ * Releases the memory of an {@param entry} read from a capture
+ */
+void jvm_capture_entry_release(jvm_capture_entry *entry);
+
+/**
+ * Closes the {@param self} capture
+ * @post    The requests recorded are flushed to the file
+ * @return  {@link operation_result} with the result of the operation
+ */
+operation_result jvm_capture_close(jvm_capture *self);
+
+#endif //__JVM_CAPTURE_H__
@@ -1,94 +1,202 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 #include "jvm_client.h"
 #include "socket.h"
 #include "jvm_utils.h"
+#include "jvm_protocol.h"
+#include "jvm_engine.h"
+#include "shm_channel.h"
+#include "hex_dump.h"
 
-#define CHUNK_SIZE 100
+// Quantity of variables received per block
+#define VARIABLES_BLOCK 16384
+// Bytes of a file read at once to compute its checksum
+#define CHECKSUM_BLOCK 16384
 
 /**
- * Static function that reads the bytes from the FILE and sends them in chunks through
- * the socket
+ * Static function that returns the bytes left from the current offset of
+ * {@param fd} until its end
+ * @return the length or -1 if {@param fd} isn't a regular file
  */
-static operation_result
-send_byte_codes(socket_t *skt, jvm_client *self, size_t chunk_size) {
-	fseek(self->src, 0, SEEK_END);
-	long len = ftell(self->src);
-	rewind(self->src);
-
-	//Create chunks and send them through the socket
-	char *buffer = (char *) malloc((size_t) chunk_size);
-	if (!buffer) {
-		return OPERATION_FAILURE_NO_MEMORY;
-	}
-
-	for (int i = 0; i < len; i += chunk_size) {
-		size_t bytes_read = fread(buffer, 1, chunk_size, self->src);
-		if (bytes_read == 0) {
-			free(buffer);
-			return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
-		}
-
-		if (socket_send(skt, buffer, bytes_read) == SOCKET_CONNECTION_ERROR) {
-			free(buffer);
-			return OPERATION_FAILURE_CONNECTION_FAILED;
-		}
+static long regular_file_remaining(int fd) {
+	struct stat st;
+	if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)) {
+		return -1;
 	}
+	off_t offset = lseek(fd, 0, SEEK_CUR);
+	return (offset == -1 || offset > st.st_size) ? -1
+												 : (long) (st.st_size - offset);
+}
 
-	free(buffer);
-	return OPERATION_SUCCESS;
+/**
+ * Static function that sends the byte_codes of {@param src} through the socket.
+ * Regular files are sent by the kernel without copying them to user space, any
+ * other source (as a pipe) is streamed until its end
+ */
+static operation_result send_byte_codes(socket_t *skt, FILE *src) {
+	// Nothing was read through the FILE, so its descriptor is at the start
+	int fd = fileno(src);
+	long remaining = regular_file_remaining(fd);
+	long sent = (remaining >= 0) ? socket_send_file(skt, fd, remaining)
+								 : socket_send_stream(skt, fd);
+	return (sent == SOCKET_CONNECTION_ERROR)
+		   ? OPERATION_FAILURE_CONNECTION_FAILED : OPERATION_SUCCESS;
 }
 
 /**
  * Static function that receives the variables stored by the server and print
- * them in stdout as hexadecimal numbers in uppercase of 8 bytes
+ * them in stdout as hexadecimal numbers in uppercase of 8 bytes. The server
+ * only sends them if the program succeeded, so nothing is printed until the
+ * first block arrives: a failed program prints no dump
  */
 static operation_result
 print_received_variables(socket_t *skt, jvm_client *self) {
 	int expected_variables_quantity = (self->var_size);
-	// Allocate sufficient memory for the variables to receive
-
-	printf("%s\n", VARIABLES_OUTPUT_TITLE);
+	// Allocate memory for a block of variables, they're received in blocks
+	int block = (expected_variables_quantity < VARIABLES_BLOCK)
+				? expected_variables_quantity : VARIABLES_BLOCK;
+	int *variables = (int *) malloc((size_t) (block > 0 ? block : 1) *
+									sizeof(int));
+	if (!variables) {
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
 
 	// Receive the integers from the socket
-	for (int interation = 0;
-		 interation < expected_variables_quantity; interation++) {
-		int received_int;
-		if (socket_recv_int(skt, &received_int) ==
+	for (int received = 0; received < expected_variables_quantity;
+		 received += block) {
+		int quantity = (expected_variables_quantity - received < block)
+					   ? expected_variables_quantity - received : block;
+		if (socket_recv_ints(skt, variables, quantity) ==
 			SOCKET_CONNECTION_ERROR) {
+			free(variables);
 			return OPERATION_FAILURE_CONNECTION_FAILED;
 		}
-		// Print the integer in stdout
-		printf("%08x\n", received_int);
+		if (received == 0) {
+			printf("%s\n", VARIABLES_OUTPUT_TITLE);
+		}
+		// Print the integers in stdout
+		hex_dump_write(stdout, variables, quantity);
+	}
+	// Without variables there's nothing that tells a failure apart
+	if (expected_variables_quantity <= 0) {
+		printf("%s\n", VARIABLES_OUTPUT_TITLE);
 	}
 
+	free(variables);
 	return OPERATION_SUCCESS;
 }
 
+/**
+ * Static function that prints the {@param var_size} {@param variables} in
+ * stdout as hexadecimal numbers of 8 digits
+ */
+static void print_variables(const int *variables, int32_t var_size) {
+	printf("%s\n", VARIABLES_OUTPUT_TITLE);
+	hex_dump_write(stdout, variables, var_size);
+}
+
+/**
+ * Static function that copies the projection of {@param options}
+ * @return the copy or NULL if there's no projection or the memory ran out
+ */
+static jvm_range *copy_projection(const jvm_client_options *options) {
+	if (options->projection_ranges == 0) {
+		return NULL;
+	}
+	size_t size = options->projection_ranges * sizeof(jvm_range);
+	jvm_range *copy = (jvm_range *) malloc(size);
+	if (copy) {
+		memcpy(copy, options->projection, size);
+	}
+	return copy;
+}
+
+/**
+ * Static function that connects {@param skt} to the server in {@param host}
+ * and {@param port} through the socket based {@param transport}
+ * @return SOCKET_CONNECTION_SUCCESS or SOCKET_CONNECTION_ERROR
+ */
+static int connect_socket(socket_t *skt, const char *host, const char *port,
+						  jvm_transport transport) {
+	if (transport == JVM_TRANSPORT_UNIX) {
+		return socket_connect_unix(skt, port);
+	} else if (transport == JVM_TRANSPORT_TCP) {
+		return socket_connect(skt, host, port);
+	}
+	return SOCKET_CONNECTION_ERROR;
+}
+
+void jvm_client_options_default(jvm_client_options *options) {
+	options->protocol = JVM_CLIENT_PROTOCOL_LEGACY;
+	options->window = JVM_CLIENT_DEFAULT_WINDOW;
+	options->compact = false;
+	options->projection = NULL;
+	options->projection_ranges = 0;
+	options->session = NULL;
+	options->transport = JVM_TRANSPORT_TCP;
+	options->checksum = false;
+}
+
 operation_result
 jvm_client_config(const char *host, const char *port, int32_t var_size,
-				  FILE *src,
+				  FILE **sources, int sources_quantity,
+				  const jvm_client_options *options,
 				  jvm_client *self) {
-	if (!host || !src || !self)
+	if (!host || !sources || !options || !self)
 		return OPERATION_FAILURE_NULL_POINTER;
+	if (sources_quantity < 1 || options->window < 1 ||
+		(sources_quantity > 1 &&
+		 options->protocol == JVM_CLIENT_PROTOCOL_LEGACY &&
+		 options->transport != JVM_TRANSPORT_SHM) ||
+		((options->projection_ranges > 0 || options->session) &&
+		 (options->protocol != JVM_CLIENT_PROTOCOL_FRAMED ||
+		  options->transport == JVM_TRANSPORT_SHM)))
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
 
+	self->sources = (FILE **) malloc(sources_quantity * sizeof(FILE *));
+	if (!self->sources)
+		return OPERATION_FAILURE_NO_MEMORY;
+	for (int i = 0; i < sources_quantity; i++) {
+		self->sources[i] = sources[i];
+	}
 	self->host = host;
 	self->port = port;
 	self->var_size = var_size;
-	self->src = src;
+	self->sources_quantity = sources_quantity;
+	self->options = *options;
+	self->options.projection = copy_projection(options);
+	if (options->projection_ranges > 0 && !self->options.projection) {
+		free(self->sources);
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
 	return OPERATION_SUCCESS;
 }
 
 void jvm_client_destroy(jvm_client *self) {
-	fclose(self->src);
+	for (int i = 0; i < self->sources_quantity; i++) {
+		fclose(self->sources[i]);
+	}
+	free(self->sources);
+	free((jvm_range *) self->options.projection);
 }
 
-operation_result jvm_client_start(jvm_client *self) {
+/**
+ * Static function that executes the single source of {@param self} through the
+ * legacy protocol
+ */
+static operation_result jvm_client_start_legacy(jvm_client *self) {
 	socket_t socket;
 
 	// Connect through the socket
-	if (socket_connect(&socket, self->host, self->port) ==
-		SOCKET_CONNECTION_ERROR) {
+	if (connect_socket(&socket, self->host, self->port,
+					   self->options.transport) == SOCKET_CONNECTION_ERROR) {
 		return OPERATION_FAILURE_CONNECTION_FAILED;
 	}
 
@@ -99,8 +207,9 @@ operation_result jvm_client_start(jvm_client *self) {
 		return OPERATION_FAILURE_CONNECTION_FAILED;
 	}
 
-	// Send the byte_codes in chunks
-	if (send_byte_codes(&socket, self, CHUNK_SIZE) != OPERATION_SUCCESS) {
+	// Send the byte_codes
+	if (send_byte_codes(&socket, self->sources[0]) !=
+		OPERATION_SUCCESS) {
 		socket_close(&socket);
 		return OPERATION_FAILURE_CONNECTION_FAILED;
 	}
@@ -119,3 +228,409 @@ operation_result jvm_client_start(jvm_client *self) {
 
 	return result;
 }
+
+operation_result
+jvm_client_execute_legacy(const char *host, const char *port, int32_t var_size,
+						  const char *program, long length, int *variables) {
+	if (!host || !port || !program || !variables)
+		return OPERATION_FAILURE_NULL_POINTER;
+	if (var_size < 0 || length < 0)
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	socket_t socket;
+	if (socket_connect(&socket, host, port) == SOCKET_CONNECTION_ERROR) {
+		return OPERATION_FAILURE_CONNECTION_FAILED;
+	}
+	operation_result result = OPERATION_FAILURE_CONNECTION_FAILED;
+	if (socket_send_int(&socket, var_size) != SOCKET_CONNECTION_ERROR &&
+		socket_send(&socket, program, length) != SOCKET_CONNECTION_ERROR &&
+		socket_shutdown(&socket, SHUT_WR) != SOCKET_CONNECTION_ERROR &&
+		socket_recv_ints(&socket, variables, var_size) !=
+		SOCKET_CONNECTION_ERROR) {
+		result = OPERATION_SUCCESS;
+	}
+	socket_close(&socket);
+	return result;
+}
+
+/**
+ * Static function that pipelines every source of {@param self} through the
+ * same connection and prints their variables in the order of the sources
+ */
+static operation_result jvm_client_start_framed(jvm_client *self) {
+	jvm_pipeline pipeline;
+	if (jvm_pipeline_open(&pipeline, self->host, self->port,
+						  &self->options) != OPERATION_SUCCESS) {
+		return OPERATION_FAILURE_CONNECTION_FAILED;
+	}
+
+	jvm_response **responses = (jvm_response **) calloc(
+			(size_t) self->sources_quantity, sizeof(jvm_response *));
+	if (!responses) {
+		jvm_pipeline_close(&pipeline);
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
+
+	// The ids are assigned in order starting from 0, so they index the sources
+	operation_result result = OPERATION_SUCCESS;
+	for (int i = 0; i < self->sources_quantity &&
+					result == OPERATION_SUCCESS; i++) {
+		char *program;
+		long program_length;
+		uint32_t id;
+		int fd = fileno(self->sources[i]);
+		if (regular_file_remaining(fd) >= 0) {
+			// Sent straight from the file, without reading it
+			result = jvm_pipeline_submit_file(&pipeline, self->var_size, fd,
+											  &id);
+			continue;
+		}
+		result = jvm_engine_read_program(self->sources[i], &program,
+										 &program_length);
+		if (result == OPERATION_SUCCESS && program_length > UINT32_MAX) {
+			free(program);
+			result = OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		} else if (result == OPERATION_SUCCESS) {
+			result = jvm_pipeline_submit(&pipeline, self->var_size, program,
+										 (uint32_t) program_length, &id);
+			free(program);
+		}
+	}
+
+	for (int i = 0; i < self->sources_quantity &&
+					result == OPERATION_SUCCESS; i++) {
+		jvm_response *response;
+		result = jvm_pipeline_receive(&pipeline, &response);
+		if (result == OPERATION_SUCCESS) {
+			if (response->id >= (uint32_t) self->sources_quantity ||
+				responses[response->id]) {
+				jvm_response_destroy(response);
+				result = OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+			} else {
+				responses[response->id] = response;
+			}
+		}
+	}
+
+	for (int i = 0; i < self->sources_quantity; i++) {
+		if (responses[i]) {
+			if (result == OPERATION_SUCCESS) {
+				result = responses[i]->status;
+			}
+			if (responses[i]->status == OPERATION_SUCCESS) {
+				print_variables(responses[i]->variables,
+								responses[i]->var_size);
+			}
+			jvm_response_destroy(responses[i]);
+		}
+	}
+
+	free(responses);
+	jvm_pipeline_close(&pipeline);
+	return result;
+}
+
+/**
+ * Static function that executes every source of {@param self} in turn through
+ * the shared memory region of a co-located server. Each program is read
+ * straight into the region and the variables are printed from it
+ */
+static operation_result jvm_client_start_shm(jvm_client *self) {
+	shm_channel channel;
+	if (shm_channel_open(&channel, self->port) == SHM_CHANNEL_ERROR) {
+		return OPERATION_FAILURE_CONNECTION_FAILED;
+	}
+
+	operation_result result = OPERATION_SUCCESS;
+	for (int i = 0; i < self->sources_quantity &&
+					result == OPERATION_SUCCESS; i++) {
+		if (shm_channel_claim(&channel) == SHM_CHANNEL_ERROR) {
+			result = OPERATION_FAILURE_CONNECTION_FAILED;
+			break;
+		}
+		size_t capacity;
+		char *program = shm_channel_program(&channel, &capacity);
+		size_t program_length = fread(program, 1, capacity, self->sources[i]);
+		if (ferror(self->sources[i]) ||
+			(program_length == capacity && fgetc(self->sources[i]) != EOF)) {
+			// The program doesn't fit in the region
+			result = OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		} else if (shm_channel_request(&channel, self->var_size,
+									   program_length) == SHM_CHANNEL_ERROR) {
+			result = OPERATION_FAILURE_CONNECTION_FAILED;
+		} else {
+			int32_t var_size;
+			int32_t status;
+			const int *variables = shm_channel_response(&channel, &var_size,
+														&status);
+			result = (operation_result) status;
+			if (result == OPERATION_SUCCESS) {
+				print_variables(variables, var_size);
+			}
+		}
+		shm_channel_release(&channel);
+	}
+
+	shm_channel_close(&channel);
+	return result;
+}
+
+operation_result jvm_client_start(jvm_client *self) {
+	if (self->options.transport == JVM_TRANSPORT_SHM) {
+		return jvm_client_start_shm(self);
+	} else if (self->options.protocol == JVM_CLIENT_PROTOCOL_FRAMED) {
+		return jvm_client_start_framed(self);
+	}
+	return jvm_client_start_legacy(self);
+}
+
+operation_result jvm_pipeline_open(jvm_pipeline *self, const char *host,
+								   const char *port,
+								   const jvm_client_options *options) {
+	if (!self || !host || !options)
+		return OPERATION_FAILURE_NULL_POINTER;
+	if (options->window < 1 || options->transport == JVM_TRANSPORT_SHM)
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+
+	self->_projection = copy_projection(options);
+	self->_projection_ranges = options->projection_ranges;
+	if (self->_projection_ranges > 0 && !self->_projection)
+		return OPERATION_FAILURE_NO_MEMORY;
+
+	if (connect_socket(&self->_socket, host, port, options->transport) ==
+		SOCKET_CONNECTION_ERROR) {
+		free(self->_projection);
+		return OPERATION_FAILURE_CONNECTION_FAILED;
+	}
+	if (socket_send_int(&self->_socket, PROTOCOL_FRAMED_MAGIC) ==
+		SOCKET_CONNECTION_ERROR) {
+		socket_close(&self->_socket);
+		free(self->_projection);
+		return OPERATION_FAILURE_CONNECTION_FAILED;
+	}
+	self->_next_id = 0;
+	self->_window = options->window;
+	self->_in_flight = 0;
+	self->_session = options->session;
+	self->_flags = (options->compact ? PROTOCOL_FLAG_COMPACT : 0) |
+				   (self->_projection ? PROTOCOL_FLAG_PROJECTION : 0) |
+				   (self->_session ? PROTOCOL_FLAG_SESSION : 0) |
+				   (options->checksum ? PROTOCOL_FLAG_CHECKSUM : 0);
+	self->_ready_head = NULL;
+	self->_ready_tail = NULL;
+	return OPERATION_SUCCESS;
+}
+
+/**
+ * Static function that receives from the socket the response of one of the
+ * requests in flight
+ */
+static operation_result
+receive_response(jvm_pipeline *self, jvm_response **response) {
+	jvm_response_header header;
+	if (jvm_protocol_recv_response_header(&self->_socket, &header) !=
+		SOCKET_CONNECTION_SUCCESS || header.var_size < 0) {
+		return OPERATION_FAILURE_CONNECTION_FAILED;
+	}
+
+	jvm_response *r = (jvm_response *) malloc(sizeof(jvm_response));
+	if (!r) {
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
+	r->id = header.id;
+	r->status = (operation_result) header.status;
+	r->var_size = header.var_size;
+	r->_next = NULL;
+	r->variables = (int *) malloc(((size_t) header.var_size + 1) *
+								  sizeof(int));
+	if (!r->variables) {
+		free(r);
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
+
+	if (header.var_size > 0 &&
+		jvm_protocol_recv_variables(&self->_socket, r->variables,
+									header.var_size,
+									self->_flags & PROTOCOL_FLAG_COMPACT) ==
+		SOCKET_CONNECTION_ERROR) {
+		jvm_response_destroy(r);
+		return OPERATION_FAILURE_CONNECTION_FAILED;
+	}
+
+	self->_in_flight--;
+	*response = r;
+	return OPERATION_SUCCESS;
+}
+
+/**
+ * Static function that receives one response when the window is full, keeping
+ * it for {@link jvm_pipeline_receive}
+ */
+static operation_result make_room(jvm_pipeline *self) {
+	if (self->_in_flight == self->_window) {
+		jvm_response *response;
+		operation_result result = receive_response(self, &response);
+		if (result != OPERATION_SUCCESS) {
+			return result;
+		}
+		if (self->_ready_tail) {
+			self->_ready_tail->_next = response;
+		} else {
+			self->_ready_head = response;
+		}
+		self->_ready_tail = response;
+	}
+	return OPERATION_SUCCESS;
+}
+
+/**
+ * Static function that sends the {@param header} of a request followed by the
+ * session and the projection of {@param self}, if any, and the {@param
+ * checksum} of the program if the header asks for it
+ * @return SOCKET_CONNECTION_SUCCESS or SOCKET_CONNECTION_ERROR
+ */
+static int send_request_header(jvm_pipeline *self,
+							   const jvm_request_header *header,
+							   uint32_t checksum) {
+	bool checksummed = header->flags & PROTOCOL_FLAG_CHECKSUM;
+	bool program = header->program_length > 0;
+	if (jvm_protocol_send_request_header(&self->_socket, header) ==
+		SOCKET_CONNECTION_ERROR ||
+		(self->_session &&
+		 jvm_protocol_send_session(&self->_socket, self->_session,
+								   self->_projection || checksummed ||
+								   program) ==
+		 SOCKET_CONNECTION_ERROR) ||
+		(self->_projection &&
+		 jvm_protocol_send_projection(&self->_socket, self->_projection,
+									  self->_projection_ranges,
+									  checksummed || program) ==
+		 SOCKET_CONNECTION_ERROR)) {
+		return SOCKET_CONNECTION_ERROR;
+	}
+	if (checksummed) {
+		int value = (int) checksum;
+		long sent = program ? socket_send_ints_more(&self->_socket, &value, 1)
+							: socket_send_ints(&self->_socket, &value, 1);
+		return (sent == SOCKET_CONNECTION_ERROR) ? SOCKET_CONNECTION_ERROR
+												 : SOCKET_CONNECTION_SUCCESS;
+	}
+	return SOCKET_CONNECTION_SUCCESS;
+}
+
+/**
+ * Static function that computes the {@param checksum} of the {@param length}
+ * bytes of the file {@param fd} from its current offset, leaving it unchanged
+ * @return  {@link operation_result} with the result of the operation
+ */
+static operation_result file_checksum(int fd, long length,
+									  uint32_t *checksum) {
+	char block[CHECKSUM_BLOCK];
+	off_t offset = lseek(fd, 0, SEEK_CUR);
+	*checksum = 0;
+	while (length > 0) {
+		ssize_t bytes = pread(fd, block, (length < CHECKSUM_BLOCK)
+										 ? (size_t) length : CHECKSUM_BLOCK,
+							  offset);
+		if (bytes <= 0) {
+			return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		}
+		*checksum = jvm_protocol_checksum(*checksum, block, bytes);
+		offset += bytes;
+		length -= bytes;
+	}
+	return OPERATION_SUCCESS;
+}
+
+operation_result
+jvm_pipeline_submit(jvm_pipeline *self, int32_t var_size, const char *program,
+					uint32_t program_length, uint32_t *id) {
+	if (!self || !program || !id)
+		return OPERATION_FAILURE_NULL_POINTER;
+	operation_result result = make_room(self);
+	if (result != OPERATION_SUCCESS) {
+		return result;
+	}
+
+	jvm_request_header header = {self->_next_id, var_size, self->_flags,
+								 program_length};
+	uint32_t checksum = (self->_flags & PROTOCOL_FLAG_CHECKSUM)
+						? jvm_protocol_checksum(0, program, program_length)
+						: 0;
+	if (send_request_header(self, &header, checksum) ==
+		SOCKET_CONNECTION_ERROR ||
+		socket_send(&self->_socket, program, program_length) ==
+		SOCKET_CONNECTION_ERROR) {
+		return OPERATION_FAILURE_CONNECTION_FAILED;
+	}
+	*id = self->_next_id++;
+	self->_in_flight++;
+	return OPERATION_SUCCESS;
+}
+
+operation_result
+jvm_pipeline_submit_file(jvm_pipeline *self, int32_t var_size, int fd,
+						 uint32_t *id) {
+	if (!self || !id)
+		return OPERATION_FAILURE_NULL_POINTER;
+	long program_length = regular_file_remaining(fd);
+	if (program_length < 0 || program_length > UINT32_MAX)
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	uint32_t checksum = 0;
+	operation_result result = (self->_flags & PROTOCOL_FLAG_CHECKSUM)
+							  ? file_checksum(fd, program_length, &checksum)
+							  : OPERATION_SUCCESS;
+	if (result == OPERATION_SUCCESS) {
+		result = make_room(self);
+	}
+	if (result != OPERATION_SUCCESS) {
+		return result;
+	}
+
+	jvm_request_header header = {self->_next_id, var_size, self->_flags,
+								 (uint32_t) program_length};
+	if (send_request_header(self, &header, checksum) ==
+		SOCKET_CONNECTION_ERROR ||
+		socket_send_file(&self->_socket, fd, program_length) !=
+		program_length) {
+		return OPERATION_FAILURE_CONNECTION_FAILED;
+	}
+	*id = self->_next_id++;
+	self->_in_flight++;
+	return OPERATION_SUCCESS;
+}
+
+operation_result jvm_pipeline_receive(jvm_pipeline *self,
+									  jvm_response **response) {
+	if (!self || !response)
+		return OPERATION_FAILURE_NULL_POINTER;
+	if (self->_ready_head) {
+		*response = self->_ready_head;
+		self->_ready_head = self->_ready_head->_next;
+		if (!self->_ready_head) {
+			self->_ready_tail = NULL;
+		}
+		(*response)->_next = NULL;
+		return OPERATION_SUCCESS;
+	}
+	if (self->_in_flight == 0) {
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	}
+	return receive_response(self, response);
+}
+
+void jvm_pipeline_close(jvm_pipeline *self) {
+	while (self->_ready_head) {
+		jvm_response *next = self->_ready_head->_next;
+		jvm_response_destroy(self->_ready_head);
+		self->_ready_head = next;
+	}
+	self->_ready_tail = NULL;
+	socket_shutdown(&self->_socket, SHUT_RDWR);
+	socket_close(&self->_socket);
+	free(self->_projection);
+}
+
+void jvm_response_destroy(jvm_response *response) {
+	free(response->variables);
+	free(response);
+}
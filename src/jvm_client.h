@@ -3,25 +3,115 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <stdbool.h>
 
 #include "result.h"
+#include "socket.h"
+#include "jvm_protocol.h"
+
+#define JVM_CLIENT_DEFAULT_WINDOW 16
+
+/**
+ * Protocol used by the client:
+ *          - LEGACY: one program per connection, its end is marked by shutting
+ *            down the socket for writing
+ *          - FRAMED: every program travels with a header, so many of them are
+ *            pipelined through the same connection
+ */
+typedef enum jvm_client_protocol {
+	JVM_CLIENT_PROTOCOL_LEGACY,
+	JVM_CLIENT_PROTOCOL_FRAMED
+} jvm_client_protocol;
+
+/**
+ * Optional settings of the client:
+ *          - protocol: {@link jvm_client_protocol} used to talk to the server
+ *          - window: maximum quantity of framed requests sent without having
+ *            received their response
+ *          - compact: if true, the framed requests let the server send the
+ *            variables with the smallest {@link jvm_encoding}
+ *          - projection: the {@param projection_ranges} ranges of variables
+ *            to be received from each framed request, instead of all of them
+ *          - session: name of the session (kept by the server between
+ *            requests) within which every framed request runs, or NULL. It
+ *            isn't copied
+ *          - transport: {@link jvm_transport} to reach the server. For the
+ *            co-located ones the host is ignored and the port is the path or
+ *            name where the server listens
+ *          - checksum: if true, every framed request carries the checksum of
+ *            its program, so the server doesn't execute a corrupted one
+ */
+typedef struct jvm_client_options {
+	jvm_client_protocol protocol;
+	int window;
+	bool compact;
+	const jvm_range *projection;
+	uint32_t projection_ranges;
+	const char *session;
+	jvm_transport transport;
+	bool checksum;
+} jvm_client_options;
 
 typedef struct jvm_client {
 	const char *host;
 	const char *port;
 	int32_t var_size;
-	FILE *src;
+	FILE **sources;
+	int sources_quantity;
+	jvm_client_options options;
 } jvm_client;
 
 /**
- * Initializes the {@param self} with the {@param host}, {@param port}, {@param var_size} and {@param src} received as parameters
+ * Response received for a framed request
+ *          - id: the one returned when the request was submitted
+ *          - status: {@link operation_result} of the execution in the server
+ *          - var_size: quantity of variables in {@param variables}
+ */
+typedef struct jvm_response {
+	uint32_t id;
+	operation_result status;
+	int32_t var_size;
+	int *variables;
+	struct jvm_response *_next;
+} jvm_response;
+
+/**
+ * Persistent connection through which framed requests are pipelined. The
+ * responses may arrive in any order and are matched by their id
+ */
+typedef struct jvm_pipeline {
+	socket_t _socket;
+	uint32_t _next_id;
+	int _window;
+	int _in_flight;
+	uint32_t _flags;
+	jvm_range *_projection;
+	uint32_t _projection_ranges;
+	const char *_session;
+	jvm_response *_ready_head;
+	jvm_response *_ready_tail;
+} jvm_pipeline;
+
+/**
+ * Initializes the {@param options} with the default values: legacy protocol, a
+ * window of {@link JVM_CLIENT_DEFAULT_WINDOW} requests, dense variables, no
+ * projection, session nor checksum and TCP transport
+ * @pre     {@param options} pointer to jvm_client_options already allocated
+ */
+void jvm_client_options_default(jvm_client_options *options);
+
+/**
+ * Initializes the {@param self} with the {@param host}, {@param port}, {@param var_size} and the {@param sources_quantity}
+ * {@param sources} received as parameters. The client takes the ownership of the sources.
+ * The projection of the {@param options} is copied.
  * @pre     {@param self} pointer to jvm_client already allocated
  * @post    {@param self} pointer to jvm_client ready to be used
  * @return  {@link operation_result} with the result of the operation
  */
 operation_result
 jvm_client_config(const char *host, const char *port, int32_t var_size,
-				  FILE *src,
+				  FILE **sources, int sources_quantity,
+				  const jvm_client_options *options,
 				  jvm_client *self);
 
 /**
@@ -30,23 +120,98 @@ jvm_client_config(const char *host, const char *port, int32_t var_size,
  *          - The client will send first a message through the socket with
  *            4 big endian bytes representing a signed int containing the
  *            quantity of variables to store in memory
- *          - The client will then read a size-fixed quantity of byte_codes from the
- *            FILE and send them through the socket. Will continue with this step
- *            until all the byte_codes are sent.
+ *          - The client will then read the byte_codes from the FILE until its end
+ *            and send them through the socket. Regular files are sent with
+ *            sendfile and pipes are spliced into the socket.
  *          - The client will close the socket for writing
  *          - The client will receive the variables stored by the server, each one
  *            of them as 4 big endian bytes representing a signed int
  *          - The client will print the variables in stdout
+ * When the framed protocol is configured, every source is sent as a request
+ * through a {@link jvm_pipeline} and their variables are printed in the order
+ * of the sources. With the shared memory transport, each source is written in
+ * the region shared with the server and executed in turn.
  * @pre     {@param self} pointer to jvm_client already configured
  * @return
  */
 operation_result jvm_client_start(jvm_client *self);
 
 /**
- * Destroys the {@param self} by freeing the memory. Besides, the src FILE is closed.
+ * Executes the {@param program} of {@param length} byte_codes with {@param
+ * var_size} variables in the server listening in {@param host} and {@param
+ * port}, through a legacy connection of its own
+ * @post    {@param variables} contains the {@param var_size} variables
+ *          received
+ * @return  {@link operation_result} with the result of the operation. A
+ *          request rejected by the server, which closes the connection
+ *          without sending the variables, is a connection failure
+ */
+operation_result
+jvm_client_execute_legacy(const char *host, const char *port, int32_t var_size,
+						  const char *program, long length, int *variables);
+
+/**
+ * Destroys the {@param self} by freeing the memory. Besides, the src FILEs are closed.
  * @pre     {@param self} pointer to jvm_client already allocated
  * @post    The memory allocated is released
  */
 void jvm_client_destroy(jvm_client *self);
 
+/**
+ * Connects the {@param self} to the server listening in {@param host} and
+ * {@param port} through the transport in {@param options}, and switches the
+ * connection to the framed protocol. At most the window of {@param options}
+ * requests are kept in flight: submitting beyond it receives the oldest
+ * responses first. Every request carries the projection and the session of
+ * {@param options}, and the checksum of its program if they ask for it
+ * @pre     {@param self} pointer to jvm_pipeline already allocated
+ * @post    {@param self} pointer to jvm_pipeline ready to be used
+ * @return  {@link operation_result} with the result of the operation
+ */
+operation_result jvm_pipeline_open(jvm_pipeline *self, const char *host,
+								   const char *port,
+								   const jvm_client_options *options);
+
+/**
+ * Sends the {@param program} of {@param program_length} byte_codes to be
+ * executed with {@param var_size} variables, without waiting for its response
+ * @post    {@param id} contains the id that the response will carry
+ * @return  {@link operation_result} with the result of the operation
+ */
+operation_result
+jvm_pipeline_submit(jvm_pipeline *self, int32_t var_size, const char *program,
+					uint32_t program_length, uint32_t *id);
+
+/**
+ * Sends the rest of the regular file {@param fd}, from its current offset, as a
+ * program to be executed with {@param var_size} variables. The file is copied
+ * to the socket by the kernel, without reading it in user space (unless its
+ * checksum must be sent, which reads it once beforehand)
+ * @post    {@param id} contains the id that the response will carry
+ * @return  {@link operation_result} with the result of the operation
+ */
+operation_result
+jvm_pipeline_submit_file(jvm_pipeline *self, int32_t var_size, int fd,
+						 uint32_t *id);
+
+/**
+ * Receives the next response available, whichever request it belongs to
+ * @post    {@param response} points to a response that must be released with
+ *          {@link jvm_response_destroy}
+ * @return  {@link operation_result} with the result of the operation
+ */
+operation_result jvm_pipeline_receive(jvm_pipeline *self,
+									  jvm_response **response);
+
+/**
+ * Finishes the connection of {@param self}, dropping the responses not received
+ * @post    The memory allocated is released
+ */
+void jvm_pipeline_close(jvm_pipeline *self);
+
+/**
+ * Releases the {@param response} received through a {@link jvm_pipeline}
+ */
+void jvm_response_destroy(jvm_response *response);
+
 #endif //__CLIENT_H__
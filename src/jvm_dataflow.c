@@ -0,0 +1,429 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jvm_dataflow.h"
+#include "jvm_engine.h"
+#include "jvm_utils.h"
+#include "stack.h"
+
+#define BYTE_CODES 256
+// Variables reachable by istore and iload, whose argument is a byte
+#define SLOTS 256
+#define SLOT_WORDS (SLOTS / 64)
+// Chain of the statements that load and store no variable
+#define NO_SLOT SLOTS
+#define CHAINS (SLOTS + 1)
+#define RUNS_INITIAL_CAPACITY 4096
+
+/**
+ * Effect of a byte_code over the operand stack:
+ *          - size: bytes taken with its argument (0 for the unknown ones,
+ *            which are ignored)
+ *          - pops, pushes: operands popped and then pushed
+ *          - slot: whether its argument is a variable
+ *          - divides: whether it divides, so it may fault
+ */
+typedef struct byte_code_effect {
+	unsigned char size;
+	unsigned char pops;
+	unsigned char pushes;
+	bool slot;
+	bool divides;
+} byte_code_effect;
+
+static byte_code_effect effects[BYTE_CODES];
+static pthread_once_t effects_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Program split in runs of consecutive statements of the same chain:
+ *          - starts: offset of the first byte_code of each run, which ends
+ *            where the next one starts
+ *          - chains: chain of each run
+ *          - owners: thread that runs each chain
+ */
+typedef struct dataflow_plan {
+	const char *program;
+	long length;
+	long *starts;
+	unsigned short *chains;
+	long runs;
+	int owners[CHAINS];
+	int_vector *vec;
+} dataflow_plan;
+
+/**
+ * Share of the plan run by a thread: the runs of the chains it owns, over an
+ * operand stack of its own
+ */
+typedef struct dataflow_share {
+	const dataflow_plan *plan;
+	int index;
+	stack operands;
+	pthread_t thread;
+	bool started;
+} dataflow_share;
+
+/**
+ * Static function that fills the effect of each byte_code
+ */
+static void fill_effects(void) {
+	for (int byte_code = 0; byte_code < BYTE_CODES; byte_code++) {
+		byte_code_effect *effect = &effects[byte_code];
+		memset(effect, 0, sizeof(byte_code_effect));
+		jvm_argument arg;
+		if (jvm_argument_detect(&arg, (unsigned char) byte_code) !=
+			OPERATION_SUCCESS) {
+			continue;
+		}
+		effect->slot = jvm_argument_requires_vector(&arg);
+		effect->size = (effect->slot || jvm_argument_requires_operand(&arg))
+					   ? 2 : 1;
+		switch (byte_code) {
+			case ISTORE:
+				effect->pops = 1;
+				break;
+			case ILOAD:
+			case BIPUSH:
+				effect->pushes = 1;
+				break;
+			case DUP:
+				effect->pops = 1;
+				effect->pushes = 2;
+				break;
+			case INEG:
+				effect->pops = 1;
+				effect->pushes = 1;
+				break;
+			case IDIV:
+			case IREM:
+				effect->divides = true;
+				effect->pops = 2;
+				effect->pushes = 1;
+				break;
+			default:
+				// The rest combine the two operands on the top
+				effect->pops = 2;
+				effect->pushes = 1;
+		}
+	}
+}
+
+/**
+ * Static function that finds the statement of the {@param program} starting
+ * at {@param start}: its byte_codes until the operand stack is empty again
+ * @post    {@param end} is the offset after the statement, the variables it
+ *          loads or stores are added to {@param slots} (the stored ones to
+ *          {@param stored} too) and its byte_codes to {@param instructions}
+ * @return  false if the program can't be split there: a byte_code pops an
+ *          empty stack, pushes into a full one or misses its argument, a
+ *          division may fault (its divisor isn't a constant other than 0 and
+ *          -1 pushed right before) or the program ends with operands in the
+ *          stack. So the chains never fault
+ */
+static bool next_statement(const char *program, long length, long start,
+						   long *end, uint64_t *slots, uint64_t *stored,
+						   uint64_t *instructions) {
+	long depth = 0;
+	long i = start;
+	long previous = -1;
+	bool started = false;
+	while (i < length && (!started || depth > 0)) {
+		const byte_code_effect *effect =
+				&effects[(unsigned char) program[i]];
+		if (effect->size == 0) {
+			i++;
+			continue;
+		}
+		if (i + effect->size > length || depth < effect->pops) {
+			return false;
+		}
+		if (effect->divides &&
+			(previous < 0 || (unsigned char) program[previous] != BIPUSH ||
+			 program[previous + 1] == 0 ||
+			 (signed char) program[previous + 1] == -1)) {
+			return false;
+		}
+		if (effect->slot) {
+			unsigned char slot = (unsigned char) program[i + 1];
+			uint64_t bit = (uint64_t) 1 << (slot % 64);
+			slots[slot / 64] |= bit;
+			if (effect->pops) {
+				stored[slot / 64] |= bit;
+			}
+		}
+		depth += effect->pushes - effect->pops;
+		if (depth > STACK_CAPACITY) {
+			return false;
+		}
+		previous = i;
+		i += effect->size;
+		(*instructions)++;
+		started = true;
+	}
+	*end = i;
+	return depth == 0;
+}
+
+/**
+ * Static function that returns the chain that {@param node} belongs to, as the
+ * root of its tree in {@param parents}
+ */
+static int find(int *parents, int node) {
+	while (parents[node] != node) {
+		parents[node] = parents[parents[node]];
+		node = parents[node];
+	}
+	return node;
+}
+
+/**
+ * Static function that returns the first variable of {@param slots}, or
+ * NO_SLOT if there's none
+ */
+static int first_slot(const uint64_t *slots) {
+	for (int word = 0; word < SLOT_WORDS; word++) {
+		if (slots[word]) {
+			return word * 64 + __builtin_ctzll(slots[word]);
+		}
+	}
+	return NO_SLOT;
+}
+
+/**
+ * Static function that joins in {@param parents} the chains of all the
+ * variables of {@param slots}
+ * @return  the node of the first variable, or NO_SLOT if there's none
+ */
+static int join_slots(int *parents, const uint64_t *slots) {
+	int first = first_slot(slots);
+	if (first == NO_SLOT) {
+		return NO_SLOT;
+	}
+	int root = find(parents, first);
+	for (int word = 0; word < SLOT_WORDS; word++) {
+		for (uint64_t bits = slots[word]; bits; bits &= bits - 1) {
+			int other = find(parents, word * 64 + __builtin_ctzll(bits));
+			parents[other] = root;
+		}
+	}
+	return first;
+}
+
+/**
+ * Static function that splits the {@param plan} in statements, joining in
+ * {@param parents} the variables used by the same statement. Each statement
+ * is a run of its own, whose chain is the node of its first variable
+ * @post    {@param stored} contains the variables stored and {@param
+ *          instructions} the quantity of byte_codes
+ * @return  {@link operation_result} with the result of the operation. A
+ *          program that can't be split is an illegal argument
+ */
+static operation_result split(dataflow_plan *plan, int *parents,
+							  uint64_t *stored, uint64_t *instructions) {
+	long capacity = 0;
+	plan->runs = 0;
+	*instructions = 0;
+	for (long start = 0; start < plan->length; plan->runs++) {
+		if (plan->runs == capacity) {
+			capacity = capacity ? capacity * 2 : RUNS_INITIAL_CAPACITY;
+			long *starts = (long *) realloc(plan->starts, (size_t) capacity *
+														  sizeof(long));
+			if (starts) {
+				plan->starts = starts;
+			}
+			unsigned short *chains = (unsigned short *) realloc(
+					plan->chains, (size_t) capacity * sizeof(unsigned short));
+			if (chains) {
+				plan->chains = chains;
+			}
+			if (!starts || !chains) {
+				return OPERATION_FAILURE_NO_MEMORY;
+			}
+		}
+		uint64_t slots[SLOT_WORDS] = {0};
+		plan->starts[plan->runs] = start;
+		if (!next_statement(plan->program, plan->length, start, &start, slots,
+							stored, instructions)) {
+			return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		}
+		plan->chains[plan->runs] = (unsigned short) join_slots(parents, slots);
+	}
+	return OPERATION_SUCCESS;
+}
+
+/**
+ * Static function that replaces the node of each run of the {@param plan} by
+ * its chain, once the chains of {@param parents} are complete, and joins the
+ * consecutive runs of the same chain
+ * @post    {@param bytes} contains the bytes of each chain
+ */
+static void join_runs(dataflow_plan *plan, int *parents, long *bytes) {
+	long joined = 0;
+	for (long run = 0; run < plan->runs; run++) {
+		long end = (run + 1 < plan->runs) ? plan->starts[run + 1]
+										  : plan->length;
+		int chain = find(parents, plan->chains[run]);
+		bytes[chain] += end - plan->starts[run];
+		if (joined == 0 || plan->chains[joined - 1] != chain) {
+			plan->starts[joined] = plan->starts[run];
+			plan->chains[joined] = (unsigned short) chain;
+			joined++;
+		}
+	}
+	plan->runs = joined;
+}
+
+/**
+ * Static function that assigns the chains of {@param bytes} to {@param
+ * threads} threads in {@param owners}, the greatest ones first, each one to
+ * the thread with the least bytes so far
+ * @return  the quantity of chains
+ */
+static int assign_chains(const long *bytes, int threads, int *owners) {
+	long loads[JVM_DATAFLOW_MAX_THREADS] = {0};
+	bool assigned[CHAINS] = {false};
+	int chains = 0;
+	while (true) {
+		int greatest = -1;
+		for (int chain = 0; chain < CHAINS; chain++) {
+			if (bytes[chain] > 0 && !assigned[chain] &&
+				(greatest < 0 || bytes[chain] > bytes[greatest])) {
+				greatest = chain;
+			}
+		}
+		if (greatest < 0) {
+			return chains;
+		}
+		int lightest = 0;
+		for (int thread = 1; thread < threads; thread++) {
+			if (loads[thread] < loads[lightest]) {
+				lightest = thread;
+			}
+		}
+		owners[greatest] = lightest;
+		loads[lightest] += bytes[greatest];
+		assigned[greatest] = true;
+		chains++;
+	}
+}
+
+/**
+ * Static function run by each thread: it runs the runs of the chains it owns
+ * in order
+ */
+static void *run_share(void *arg) {
+	dataflow_share *share = (dataflow_share *) arg;
+	const dataflow_plan *plan = share->plan;
+	for (long run = 0; run < plan->runs; run++) {
+		if (plan->owners[plan->chains[run]] != share->index) {
+			continue;
+		}
+		long start = plan->starts[run];
+		long end = (run + 1 < plan->runs) ? plan->starts[run + 1]
+										  : plan->length;
+		long consumed;
+		jvm_engine_run_chunk(&plan->program[start], end - start, plan->vec,
+							 &share->operands, NULL, &consumed);
+	}
+	return NULL;
+}
+
+/**
+ * Static function that runs the shares of the {@param plan} in {@param
+ * threads} threads, printing the trace in {@param trace} (if it isn't NULL)
+ * from the calling thread meanwhile. A share whose thread can't be created is
+ * run by the calling thread
+ * @return  false if nothing was run, as the stacks of the shares couldn't be
+ *          created
+ */
+static bool run_plan(const dataflow_plan *plan, int threads, FILE *trace) {
+	dataflow_share shares[JVM_DATAFLOW_MAX_THREADS];
+	int created = 0;
+	while (created < threads &&
+		   stack_create(&shares[created].operands, sizeof(int)) ==
+		   OPERATION_SUCCESS) {
+		created++;
+	}
+	if (created < threads) {
+		while (created > 0) {
+			stack_destroy(&shares[--created].operands);
+		}
+		return false;
+	}
+	// Without trace, the calling thread runs the first share itself
+	int first = trace ? 0 : 1;
+	for (int i = 0; i < threads; i++) {
+		shares[i].plan = plan;
+		shares[i].index = i;
+		shares[i].started = i >= first &&
+							pthread_create(&shares[i].thread, NULL, run_share,
+										   &shares[i]) == 0;
+	}
+	if (trace) {
+		jvm_engine_trace(plan->program, plan->length, trace);
+	}
+	for (int i = 0; i < threads; i++) {
+		if (!shares[i].started) {
+			run_share(&shares[i]);
+		}
+	}
+	for (int i = 0; i < threads; i++) {
+		if (shares[i].started) {
+			pthread_join(shares[i].thread, NULL);
+		}
+		stack_destroy(&shares[i].operands);
+	}
+	return true;
+}
+
+operation_result jvm_dataflow_run(const char *program, long length,
+								  int_vector *vec, int threads, FILE *trace,
+								  uint64_t limit, uint64_t *instructions,
+								  bool *parallel) {
+	if (!program || !vec || !instructions || !parallel)
+		return OPERATION_FAILURE_NULL_POINTER;
+	if (length < 0 || threads < 1 || threads > JVM_DATAFLOW_MAX_THREADS)
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	pthread_once(&effects_once, fill_effects);
+	*parallel = false;
+	if (threads < 2) {
+		return OPERATION_SUCCESS;
+	}
+
+	int parents[CHAINS];
+	for (int node = 0; node < CHAINS; node++) {
+		parents[node] = node;
+	}
+	dataflow_plan plan;
+	plan.program = program;
+	plan.length = length;
+	plan.vec = vec;
+	plan.starts = NULL;
+	plan.chains = NULL;
+	uint64_t stored[SLOT_WORDS] = {0};
+	uint64_t counted;
+	long bytes[CHAINS] = {0};
+	int chains = 0;
+	if (split(&plan, parents, stored, &counted) == OPERATION_SUCCESS &&
+		(limit == 0 || counted <= limit)) {
+		join_runs(&plan, parents, bytes);
+		chains = assign_chains(bytes, threads, plan.owners);
+	}
+	if (chains >= 2) {
+		// The stored variables are marked as written beforehand, so the
+		// threads only write the variables of their own chains
+		for (int slot = 0; slot < SLOTS && slot < int_vector_size(vec);
+			 slot++) {
+			if (stored[slot / 64] & ((uint64_t) 1 << (slot % 64))) {
+				int_vector_set(vec, slot, int_vector_get(vec, slot));
+			}
+		}
+		*parallel = run_plan(&plan, (chains < threads) ? chains : threads,
+							 trace);
+		*instructions = *parallel ? counted : 0;
+	}
+	free(plan.starts);
+	free(plan.chains);
+	return OPERATION_SUCCESS;
+}
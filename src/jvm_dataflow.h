@@ -0,0 +1,42 @@
+#ifndef __JVM_DATAFLOW_H__
+#define __JVM_DATAFLOW_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "result.h"
+#include "int_vector.h"
+
+// Programs shorter than it are run sequentially, as splitting them costs more
+// than what running their chains in parallel saves
+#define JVM_DATAFLOW_MIN_LENGTH (64 * 1024)
+#define JVM_DATAFLOW_MAX_THREADS 64
+
+/**
+ * Executes the whole {@param program} of {@param length} bytes over {@param
+ * vec} splitting it in independent chains, run in parallel by up to {@param
+ * threads} threads. The program is split in statements, the byte_codes
+ * between two moments in which the operand stack is empty, and two statements
+ * belong to the same chain when they load or store a common variable. Each
+ * chain runs its statements in the order of the program and no chain touches
+ * the variables of another one, so the variables end as if the program had
+ * been run sequentially. If {@param trace} isn't NULL, the calling thread
+ * prints the symbolic name of every byte_code there meanwhile, as they don't
+ * depend on the values.
+ * Nothing is executed when the program can't be split in at least two
+ * chains: a byte_code popping an empty stack or pushing into a full one, one
+ * missing its argument, a division that may fault, operands left in the stack
+ * at the end or more than {@param limit} byte_codes (0 doesn't limit them).
+ * So a program that may fault runs sequentially, stopping where it faults
+ * @pre     The operand stack of the program starts empty
+ * @post    {@param parallel} tells whether the program was executed, in which
+ *          case {@param instructions} contains the byte_codes executed
+ * @return  {@link operation_result} with the result of the operation
+ */
+operation_result jvm_dataflow_run(const char *program, long length,
+								  int_vector *vec, int threads, FILE *trace,
+								  uint64_t limit, uint64_t *instructions,
+								  bool *parallel);
+
+#endif //__JVM_DATAFLOW_H__
@@ -0,0 +1,324 @@
+#include <pthread.h>
+#include <string.h>
+
+#include "jvm_engine.h"
+#include "jvm_fault.h"
+#include "jvm_utils.h"
+#include "jvm_probes.h"
+
+#define PROGRAM_INITIAL_CAPACITY 4096
+#define BYTE_CODES 256
+
+// Added once per chunk, so the dispatch loop only increments a register
+static __thread uint64_t thread_instructions = 0;
+
+// Incremented by the tracers attached to the dispatch of every byte_code
+JVM_PROBE_SEMAPHORE(instruction_dispatch);
+
+// Bytes taken by each byte_code with its argument, used to verify programs
+static unsigned char byte_code_sizes[BYTE_CODES];
+static pthread_once_t byte_code_sizes_once = PTHREAD_ONCE_INIT;
+
+uint64_t jvm_engine_instructions(void) {
+	return thread_instructions;
+}
+
+/**
+ * Static function that executes the byte_codes of a chunk as {@link
+ * jvm_engine_run_chunk}, stopping after {@param quantum} of them. The
+ * byte_codes executed are kept in {@param counted} as they run, so they're
+ * known even if one of them faults
+ */
+static void run(const char *byte_codes, long bytes, int_vector *vec,
+				stack *s, FILE *trace, uint64_t quantum, long *consumed,
+				volatile uint64_t *counted) {
+	long i = 0;
+	long executed = 0;
+	uint64_t instructions = 0;
+	bool incomplete = false;
+	while (!incomplete && i < bytes && instructions < quantum) {
+		JVM_PROBE2_GUARDED(instruction_dispatch, i, byte_codes[i]);
+		unsigned char byte_code = (unsigned char) byte_codes[i++];
+		jvm_argument arg;
+		if (jvm_argument_detect(&arg, byte_code) == OPERATION_SUCCESS) {
+			if (jvm_argument_requires_vector(&arg)) {
+				// First argument int_vector, second position
+				if (i == bytes) {
+					incomplete = true;
+				} else {
+					unsigned char position = (unsigned char) byte_codes[i++];
+					arg.func(vec, &position, s);
+				}
+			} else {
+				if (jvm_argument_requires_operand(&arg)) {
+					// First argument is the next byte_code
+					if (i == bytes) {
+						incomplete = true;
+					} else {
+						char extra_argument = byte_codes[i++];
+						arg.func(&extra_argument, NULL, s);
+					}
+				} else {
+					// No extra arguments are needed
+					arg.func(NULL, 0, s);
+				}
+			}
+			if (!incomplete && trace) {
+				fprintf(trace, "%s\n", arg.byte_code_description);
+			}
+			instructions += !incomplete;
+			*counted = instructions;
+		} // Ignore unknown byte_codes
+		if (!incomplete) {
+			executed = i;
+		}
+	}
+	*consumed = executed;
+}
+
+/**
+ * Arguments and results of {@link run} while it runs under {@link
+ * jvm_fault_run}
+ */
+typedef struct guarded_run {
+	const char *byte_codes;
+	long bytes;
+	int_vector *vec;
+	stack *s;
+	FILE *trace;
+	uint64_t quantum;
+	long consumed;
+	volatile uint64_t executed;
+} guarded_run;
+
+/**
+ * Static function that runs the {@param context} {@link guarded_run}
+ */
+static void run_guarded(void *context) {
+	guarded_run *guarded = (guarded_run *) context;
+	run(guarded->byte_codes, guarded->bytes, guarded->vec, guarded->s,
+		guarded->trace, guarded->quantum, &guarded->consumed,
+		&guarded->executed);
+}
+
+/**
+ * Static function that executes the byte_codes of a chunk as {@link run},
+ * turning its faults into failures. A faulting byte_code ends the chunk: the
+ * operands are discarded and the whole chunk is consumed, so nothing after it
+ * runs, but the byte_codes executed before it are still counted
+ * @return  {@link operation_result} with the result of the operation
+ */
+static operation_result run_chunk(const char *byte_codes, long bytes,
+								  int_vector *vec, stack *s, FILE *trace,
+								  uint64_t quantum, long *consumed,
+								  uint64_t *executed) {
+	guarded_run guarded = {byte_codes, bytes, vec, s, trace, quantum, 0, 0};
+	operation_result result = jvm_fault_run(s, run_guarded, &guarded);
+	if (result != OPERATION_SUCCESS) {
+		stack_clear(s);
+		guarded.consumed = bytes;
+	}
+	*consumed = guarded.consumed;
+	*executed = guarded.executed;
+	thread_instructions += *executed;
+	return result;
+}
+
+operation_result
+jvm_engine_run_chunk(const char *byte_codes, long bytes, int_vector *vec,
+					 stack *s, FILE *trace, long *consumed) {
+	uint64_t executed;
+	return run_chunk(byte_codes, bytes, vec, s, trace, UINT64_MAX, consumed,
+					 &executed);
+}
+
+operation_result
+jvm_engine_run_slice(const char *program, long length, long *pc,
+					 uint64_t quantum, int_vector *vec, stack *s, FILE *trace,
+					 bool *finished) {
+	if (*pc < 0 || *pc > length || quantum == 0)
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	long consumed;
+	uint64_t executed;
+	operation_result result = run_chunk(&program[*pc], length - *pc, vec, s,
+										trace, quantum, &consumed, &executed);
+	*pc += consumed;
+	// Stopping before the quantum means the end of the program was reached
+	*finished = result != OPERATION_SUCCESS || executed < quantum ||
+				*pc == length;
+	return result;
+}
+
+/**
+ * Static function that fills the bytes taken by each byte_code, with its
+ * argument (0 for the unknown ones, which are ignored)
+ */
+static void fill_byte_code_sizes(void) {
+	for (int byte_code = 0; byte_code < BYTE_CODES; byte_code++) {
+		jvm_argument arg;
+		if (jvm_argument_detect(&arg, (unsigned char) byte_code) !=
+			OPERATION_SUCCESS) {
+			byte_code_sizes[byte_code] = 0;
+		} else {
+			byte_code_sizes[byte_code] =
+					(jvm_argument_requires_vector(&arg) ||
+					 jvm_argument_requires_operand(&arg)) ? 2 : 1;
+		}
+	}
+}
+
+operation_result jvm_engine_verify(const char *program, long length,
+								   int32_t var_size, uint64_t *instructions) {
+	if (!program || !instructions)
+		return OPERATION_FAILURE_NULL_POINTER;
+	pthread_once(&byte_code_sizes_once, fill_byte_code_sizes);
+	uint64_t count = 0;
+	long i = 0;
+	bool out_of_bounds = false;
+	while (i < length) {
+		unsigned char size = byte_code_sizes[(unsigned char) program[i]];
+		if (var_size >= 0 && (unsigned char) program[i] == ILOAD &&
+			i + 1 < length && (unsigned char) program[i + 1] >= var_size) {
+			out_of_bounds = true;
+		}
+		// Unknown byte_codes are skipped as when executed
+		i += size ? size : 1;
+		count += size != 0;
+	}
+	*instructions = count;
+	// Only the last byte_code can be missing its argument
+	if (i != length) {
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	}
+	return out_of_bounds ? OPERATION_FAILURE_OUT_OF_BOUNDS : OPERATION_SUCCESS;
+}
+
+void jvm_engine_trace(const char *program, long length, FILE *trace) {
+	long i = 0;
+	while (i < length) {
+		jvm_argument arg;
+		if (jvm_argument_detect(&arg, (unsigned char) program[i]) !=
+			OPERATION_SUCCESS) {
+			i++;
+			continue;
+		}
+		long size = (jvm_argument_requires_vector(&arg) ||
+					 jvm_argument_requires_operand(&arg)) ? 2 : 1;
+		if (i + size > length) {
+			break;
+		}
+		fprintf(trace, "%s\n", arg.byte_code_description);
+		i += size;
+	}
+}
+
+/**
+ * Static function that executes a whole {@param program} over {@param vec}
+ * @return  {@link operation_result} with the result of the operation. A
+ *          byte_code missing its argument is an illegal argument
+ */
+static operation_result
+run_program(const char *program, long length, int_vector *vec, FILE *trace) {
+	stack s;
+	if (stack_create(&s, sizeof(int)) != OPERATION_SUCCESS) {
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
+	long consumed;
+	operation_result result = jvm_engine_run_chunk(program, length, vec, &s,
+												   trace, &consumed);
+	stack_destroy(&s);
+	if (result == OPERATION_SUCCESS && consumed != length) {
+		result = OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	}
+	return result;
+}
+
+operation_result jvm_execute(const char *program, long length, int var_size,
+							 int *out_vars) {
+	if (!program || !out_vars)
+		return OPERATION_FAILURE_NULL_POINTER;
+	if (var_size < 0 || length < 0)
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+
+	int_vector vec;
+	if (int_vector_create(&vec, var_size) != OPERATION_SUCCESS) {
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
+	operation_result result = run_program(program, length, &vec, NULL);
+	for (int from = 0; from < var_size;) {
+		bool touched;
+		int to = int_vector_run(&vec, from, &touched);
+		if (touched) {
+			memcpy(&out_vars[from], &int_vector_data(&vec)[from],
+				   (size_t) (to - from) * sizeof(int));
+		} else {
+			memset(&out_vars[from], 0, (size_t) (to - from) * sizeof(int));
+		}
+		from = to;
+	}
+	int_vector_destroy(&vec);
+	return result;
+}
+
+operation_result
+jvm_engine_read_program(FILE *src, char **program, long *length) {
+	long capacity = PROGRAM_INITIAL_CAPACITY;
+	long read = 0;
+	char *buffer = (char *) malloc((size_t) capacity);
+	if (!buffer) {
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
+	size_t bytes_read;
+	while ((bytes_read = fread(&buffer[read], 1,
+							   (size_t) (capacity - read), src)) > 0) {
+		read += (long) bytes_read;
+		if (read == capacity) {
+			capacity *= 2;
+			char *bigger = (char *) realloc(buffer, (size_t) capacity);
+			if (!bigger) {
+				free(buffer);
+				return OPERATION_FAILURE_NO_MEMORY;
+			}
+			buffer = bigger;
+		}
+	}
+	if (ferror(src)) {
+		free(buffer);
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	}
+	*program = buffer;
+	*length = read;
+	return OPERATION_SUCCESS;
+}
+
+operation_result jvm_engine_run(FILE *src, int var_size, FILE *out) {
+	if (!src || !out)
+		return OPERATION_FAILURE_NULL_POINTER;
+	if (var_size < 0)
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+
+	char *program;
+	long length;
+	operation_result result = jvm_engine_read_program(src, &program, &length);
+	if (result != OPERATION_SUCCESS) {
+		return result;
+	}
+
+	int_vector vec;
+	if (int_vector_create(&vec, var_size) != OPERATION_SUCCESS) {
+		free(program);
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
+
+	fprintf(out, "%s\n", BYTE_CODES_OUTPUT_TITLE);
+	result = run_program(program, length, &vec, out);
+	// Print extra line dividing byte_codes trace from the variables dump
+	fprintf(out, "\n");
+
+	fprintf(out, "%s\n", VARIABLES_OUTPUT_TITLE);
+	int_vector_print_elements(&vec, out);
+
+	int_vector_destroy(&vec);
+	free(program);
+	return result;
+}
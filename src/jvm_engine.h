@@ -0,0 +1,109 @@
+#ifndef __JVM_ENGINE_H__
+#define __JVM_ENGINE_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "result.h"
+#include "int_vector.h"
+#include "stack.h"
+
+/**
+ * Engine that executes the programs received whole:
+ *          - STACK: interprets the byte_codes one by one
+ *          - REGISTER: translates the program into register code first
+ */
+typedef enum jvm_engine_kind {
+	JVM_ENGINE_STACK,
+	JVM_ENGINE_REGISTER
+} jvm_engine_kind;
+
+/**
+ * Executes the {@param program} of {@param length} byte_codes with {@param
+ * var_size} variables initialized in zero, without any networking nor trace
+ * @pre     {@param out_vars} has room for {@param var_size} ints
+ * @post    {@param out_vars} contains the final value of the variables
+ * @return  {@link operation_result} with the result of the operation
+ */
+operation_result jvm_execute(const char *program, long length, int var_size,
+							 int *out_vars);
+
+/**
+ * Executes the byte_codes of a program chunk over the variables in {@param vec}
+ * and the operands in {@param s}:
+ *          - A {@link jvm_argument} is created with each byte_code
+ *          - The jvm_argument is executed
+ *          - If {@param trace} isn't NULL, its symbolic name is printed there
+ * A byte_code whose argument is in the next chunk isn't executed. A byte_code
+ * that faults (see {@link jvm_fault_run}) ends the chunk without printing it:
+ * the variables keep the changes made until then and the operands are
+ * discarded.
+ * @post    {@param consumed} contains the quantity of bytes executed, so the
+ *          remaining ones must be prepended to the next chunk (the whole
+ *          chunk after a fault)
+ * @return  {@link operation_result} with the result of the operation
+ */
+operation_result
+jvm_engine_run_chunk(const char *byte_codes, long bytes, int_vector *vec,
+					 stack *s, FILE *trace, long *consumed);
+
+/**
+ * Executes at most {@param quantum} byte_codes of the {@param program} of
+ * {@param length} bytes, starting from the one at {@param pc}, over the
+ * variables in {@param vec} and the operands in {@param s}. Running the whole
+ * program in consecutive slices has the same effect as running it at once.
+ * A fault ends the program, as in {@link jvm_engine_run_chunk}
+ * @post    {@param pc} is the offset of the next byte_code to be executed and
+ *          {@param finished} tells whether the end of the program was reached
+ *          (if a byte_code is missing its argument, {@param pc} stops there)
+ * @return  {@link operation_result} with the result of the operation
+ */
+operation_result
+jvm_engine_run_slice(const char *program, long length, long *pc,
+					 uint64_t quantum, int_vector *vec, stack *s, FILE *trace,
+					 bool *finished);
+
+/**
+ * Verifies the whole {@param program} of {@param length} bytes before
+ * executing it over {@param var_size} variables (any quantity if it's
+ * negative), without side effects
+ * @post    {@param instructions} contains the quantity of byte_codes that
+ *          executing it would run
+ * @return  {@link operation_result} with the result of the operation. A
+ *          byte_code missing its argument is an illegal argument, and an
+ *          iload of a variable beyond {@param var_size} is out of bounds: it
+ *          would only load a 0
+ */
+operation_result jvm_engine_verify(const char *program, long length,
+								   int32_t var_size, uint64_t *instructions);
+
+/**
+ * Prints in {@param trace} the symbolic name of every byte_code of the {@param
+ * program} of {@param length} bytes, as executing it would, without executing
+ * it. A last byte_code missing its argument isn't printed
+ */
+void jvm_engine_trace(const char *program, long length, FILE *trace);
+
+/**
+ * Returns the quantity of byte_codes executed so far by the calling thread
+ */
+uint64_t jvm_engine_instructions(void);
+
+/**
+ * Reads the whole program from {@param src} in memory
+ * @post    {@param program} must be released with free
+ * @return  {@link operation_result} with the result of the operation
+ */
+operation_result
+jvm_engine_read_program(FILE *src, char **program, long *length);
+
+/**
+ * Executes the program read from {@param src} with {@param var_size}
+ * variables, printing in {@param out} the same output as the server: the
+ * bytecode trace followed by the variables dump
+ * @return  {@link operation_result} with the result of the operation
+ */
+operation_result jvm_engine_run(FILE *src, int var_size, FILE *out);
+
+#endif //__JVM_ENGINE_H__
@@ -0,0 +1,89 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <string.h>
+
+#include "jvm_fault.h"
+
+/**
+ * Point where the thread running a body returns when it faults, with the
+ * operands whose guard pages belong to it and the fault found
+ */
+typedef struct fault_point {
+	sigjmp_buf env;
+	const stack *operands;
+	volatile operation_result fault;
+	struct fault_point *outer;
+} fault_point;
+
+static __thread fault_point *current_point = NULL;
+
+static struct sigaction previous_fpe;
+static struct sigaction previous_segv;
+static pthread_once_t handlers_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Static function that handles SIGFPE and SIGSEGV. A fault of a body unwinds
+ * to its point; otherwise the previous action is restored and the faulting
+ * instruction runs again under it
+ */
+static void handle_fault(int signal, siginfo_t *info, void *ignored) {
+	fault_point *point = current_point;
+	operation_result fault = OPERATION_SUCCESS;
+	if (point) {
+		fault = (signal == SIGFPE) ? OPERATION_FAILURE_ARITHMETIC
+								   : stack_fault(point->operands,
+												 info->si_addr);
+	}
+	if (fault == OPERATION_SUCCESS) {
+		sigaction(signal, (signal == SIGFPE) ? &previous_fpe : &previous_segv,
+				  NULL);
+		if (info->si_code <= 0) {
+			// Raised by a division, which isn't run again as an instruction
+			raise(signal);
+		}
+		return;
+	}
+	point->fault = fault;
+	// The handler doesn't block its signal, so no mask must be restored
+	siglongjmp(point->env, 1);
+}
+
+/**
+ * Static function that installs the handler of both signals
+ */
+static void install_handlers(void) {
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_sigaction = handle_fault;
+	action.sa_flags = SA_SIGINFO | SA_NODEFER;
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGFPE, &action, &previous_fpe);
+	sigaction(SIGSEGV, &action, &previous_segv);
+}
+
+operation_result jvm_fault_run(const stack *operands, jvm_fault_body body,
+							   void *context) {
+	if (!body)
+		return OPERATION_FAILURE_NULL_POINTER;
+	pthread_once(&handlers_once, install_handlers);
+	fault_point point;
+	point.operands = operands;
+	point.fault = OPERATION_SUCCESS;
+	point.outer = current_point;
+	current_point = &point;
+	// Saving the signal mask would take a system call each time
+	if (sigsetjmp(point.env, 0) == 0) {
+		body(context);
+	}
+	current_point = point.outer;
+	return point.fault;
+}
+
+bool jvm_fault_is(operation_result result) {
+	return result == OPERATION_FAILURE_ARITHMETIC ||
+		   result == OPERATION_FAILURE_STACK_OVERFLOW ||
+		   result == OPERATION_FAILURE_STACK_UNDERFLOW;
+}
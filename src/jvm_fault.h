@@ -0,0 +1,64 @@
+#ifndef __JVM_FAULT_H__
+#define __JVM_FAULT_H__
+
+#include <limits.h>
+#include <signal.h>
+#include <stdbool.h>
+
+#include "result.h"
+#include "stack.h"
+
+/**
+ * Code run by {@link jvm_fault_run} with its {@param context}
+ */
+typedef void (*jvm_fault_body)(void *context);
+
+/**
+ * Runs the {@param body} with its {@param context} in the calling thread,
+ * turning the faults of the byte_codes it executes into failures instead of
+ * checking each operation:
+ *          - ARITHMETIC: a division by zero or of INT_MIN by -1 (SIGFPE)
+ *          - STACK_OVERFLOW: a push into the full {@param operands} stack
+ *          - STACK_UNDERFLOW: a pop from the empty {@param operands} stack
+ *            (both SIGSEGV in its guard pages)
+ * The body is abandoned right where it faults, so it must not hold locks nor
+ * memory then. The signal handlers are installed the first time; any other
+ * signal is left to the handlers that were installed before
+ * @return  OPERATION_SUCCESS or the fault of the body
+ */
+operation_result jvm_fault_run(const stack *operands, jvm_fault_body body,
+							   void *context);
+
+/**
+ * Divides {@param dividend} by {@param divisor}, leaving the {@param
+ * quotient} and the {@param remainder}. A division by zero or of INT_MIN by
+ * -1 raises SIGFPE, so {@link jvm_fault_run} fails the body with ARITHMETIC:
+ * x86 traps in idiv itself, written in assembly so the compiler can't assume
+ * the division is defined; other targets (as aarch64, whose sdiv never traps)
+ * check it and raise the signal. It's inlined as it runs for every division
+ */
+static inline void jvm_fault_divide(int dividend, int divisor, int *quotient,
+									int *remainder) {
+#if defined(__x86_64__) || defined(__i386__)
+	__asm__ __volatile__("cltd\n\tidivl %3"
+						 : "=a" (*quotient), "=&d" (*remainder)
+						 : "0" (dividend), "r" (divisor)
+						 : "cc");
+#else
+	if (divisor == 0 || (dividend == INT_MIN && divisor == -1)) {
+		raise(SIGFPE);
+		*quotient = 0;
+		*remainder = 0;
+		return;
+	}
+	*quotient = dividend / divisor;
+	*remainder = dividend % divisor;
+#endif
+}
+
+/**
+ * Returns whether the {@param result} is a fault of {@link jvm_fault_run}
+ */
+bool jvm_fault_is(operation_result result);
+
+#endif //__JVM_FAULT_H__
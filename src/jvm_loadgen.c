@@ -0,0 +1,309 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "jvm_loadgen.h"
+#include "jvm_engine.h"
+#include "jvm_metrics.h"
+
+#define MICROSECONDS 1e6
+#define MILLISECONDS 1e3
+// Constants of the xorshift64* generator
+#define RANDOM_MULTIPLIER 0x2545F4914F6CDD1DULL
+#define RANDOM_SEED 0x9E3779B97F4A7C15ULL
+
+static const double PERCENTILES[] = {50, 90, 99, 99.9, 99.99};
+#define PERCENTILES_QUANTITY (sizeof(PERCENTILES) / sizeof(PERCENTILES[0]))
+
+/**
+ * Program of the corpus, read in memory once
+ */
+typedef struct loadgen_program {
+	char *byte_codes;
+	long length;
+} loadgen_program;
+
+/**
+ * Connection of the load generator, served by its own thread. It sends the
+ * requests whose number modulo the connections is its index, and keeps its
+ * own counters and latencies, added up once every thread finishes
+ */
+typedef struct loadgen_connection {
+	const char *host;
+	const char *port;
+	const jvm_loadgen_options *options;
+	const loadgen_program *corpus;
+	int corpus_quantity;
+	int index;
+	double started;
+	uint64_t random;
+	uint64_t sent;
+	uint64_t completed;
+	uint64_t failed;
+	double finished;
+	jvm_pipeline pipeline;
+	bool connected;
+	pthread_t thread;
+	hdr_histogram latencies;
+} loadgen_connection;
+
+void jvm_loadgen_options_default(jvm_loadgen_options *options) {
+	options->rate = 0;
+	options->duration = JVM_LOADGEN_DEFAULT_DURATION;
+	options->connections = JVM_LOADGEN_DEFAULT_CONNECTIONS;
+	options->protocol = JVM_CLIENT_PROTOCOL_FRAMED;
+	options->min_variables = 0;
+	options->max_variables = 0;
+}
+
+/**
+ * Static function that returns the next pseudo random number of {@param self}
+ */
+static uint64_t next_random(loadgen_connection *self) {
+	self->random ^= self->random >> 12;
+	self->random ^= self->random << 25;
+	self->random ^= self->random >> 27;
+	return self->random * RANDOM_MULTIPLIER;
+}
+
+/**
+ * Static function that sleeps until {@param instant} of {@link
+ * jvm_metrics_now}, if it's still to come
+ */
+static void sleep_until(double instant) {
+	double left = instant - jvm_metrics_now();
+	if (left > 0) {
+		struct timespec pause;
+		pause.tv_sec = (time_t) left;
+		pause.tv_nsec = (long) ((left - (double) pause.tv_sec) * 1e9);
+		nanosleep(&pause, NULL);
+	}
+}
+
+/**
+ * Static function that sends the {@param program} with {@param var_size}
+ * variables through the pipeline of {@param self}, connecting it first if
+ * needed, and waits for its response
+ * @return  {@link operation_result} with the status of the request
+ */
+static operation_result send_framed(loadgen_connection *self,
+									const loadgen_program *program,
+									int32_t var_size) {
+	if (!self->connected) {
+		jvm_client_options options;
+		jvm_client_options_default(&options);
+		options.protocol = JVM_CLIENT_PROTOCOL_FRAMED;
+		if (jvm_pipeline_open(&self->pipeline, self->host, self->port,
+							  &options) != OPERATION_SUCCESS) {
+			return OPERATION_FAILURE_CONNECTION_FAILED;
+		}
+		self->connected = true;
+	}
+	uint32_t id;
+	jvm_response *response;
+	operation_result result = jvm_pipeline_submit(
+			&self->pipeline, var_size, program->byte_codes,
+			(uint32_t) program->length, &id);
+	if (result == OPERATION_SUCCESS) {
+		result = jvm_pipeline_receive(&self->pipeline, &response);
+	}
+	if (result != OPERATION_SUCCESS) {
+		// Connected again for the next request
+		jvm_pipeline_close(&self->pipeline);
+		self->connected = false;
+		return result;
+	}
+	result = response->status;
+	jvm_response_destroy(response);
+	return result;
+}
+
+/**
+ * Static function run by the thread of each connection: it sends its requests
+ * as their time comes until the duration ends, measuring the latency of each
+ * one of them from the moment it should have been sent
+ */
+static void *drive_connection(void *arg) {
+	loadgen_connection *self = (loadgen_connection *) arg;
+	const jvm_loadgen_options *options = self->options;
+	uint64_t range = (uint64_t) (options->max_variables -
+								 options->min_variables) + 1;
+	int *variables = (int *) malloc((size_t) options->max_variables *
+									sizeof(int) + 1);
+	for (uint64_t request = (uint64_t) self->index;
+		 (double) request / options->rate < options->duration;
+		 request += (uint64_t) options->connections) {
+		double scheduled = self->started + (double) request / options->rate;
+		sleep_until(scheduled);
+		const loadgen_program *program =
+				&self->corpus[next_random(self) %
+							  (uint64_t) self->corpus_quantity];
+		int32_t var_size = options->min_variables +
+						   (int32_t) (next_random(self) % range);
+		operation_result result;
+		if (!variables) {
+			result = OPERATION_FAILURE_NO_MEMORY;
+		} else if (options->protocol == JVM_CLIENT_PROTOCOL_LEGACY) {
+			result = jvm_client_execute_legacy(self->host, self->port,
+											   var_size, program->byte_codes,
+											   program->length, variables);
+		} else {
+			result = send_framed(self, program, var_size);
+		}
+		double answered = jvm_metrics_now();
+		self->sent++;
+		if (result == OPERATION_SUCCESS) {
+			self->completed++;
+		} else {
+			self->failed++;
+		}
+		hdr_histogram_record(&self->latencies, (uint64_t) (
+				(answered - scheduled) * MICROSECONDS));
+	}
+	self->finished = jvm_metrics_now();
+	if (self->connected) {
+		jvm_pipeline_close(&self->pipeline);
+	}
+	free(variables);
+	return NULL;
+}
+
+/**
+ * Static function that releases the first {@param quantity} programs of the
+ * {@param corpus}
+ */
+static void release_corpus(loadgen_program *corpus, int quantity) {
+	for (int i = 0; i < quantity; i++) {
+		free(corpus[i].byte_codes);
+	}
+	free(corpus);
+}
+
+/**
+ * Static function that reads the {@param quantity} files of {@param paths} in
+ * memory
+ * @post    {@param corpus} must be released with {@link release_corpus}
+ * @return  {@link operation_result} with the result of the operation
+ */
+static operation_result read_corpus(const char **paths, int quantity,
+									loadgen_program **corpus) {
+	*corpus = (loadgen_program *) malloc((size_t) quantity *
+										 sizeof(loadgen_program));
+	if (!*corpus) {
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
+	for (int i = 0; i < quantity; i++) {
+		FILE *src = fopen(paths[i], "rb");
+		operation_result result = src
+				? jvm_engine_read_program(src, &(*corpus)[i].byte_codes,
+										  &(*corpus)[i].length)
+				: OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		if (src) {
+			fclose(src);
+		}
+		if (result == OPERATION_SUCCESS &&
+			(*corpus)[i].length > UINT32_MAX) {
+			free((*corpus)[i].byte_codes);
+			result = OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		}
+		if (result != OPERATION_SUCCESS) {
+			release_corpus(*corpus, i);
+			return result;
+		}
+	}
+	return OPERATION_SUCCESS;
+}
+
+operation_result jvm_loadgen_run(const char *host, const char *port,
+								 const char **corpus, int corpus_quantity,
+								 const jvm_loadgen_options *options,
+								 jvm_loadgen_report *report) {
+	if (!host || !port || !corpus || !options || !report)
+		return OPERATION_FAILURE_NULL_POINTER;
+	if (corpus_quantity < 1 || !(options->rate > 0) ||
+		!(options->duration > 0) || options->connections < 1 ||
+		options->min_variables < 0 ||
+		options->max_variables < options->min_variables)
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	loadgen_program *programs;
+	operation_result result = read_corpus(corpus, corpus_quantity, &programs);
+	if (result != OPERATION_SUCCESS) {
+		return result;
+	}
+	loadgen_connection *connections = (loadgen_connection *) malloc(
+			(size_t) options->connections * sizeof(loadgen_connection));
+	if (!connections) {
+		release_corpus(programs, corpus_quantity);
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
+
+	memset(report, 0, sizeof(jvm_loadgen_report));
+	hdr_histogram_init(&report->latencies);
+	double started = jvm_metrics_now();
+	int created = 0;
+	while (created < options->connections) {
+		loadgen_connection *connection = &connections[created];
+		connection->host = host;
+		connection->port = port;
+		connection->options = options;
+		connection->corpus = programs;
+		connection->corpus_quantity = corpus_quantity;
+		connection->index = created;
+		connection->started = started;
+		connection->random = RANDOM_SEED * (uint64_t) (created + 1);
+		connection->sent = 0;
+		connection->completed = 0;
+		connection->failed = 0;
+		connection->finished = started;
+		connection->connected = false;
+		hdr_histogram_init(&connection->latencies);
+		if (pthread_create(&connection->thread, NULL, drive_connection,
+						   connection) != 0) {
+			result = OPERATION_FAILURE_NO_MEMORY;
+			break;
+		}
+		created++;
+	}
+	double finished = started;
+	for (int i = 0; i < created; i++) {
+		pthread_join(connections[i].thread, NULL);
+		report->sent += connections[i].sent;
+		report->completed += connections[i].completed;
+		report->failed += connections[i].failed;
+		hdr_histogram_merge(&report->latencies, &connections[i].latencies);
+		if (connections[i].finished > finished) {
+			finished = connections[i].finished;
+		}
+	}
+	report->elapsed = finished - started;
+	free(connections);
+	release_corpus(programs, corpus_quantity);
+	return result;
+}
+
+void jvm_loadgen_print(const jvm_loadgen_report *report,
+					   const jvm_loadgen_options *options, FILE *out) {
+	fprintf(out, "target rate: %.1f requests/s\n", options->rate);
+	fprintf(out, "achieved rate: %.1f requests/s\n",
+			report->elapsed > 0 ? (double) report->completed / report->elapsed
+								: 0);
+	fprintf(out, "sent: %llu\n", (unsigned long long) report->sent);
+	fprintf(out, "completed: %llu\n", (unsigned long long) report->completed);
+	fprintf(out, "failed: %llu\n", (unsigned long long) report->failed);
+	fprintf(out, "elapsed: %.3f s\n", report->elapsed);
+	const hdr_histogram *latencies = &report->latencies;
+	fprintf(out, "latency min: %.3f ms\n", latencies->count
+			? (double) latencies->min / MILLISECONDS : 0);
+	fprintf(out, "latency mean: %.3f ms\n", latencies->count
+			? latencies->sum / (double) latencies->count / MILLISECONDS : 0);
+	for (size_t i = 0; i < PERCENTILES_QUANTITY; i++) {
+		fprintf(out, "latency p%g: %.3f ms\n", PERCENTILES[i],
+				(double) hdr_histogram_percentile(latencies, PERCENTILES[i]) /
+				MILLISECONDS);
+	}
+	fprintf(out, "latency max: %.3f ms\n",
+			(double) latencies->max / MILLISECONDS);
+}
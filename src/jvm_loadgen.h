@@ -0,0 +1,85 @@
+#ifndef __JVM_LOADGEN_H__
+#define __JVM_LOADGEN_H__
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "result.h"
+#include "hdr_histogram.h"
+#include "jvm_client.h"
+
+#define JVM_LOADGEN_DEFAULT_CONNECTIONS 16
+#define JVM_LOADGEN_DEFAULT_DURATION 10
+
+/**
+ * Settings of the load generator:
+ *          - rate: requests per second sent, whether the previous ones were
+ *            answered or not
+ *          - duration: seconds during which requests are sent
+ *          - connections: connections among which the requests are spread,
+ *            each one of them served by its own thread
+ *          - protocol: {@link jvm_client_protocol} of the requests. Legacy
+ *            requests open a connection each, framed ones reuse the one of
+ *            their thread
+ *          - min_variables, max_variables: each request asks for a quantity
+ *            of variables drawn uniformly between both (inclusive)
+ */
+typedef struct jvm_loadgen_options {
+	double rate;
+	double duration;
+	int connections;
+	jvm_client_protocol protocol;
+	int32_t min_variables;
+	int32_t max_variables;
+} jvm_loadgen_options;
+
+/**
+ * Outcome of a load generation:
+ *          - sent: requests sent
+ *          - completed: requests answered successfully
+ *          - failed: requests rejected by the server or whose connection
+ *            failed
+ *          - elapsed: seconds from the first request until the last answer
+ *          - latencies: microseconds from the moment each request should
+ *            have been sent until its answer arrived, so the time it waited
+ *            behind a slow one is counted (avoiding coordinated omission)
+ */
+typedef struct jvm_loadgen_report {
+	uint64_t sent;
+	uint64_t completed;
+	uint64_t failed;
+	double elapsed;
+	hdr_histogram latencies;
+} jvm_loadgen_report;
+
+/**
+ * Initializes the {@param options} with the default values: no rate, {@link
+ * JVM_LOADGEN_DEFAULT_DURATION} seconds, {@link
+ * JVM_LOADGEN_DEFAULT_CONNECTIONS} connections, framed protocol and no
+ * variables
+ */
+void jvm_loadgen_options_default(jvm_loadgen_options *options);
+
+/**
+ * Drives the server listening in {@param host} and {@param port} at the rate
+ * of the {@param options}, sending programs drawn at random from the {@param
+ * corpus_quantity} files of the {@param corpus}. The requests are scheduled
+ * evenly spaced from the start, and each connection sends the ones assigned
+ * to it once their time comes (or right away if it's late)
+ * @post    {@param report} contains the outcome of the load generation
+ * @return  {@link operation_result} with the result of the operation. The
+ *          failed requests don't make it fail
+ */
+operation_result jvm_loadgen_run(const char *host, const char *port,
+								 const char **corpus, int corpus_quantity,
+								 const jvm_loadgen_options *options,
+								 jvm_loadgen_report *report);
+
+/**
+ * Prints the {@param report} of a load generation at the target rate of
+ * {@param options} in {@param out}
+ */
+void jvm_loadgen_print(const jvm_loadgen_report *report,
+					   const jvm_loadgen_options *options, FILE *out);
+
+#endif //__JVM_LOADGEN_H__
@@ -0,0 +1,393 @@
+#define _GNU_SOURCE
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "jvm_metrics.h"
+
+// Histogram buckets: the k-th one holds the latencies up to 2^k microseconds
+#define METRICS_BUCKETS 24
+// Bytes of the HTTP request read before answering it
+#define METRICS_REQUEST_SIZE 4096
+// Seconds a scraper has to send its request
+#define METRICS_REQUEST_TIMEOUT 1
+#define METRICS_PATH "/metrics"
+
+/**
+ * Counters and histograms updated by a single thread. Only their owner writes
+ * them, so a relaxed load and store is enough for the scraper to read whole
+ * values, without the cost of an atomic read-modify-write
+ */
+typedef struct metrics_shard {
+	uint64_t counters[JVM_COUNTERS];
+	uint64_t buckets[JVM_PHASES][METRICS_BUCKETS + 1];
+	uint64_t nanoseconds[JVM_PHASES];
+	struct metrics_shard *next;
+} metrics_shard;
+
+static metrics_shard *shards = NULL;
+// Totals of the threads already finished, so counters never go back
+static metrics_shard retired;
+static pthread_mutex_t shards_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread metrics_shard *thread_shard = NULL;
+
+static int64_t gauges[JVM_GAUGES];
+
+// Instructions and time of the previous scrape, to compute the rate
+static pthread_mutex_t render_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t last_instructions = 0;
+static double last_scrape = -1;
+
+static const char *COUNTER_NAMES[JVM_COUNTERS][2] = {
+	{"jvm_connections_accepted_total", "Connections accepted"},
+	{"jvm_requests_total", "Requests served"},
+	{"jvm_requests_failed_total", "Requests answered with a failure"},
+	{"jvm_received_bytes_total", "Bytes received from the clients"},
+	{"jvm_sent_bytes_total", "Bytes sent to the clients"},
+	{"jvm_instructions_total", "Byte codes executed"},
+	{"jvm_shed_connections_total",
+	 "Connections closed as soon as accepted because the server was full"},
+	{"jvm_shed_queue_total",
+	 "Requests rejected because the run queue of the workers was full"},
+	{"jvm_shed_cost_total",
+	 "Requests rejected because of the size of their program and variables"},
+	{"jvm_shed_instructions_total",
+	 "Requests stopped once they executed the maximum of byte codes"},
+	{"jvm_faults_total",
+	 "Requests stopped by a division or an operand stack that faulted"}
+};
+
+static const char *PHASE_NAMES[JVM_PHASES] = {
+	"header", "receive", "decode", "execute", "dump", "send"
+};
+
+static const char *GAUGE_NAMES[JVM_GAUGES][3] = {
+	{"jvm_connections_active", "gauge", "Connections being served"},
+	{"jvm_sessions", "gauge", "Named sessions kept by the server"},
+	{"jvm_session_bytes", "gauge",
+	 "Bytes of the variables and operands of the sessions"},
+	{"jvm_session_hits_total", "counter", "Requests that found their session"},
+	{"jvm_session_misses_total", "counter",
+	 "Requests that created their session"},
+	{"jvm_session_evictions_total", "counter", "Sessions evicted"}
+};
+
+/**
+ * Static function that returns the shard of the calling thread, registering
+ * it the first time
+ */
+static metrics_shard *own_shard(void) {
+	if (!thread_shard) {
+		// Without memory the samples of the thread are dropped
+		metrics_shard *shard = (metrics_shard *) calloc(1, sizeof(*shard));
+		if (!shard) {
+			return NULL;
+		}
+		pthread_mutex_lock(&shards_lock);
+		shard->next = shards;
+		shards = shard;
+		pthread_mutex_unlock(&shards_lock);
+		thread_shard = shard;
+	}
+	return thread_shard;
+}
+
+static void increment(uint64_t *value, uint64_t delta) {
+	__atomic_store_n(value, __atomic_load_n(value, __ATOMIC_RELAXED) + delta,
+					 __ATOMIC_RELAXED);
+}
+
+/**
+ * Static function that adds the counters and histograms of {@param shard} to
+ * {@param total}
+ */
+static void accumulate(metrics_shard *total, metrics_shard *shard) {
+	for (int i = 0; i < JVM_COUNTERS; i++) {
+		total->counters[i] += __atomic_load_n(&shard->counters[i],
+											  __ATOMIC_RELAXED);
+	}
+	for (int p = 0; p < JVM_PHASES; p++) {
+		for (int b = 0; b <= METRICS_BUCKETS; b++) {
+			total->buckets[p][b] += __atomic_load_n(&shard->buckets[p][b],
+													__ATOMIC_RELAXED);
+		}
+		total->nanoseconds[p] += __atomic_load_n(&shard->nanoseconds[p],
+												 __ATOMIC_RELAXED);
+	}
+}
+
+void jvm_metrics_thread_exit(void) {
+	metrics_shard *shard = thread_shard;
+	if (!shard) {
+		return;
+	}
+	pthread_mutex_lock(&shards_lock);
+	metrics_shard **link = &shards;
+	while (*link != shard) {
+		link = &(*link)->next;
+	}
+	*link = shard->next;
+	accumulate(&retired, shard);
+	pthread_mutex_unlock(&shards_lock);
+	free(shard);
+	thread_shard = NULL;
+}
+
+void jvm_metrics_add(jvm_counter counter, uint64_t value) {
+	metrics_shard *shard = own_shard();
+	if (shard) {
+		increment(&shard->counters[counter], value);
+	}
+}
+
+void jvm_metrics_observe(jvm_phase phase, double seconds) {
+	metrics_shard *shard = own_shard();
+	if (!shard) {
+		return;
+	}
+	uint64_t nanoseconds = (seconds > 0) ? (uint64_t) (seconds * 1e9) : 0;
+	uint64_t microseconds = nanoseconds / 1000;
+	// The bucket is the bit length of the latency in microseconds
+	int bucket = microseconds ? 64 - __builtin_clzll(microseconds) : 0;
+	if (bucket > METRICS_BUCKETS) {
+		bucket = METRICS_BUCKETS;
+	}
+	increment(&shard->buckets[phase][bucket], 1);
+	increment(&shard->nanoseconds[phase], nanoseconds);
+}
+
+const char *jvm_metrics_phase_name(jvm_phase phase) {
+	return PHASE_NAMES[phase];
+}
+
+void jvm_metrics_set(jvm_gauge gauge, int64_t value) {
+	__atomic_store_n(&gauges[gauge], value, __ATOMIC_RELAXED);
+}
+
+void jvm_metrics_gauge_add(jvm_gauge gauge, int64_t delta) {
+	__atomic_fetch_add(&gauges[gauge], delta, __ATOMIC_RELAXED);
+}
+
+double jvm_metrics_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+/**
+ * Static function that adds up the counters and histograms of every shard in
+ * {@param total}
+ */
+static void aggregate(metrics_shard *total) {
+	memset(total, 0, sizeof(metrics_shard));
+	pthread_mutex_lock(&shards_lock);
+	accumulate(total, &retired);
+	for (metrics_shard *shard = shards; shard; shard = shard->next) {
+		accumulate(total, shard);
+	}
+	pthread_mutex_unlock(&shards_lock);
+}
+
+/**
+ * Static function that writes the latency histograms of {@param total}
+ */
+static void render_phases(FILE *out, const metrics_shard *total) {
+	fprintf(out, "# HELP jvm_phase_seconds Latency of each phase of the "
+				 "requests\n# TYPE jvm_phase_seconds histogram\n");
+	for (int p = 0; p < JVM_PHASES; p++) {
+		uint64_t cumulative = 0;
+		for (int b = 0; b < METRICS_BUCKETS; b++) {
+			cumulative += total->buckets[p][b];
+			fprintf(out, "jvm_phase_seconds_bucket{phase=\"%s\",le=\"%g\"} "
+						 "%llu\n", PHASE_NAMES[p],
+					(double) ((uint64_t) 1 << b) / 1e6,
+					(unsigned long long) cumulative);
+		}
+		cumulative += total->buckets[p][METRICS_BUCKETS];
+		fprintf(out, "jvm_phase_seconds_bucket{phase=\"%s\",le=\"+Inf\"} "
+					 "%llu\n", PHASE_NAMES[p], (unsigned long long) cumulative);
+		fprintf(out, "jvm_phase_seconds_sum{phase=\"%s\"} %.9f\n",
+				PHASE_NAMES[p], (double) total->nanoseconds[p] / 1e9);
+		fprintf(out, "jvm_phase_seconds_count{phase=\"%s\"} %llu\n",
+				PHASE_NAMES[p], (unsigned long long) cumulative);
+	}
+}
+
+/**
+ * Static function that writes the statistics of the allocator
+ */
+static void render_allocator(FILE *out) {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+	struct mallinfo2 info = mallinfo2();
+	const char *names[][2] = {
+		{"jvm_malloc_arena_bytes", "Bytes obtained with brk by malloc"},
+		{"jvm_malloc_mapped_bytes", "Bytes of the blocks mapped by malloc"},
+		{"jvm_malloc_used_bytes", "Bytes allocated and not released"},
+		{"jvm_malloc_free_bytes", "Bytes released and kept by malloc"}
+	};
+	size_t values[] = {info.arena, info.hblkhd, info.uordblks + info.hblkhd,
+					   info.fordblks};
+	for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+		fprintf(out, "# HELP %s %s\n# TYPE %s gauge\n%s %zu\n", names[i][0],
+				names[i][1], names[i][0], names[i][0], values[i]);
+	}
+#else
+	(void) out;
+#endif
+}
+
+operation_result jvm_metrics_render(char **text, size_t *length) {
+	FILE *out = open_memstream(text, length);
+	if (!out) {
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
+	metrics_shard total;
+	aggregate(&total);
+
+	for (int i = 0; i < JVM_COUNTERS; i++) {
+		fprintf(out, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n",
+				COUNTER_NAMES[i][0], COUNTER_NAMES[i][1], COUNTER_NAMES[i][0],
+				COUNTER_NAMES[i][0], (unsigned long long) total.counters[i]);
+	}
+	int64_t values[JVM_GAUGES];
+	for (int i = 0; i < JVM_GAUGES; i++) {
+		values[i] = __atomic_load_n(&gauges[i], __ATOMIC_RELAXED);
+		fprintf(out, "# HELP %s %s\n# TYPE %s %s\n%s %lld\n",
+				GAUGE_NAMES[i][0], GAUGE_NAMES[i][2], GAUGE_NAMES[i][0],
+				GAUGE_NAMES[i][1], GAUGE_NAMES[i][0], (long long) values[i]);
+	}
+	int64_t lookups = values[JVM_GAUGE_SESSION_HITS] +
+					  values[JVM_GAUGE_SESSION_MISSES];
+	fprintf(out, "# HELP jvm_session_hit_ratio Requests that found their "
+				 "session over all the session requests\n"
+				 "# TYPE jvm_session_hit_ratio gauge\n"
+				 "jvm_session_hit_ratio %g\n",
+			lookups ? (double) values[JVM_GAUGE_SESSION_HITS] / lookups : 0.0);
+
+	// The rate is measured between two scrapes (or since the first request)
+	pthread_mutex_lock(&render_lock);
+	double now = jvm_metrics_now();
+	uint64_t instructions = total.counters[JVM_COUNTER_INSTRUCTIONS];
+	double elapsed = (last_scrape < 0) ? 0 : now - last_scrape;
+	double rate = (elapsed > 0) ? (double) (instructions - last_instructions) /
+								  elapsed : 0;
+	last_scrape = now;
+	last_instructions = instructions;
+	pthread_mutex_unlock(&render_lock);
+	fprintf(out, "# HELP jvm_instructions_per_second Byte codes executed per "
+				 "second since the previous scrape\n"
+				 "# TYPE jvm_instructions_per_second gauge\n"
+				 "jvm_instructions_per_second %.1f\n", rate);
+
+	render_phases(out, &total);
+	render_allocator(out);
+	if (fclose(out) != 0) {
+		free(*text);
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
+	return OPERATION_SUCCESS;
+}
+
+/**
+ * Static function that reads the HTTP request of the scraper connected
+ * through {@param skt} until its headers end
+ * @return true if it asks for the metrics
+ */
+static bool read_request(socket_t *skt) {
+	struct timeval timeout = {METRICS_REQUEST_TIMEOUT, 0};
+	setsockopt(skt->fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	char request[METRICS_REQUEST_SIZE + 1];
+	size_t received = 0;
+	request[0] = '\0';
+	// The request isn't followed by a shutdown, so it's read as it arrives
+	while (received < METRICS_REQUEST_SIZE && !strstr(request, "\r\n\r\n")) {
+		ssize_t s = recv(skt->fd, &request[received],
+						 METRICS_REQUEST_SIZE - received, 0);
+		if (s <= 0) {
+			break;
+		}
+		received += (size_t) s;
+		request[received] = '\0';
+	}
+	const char *method = "GET ";
+	size_t path_length = strlen(METRICS_PATH);
+	return strncmp(request, method, strlen(method)) == 0 &&
+		   strncmp(&request[strlen(method)], METRICS_PATH, path_length) == 0 &&
+		   strchr(" ?", request[strlen(method) + path_length]);
+}
+
+/**
+ * Static function that answers the scraper connected through {@param skt}
+ */
+static void answer_scrape(socket_t *skt) {
+	char *body = NULL;
+	size_t length = 0;
+	const char *status = "404 Not Found";
+	if (!read_request(skt)) {
+		body = NULL;
+	} else if (jvm_metrics_render(&body, &length) == OPERATION_SUCCESS) {
+		status = "200 OK";
+	} else {
+		status = "500 Internal Server Error";
+	}
+	char header[256];
+	int header_length = snprintf(header, sizeof(header),
+								 "HTTP/1.1 %s\r\n"
+								 "Content-Type: text/plain; version=0.0.4\r\n"
+								 "Content-Length: %zu\r\n"
+								 "Connection: close\r\n\r\n",
+								 status, body ? length : 0);
+	if (socket_send_more(skt, header, header_length) !=
+		SOCKET_CONNECTION_ERROR && body) {
+		socket_send(skt, body, (long) length);
+	}
+	free(body);
+}
+
+/**
+ * Static function run by the thread of the listener, that answers the scrapes
+ * until the listener is shutdown
+ */
+static void *serve_scrapes(void *arg) {
+	jvm_metrics_listener *self = (jvm_metrics_listener *) arg;
+	socket_t scraper;
+	while (socket_accept(&self->_socket, &scraper) ==
+		   SOCKET_CONNECTION_SUCCESS) {
+		answer_scrape(&scraper);
+		socket_close(&scraper);
+	}
+	return NULL;
+}
+
+operation_result jvm_metrics_listen(jvm_metrics_listener *self,
+									const char *address) {
+	if (!self || !address)
+		return OPERATION_FAILURE_NULL_POINTER;
+	self->_path = strchr(address, '/') ? address : NULL;
+	if ((self->_path ? socket_bind_unix(&self->_socket, address)
+					 : socket_bind_and_address(&self->_socket, address, false)) ==
+		SOCKET_CONNECTION_ERROR) {
+		return OPERATION_FAILURE_CONNECTION_FAILED;
+	}
+	if (pthread_create(&self->_thread, NULL, serve_scrapes, self) != 0) {
+		socket_close(&self->_socket);
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
+	return OPERATION_SUCCESS;
+}
+
+void jvm_metrics_stop(jvm_metrics_listener *self) {
+	// Wakes up the accept of the thread, which then finishes
+	socket_shutdown(&self->_socket, SHUT_RDWR);
+	pthread_join(self->_thread, NULL);
+	socket_close(&self->_socket);
+	if (self->_path) {
+		unlink(self->_path);
+	}
+}
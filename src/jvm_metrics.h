@@ -0,0 +1,133 @@
+#ifndef __JVM_METRICS_H__
+#define __JVM_METRICS_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "result.h"
+#include "socket.h"
+
+/**
+ * Monotonic counters of the server. Each thread updates its own copy, so
+ * counting costs a plain increment, and they're added up when scraped
+ */
+typedef enum jvm_counter {
+	JVM_COUNTER_CONNECTIONS,
+	JVM_COUNTER_REQUESTS,
+	JVM_COUNTER_FAILED_REQUESTS,
+	JVM_COUNTER_BYTES_RECEIVED,
+	JVM_COUNTER_BYTES_SENT,
+	JVM_COUNTER_INSTRUCTIONS,
+	JVM_COUNTER_SHED_CONNECTIONS,
+	JVM_COUNTER_SHED_QUEUE,
+	JVM_COUNTER_SHED_COST,
+	JVM_COUNTER_SHED_INSTRUCTIONS,
+	JVM_COUNTER_FAULTS,
+	JVM_COUNTERS
+} jvm_counter;
+
+/**
+ * Phases of a request whose latency is kept in a histogram:
+ *          - header: waiting for the quantity of variables of a legacy request
+ *          - receive: reading the program from the client
+ *          - decode: validating the request and preparing its variables
+ *          - execute: running the byte_codes
+ *          - dump: printing the variables in stdout
+ *          - send: sending the variables back
+ */
+typedef enum jvm_phase {
+	JVM_PHASE_HEADER,
+	JVM_PHASE_RECEIVE,
+	JVM_PHASE_DECODE,
+	JVM_PHASE_EXECUTE,
+	JVM_PHASE_DUMP,
+	JVM_PHASE_SEND,
+	JVM_PHASES
+} jvm_phase;
+
+/**
+ * Values of the server set as a whole, rather than counted per thread. The
+ * ones of the session table are totals kept by the table itself
+ */
+typedef enum jvm_gauge {
+	JVM_GAUGE_ACTIVE_CONNECTIONS,
+	JVM_GAUGE_SESSIONS,
+	JVM_GAUGE_SESSION_BYTES,
+	JVM_GAUGE_SESSION_HITS,
+	JVM_GAUGE_SESSION_MISSES,
+	JVM_GAUGE_SESSION_EVICTIONS,
+	JVM_GAUGES
+} jvm_gauge;
+
+/**
+ * Admin listener that answers the scrapes of the metrics from its own thread
+ */
+typedef struct jvm_metrics_listener {
+	socket_t _socket;
+	pthread_t _thread;
+	const char *_path;
+} jvm_metrics_listener;
+
+/**
+ * Adds {@param value} to the {@param counter} of the calling thread
+ */
+void jvm_metrics_add(jvm_counter counter, uint64_t value);
+
+/**
+ * Folds the counters and histograms of the calling thread, which is about to
+ * finish, into the totals of the finished threads
+ */
+void jvm_metrics_thread_exit(void);
+
+/**
+ * Records that the {@param phase} of a request took {@param seconds} in the
+ * histogram of the calling thread
+ */
+void jvm_metrics_observe(jvm_phase phase, double seconds);
+
+/**
+ * Returns the name of the {@param phase}, as it's labeled when scraped
+ */
+const char *jvm_metrics_phase_name(jvm_phase phase);
+
+/**
+ * Sets the {@param gauge} to {@param value}
+ */
+void jvm_metrics_set(jvm_gauge gauge, int64_t value);
+
+/**
+ * Adds {@param delta} (which may be negative) to the {@param gauge}
+ */
+void jvm_metrics_gauge_add(jvm_gauge gauge, int64_t delta);
+
+/**
+ * Returns the seconds elapsed since an arbitrary point, to time the phases
+ */
+double jvm_metrics_now(void);
+
+/**
+ * Renders every metric in the Prometheus text format, adding up the counters
+ * and histograms of all the threads
+ * @post    {@param text} must be released with free
+ * @return  {@link operation_result} with the result of the operation
+ */
+operation_result jvm_metrics_render(char **text, size_t *length);
+
+/**
+ * Starts the {@param self} listener in {@param address}: a unix domain socket
+ * if it contains a '/', a TCP port otherwise. Every connection is answered with
+ * the rendered metrics as an HTTP response, from a thread of its own
+ * @return  {@link operation_result} with the result of the operation
+ */
+operation_result jvm_metrics_listen(jvm_metrics_listener *self,
+									const char *address);
+
+/**
+ * Stops the {@param self} listener, waiting for its thread to finish
+ * @post    The socket (and its path) is released
+ */
+void jvm_metrics_stop(jvm_metrics_listener *self);
+
+#endif //__JVM_METRICS_H__
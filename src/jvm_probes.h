@@ -0,0 +1,97 @@
+#ifndef __JVM_PROBES_H__
+#define __JVM_PROBES_H__
+
+/**
+ * Static tracepoints of the server in the SystemTap SDT format, so bpftrace,
+ * perf or stap attach to them in a running server without rebuilding it:
+ *          bpftrace -e 'usdt:./remoteJVM:remotejvm:chunk_received { ... }'
+ * A disabled probe is a single nop. The ones in hot loops are also guarded by
+ * a semaphore, which the tracer increments while attached, so their arguments
+ * aren't even computed otherwise. Every argument is passed as a signed 64 bit
+ * integer. The note is written by hand (as <sys/sdt.h> does), so probes are
+ * only emitted for x86-64 and vanish elsewhere or with -DJVM_NO_PROBES
+ */
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(JVM_NO_PROBES)
+
+#define JVM_PROBE_PROVIDER "remotejvm"
+
+#define JVM_PROBE_SEMAPHORE_NAME(name) remotejvm_##name##_semaphore
+
+// The stapsdt note of a probe: its address, the base used to relocate it, its
+// semaphore (or 0), provider, name and the location of its arguments
+#define JVM_PROBE_ASM(name, semaphore, args) \
+	"990: nop\n" \
+	".pushsection .note.stapsdt,\"\",\"note\"\n" \
+	".balign 4\n" \
+	".4byte 992f-991f, 994f-993f, 3\n" \
+	"991: .asciz \"stapsdt\"\n" \
+	"992: .balign 4\n" \
+	"993: .8byte 990b\n" \
+	".8byte _.stapsdt.base\n" \
+	".8byte " semaphore "\n" \
+	".asciz \"" JVM_PROBE_PROVIDER "\"\n" \
+	".asciz \"" #name "\"\n" \
+	".asciz \"" args "\"\n" \
+	"994: .balign 4\n" \
+	".popsection\n" \
+	".ifndef _.stapsdt.base\n" \
+	".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n" \
+	".weak _.stapsdt.base\n" \
+	".hidden _.stapsdt.base\n" \
+	"_.stapsdt.base: .space 1\n" \
+	".size _.stapsdt.base, 1\n" \
+	".popsection\n" \
+	".endif\n"
+
+#define JVM_PROBE_ARG(a) "nor" ((long) (a))
+
+#define JVM_PROBE1(name, a) \
+	__asm__ __volatile__(JVM_PROBE_ASM(name, "0", "-8@%0") \
+						 : : JVM_PROBE_ARG(a))
+#define JVM_PROBE2(name, a, b) \
+	__asm__ __volatile__(JVM_PROBE_ASM(name, "0", "-8@%0 -8@%1") \
+						 : : JVM_PROBE_ARG(a), JVM_PROBE_ARG(b))
+#define JVM_PROBE3(name, a, b, c) \
+	__asm__ __volatile__(JVM_PROBE_ASM(name, "0", "-8@%0 -8@%1 -8@%2") \
+						 : : JVM_PROBE_ARG(a), JVM_PROBE_ARG(b), \
+						 JVM_PROBE_ARG(c))
+
+/**
+ * Defines the semaphore of the probe {@param name}, in a single file
+ */
+#define JVM_PROBE_SEMAPHORE(name) \
+	volatile unsigned short JVM_PROBE_SEMAPHORE_NAME(name) \
+	__attribute__((section(".probes"), used)) = 0
+
+/**
+ * Whether a tracer is attached to the probe {@param name}
+ */
+#define JVM_PROBE_ENABLED(name) \
+	__builtin_expect(JVM_PROBE_SEMAPHORE_NAME(name) != 0, 0)
+
+/**
+ * Probe {@param name} guarded by its semaphore
+ */
+#define JVM_PROBE2_GUARDED(name, a, b) \
+	do { \
+		if (JVM_PROBE_ENABLED(name)) { \
+			__asm__ __volatile__( \
+					JVM_PROBE_ASM(name, \
+						"remotejvm_" #name "_semaphore", "-8@%0 -8@%1") \
+					: : JVM_PROBE_ARG(a), JVM_PROBE_ARG(b)); \
+		} \
+	} while (0)
+
+#else
+
+#define JVM_PROBE1(name, a) ((void) 0)
+#define JVM_PROBE2(name, a, b) ((void) 0)
+#define JVM_PROBE3(name, a, b, c) ((void) 0)
+#define JVM_PROBE_SEMAPHORE(name) extern int jvm_probes_disabled
+#define JVM_PROBE_ENABLED(name) 0
+#define JVM_PROBE2_GUARDED(name, a, b) ((void) 0)
+
+#endif
+
+#endif //__JVM_PROBES_H__
@@ -0,0 +1,427 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include "jvm_protocol.h"
+
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define REQUEST_HEADER_INTS 4
+#define RESPONSE_HEADER_INTS 3
+#define ENCODING_HEADER_INTS 2
+// Shorter zero runs are cheaper as literals than as a new segment
+#define ENCODING_MIN_ZERO_RUN 3
+// Reversed polynomial of the CRC-32 of zlib
+#define CHECKSUM_POLYNOMIAL 0xEDB88320u
+#define CHECKSUM_TABLE_SIZE 256
+#define BYTE_BITS 8
+// The checksum is computed 8 bytes at a time, with a table for each of them
+#define CHECKSUM_SLICE 8
+
+static uint32_t checksum_table[CHECKSUM_SLICE][CHECKSUM_TABLE_SIZE];
+static pthread_once_t checksum_table_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Static function that sends {@param quantity} ints in a single message, each
+ * one of them transformed to big endian. If {@param more} is true, the message
+ * is coalesced with the data that follows it
+ */
+static int send_ints(socket_t *skt, const uint32_t *values, int quantity,
+					 bool more) {
+	uint32_t buffer[REQUEST_HEADER_INTS];
+	for (int i = 0; i < quantity; i++) {
+		buffer[i] = htonl(values[i]);
+	}
+	long size = quantity * (long) sizeof(uint32_t);
+	long sent = more ? socket_send_more(skt, (const char *) buffer, size)
+					 : socket_send(skt, (const char *) buffer, size);
+	return (sent == size) ? SOCKET_CONNECTION_SUCCESS : SOCKET_CONNECTION_ERROR;
+}
+
+/**
+ * Static function that receives {@param quantity} big endian ints
+ */
+static int recv_ints(socket_t *skt, uint32_t *values, int quantity) {
+	uint32_t buffer[REQUEST_HEADER_INTS];
+	long size = quantity * (long) sizeof(uint32_t);
+	long received = socket_recv(skt, (char *) buffer, size);
+	if (received == 0) {
+		return PROTOCOL_END_OF_STREAM;
+	} else if (received != size) {
+		return SOCKET_CONNECTION_ERROR;
+	}
+	for (int i = 0; i < quantity; i++) {
+		values[i] = ntohl(buffer[i]);
+	}
+	return SOCKET_CONNECTION_SUCCESS;
+}
+
+int jvm_protocol_send_request_header(socket_t *skt,
+									 const jvm_request_header *header) {
+	uint32_t values[REQUEST_HEADER_INTS] = {
+			header->id, (uint32_t) header->var_size, header->flags,
+			header->program_length
+	};
+	return send_ints(skt, values, REQUEST_HEADER_INTS,
+					 header->program_length > 0 ||
+					 (header->flags & (PROTOCOL_FLAG_PROJECTION |
+									   PROTOCOL_FLAG_SESSION)));
+}
+
+int jvm_protocol_recv_request_header(socket_t *skt,
+									 jvm_request_header *header) {
+	uint32_t values[REQUEST_HEADER_INTS];
+	int s = recv_ints(skt, values, REQUEST_HEADER_INTS);
+	if (s == SOCKET_CONNECTION_SUCCESS) {
+		header->id = values[0];
+		header->var_size = (int32_t) values[1];
+		header->flags = values[2];
+		header->program_length = values[3];
+	}
+	return s;
+}
+
+int jvm_protocol_send_response_header(socket_t *skt,
+									  const jvm_response_header *header) {
+	uint32_t values[RESPONSE_HEADER_INTS] = {
+			header->id, (uint32_t) header->status, (uint32_t) header->var_size
+	};
+	return send_ints(skt, values, RESPONSE_HEADER_INTS, header->var_size > 0);
+}
+
+int jvm_protocol_recv_response_header(socket_t *skt,
+									  jvm_response_header *header) {
+	uint32_t values[RESPONSE_HEADER_INTS];
+	int s = recv_ints(skt, values, RESPONSE_HEADER_INTS);
+	if (s == SOCKET_CONNECTION_SUCCESS) {
+		header->id = values[0];
+		header->status = (int32_t) values[1];
+		header->var_size = (int32_t) values[2];
+	}
+	return s;
+}
+
+int jvm_protocol_send_session(socket_t *skt, const char *name, bool more) {
+	uint32_t length = (uint32_t) strlen(name);
+	if (send_ints(skt, &length, 1, true) == SOCKET_CONNECTION_ERROR) {
+		return SOCKET_CONNECTION_ERROR;
+	}
+	long sent = more ? socket_send_more(skt, name, length)
+					 : socket_send(skt, name, length);
+	return (sent == length) ? SOCKET_CONNECTION_SUCCESS
+							: SOCKET_CONNECTION_ERROR;
+}
+
+int jvm_protocol_recv_session(socket_t *skt, char **name) {
+	uint32_t length;
+	if (recv_ints(skt, &length, 1) != SOCKET_CONNECTION_SUCCESS ||
+		length == 0 || length > PROTOCOL_MAX_SESSION_NAME) {
+		return SOCKET_CONNECTION_ERROR;
+	}
+	char *received = (char *) malloc(length + 1);
+	if (!received) {
+		return SOCKET_CONNECTION_ERROR;
+	}
+	if (socket_recv(skt, received, length) != length ||
+		memchr(received, '\0', length)) {
+		free(received);
+		return SOCKET_CONNECTION_ERROR;
+	}
+	received[length] = '\0';
+	*name = received;
+	return SOCKET_CONNECTION_SUCCESS;
+}
+
+int jvm_protocol_send_projection(socket_t *skt, const jvm_range *ranges,
+								 uint32_t count, bool more) {
+	int *values = (int *) malloc((2 * (size_t) count + 1) * sizeof(int));
+	if (!values) {
+		return SOCKET_CONNECTION_ERROR;
+	}
+	values[0] = (int) count;
+	for (uint32_t i = 0; i < count; i++) {
+		values[1 + 2 * i] = (int) ranges[i].first;
+		values[2 + 2 * i] = (int) ranges[i].count;
+	}
+	long quantity = 2 * (long) count + 1;
+	long sent = more ? socket_send_ints_more(skt, values, quantity)
+					 : socket_send_ints(skt, values, quantity);
+	free(values);
+	return (sent == SOCKET_CONNECTION_ERROR) ? SOCKET_CONNECTION_ERROR
+											 : SOCKET_CONNECTION_SUCCESS;
+}
+
+int jvm_protocol_recv_projection(socket_t *skt, jvm_range **ranges,
+								 uint32_t *count) {
+	uint32_t quantity;
+	if (recv_ints(skt, &quantity, 1) != SOCKET_CONNECTION_SUCCESS ||
+		quantity > PROTOCOL_MAX_RANGES) {
+		return SOCKET_CONNECTION_ERROR;
+	}
+	int *values = (int *) malloc((2 * (size_t) quantity + 1) * sizeof(int));
+	jvm_range *received = (jvm_range *) malloc(((size_t) quantity + 1) *
+											   sizeof(jvm_range));
+	if (!values || !received ||
+		socket_recv_ints(skt, values, 2 * (long) quantity) ==
+		SOCKET_CONNECTION_ERROR) {
+		free(values);
+		free(received);
+		return SOCKET_CONNECTION_ERROR;
+	}
+	for (uint32_t i = 0; i < quantity; i++) {
+		received[i].first = (uint32_t) values[2 * i];
+		received[i].count = (uint32_t) values[2 * i + 1];
+	}
+	free(values);
+	*ranges = received;
+	*count = quantity;
+	return SOCKET_CONNECTION_SUCCESS;
+}
+
+/**
+ * Static function that counts the zeros of {@param vec} from {@param pos}
+ * until {@param limit}, skipping the untouched pages without reading them
+ */
+static int zeros_from(const int_vector *vec, int pos, int limit) {
+	const int *data = int_vector_data(vec);
+	int start = pos;
+	while (pos < limit) {
+		bool touched;
+		int to = int_vector_run(vec, pos, &touched);
+		if (to > limit) {
+			to = limit;
+		}
+		if (!touched) {
+			pos = to;
+			continue;
+		}
+		while (pos < to && data[pos] == 0) {
+			pos++;
+		}
+		if (pos < to) {
+			break;
+		}
+	}
+	return pos - start;
+}
+
+/**
+ * Static function that encodes {@param vec} as (index, value) pairs in
+ * {@param out}, or only counts them if it's NULL
+ * @return the quantity of ints of the encoding
+ */
+static long encode_pairs(const int_vector *vec, int *out) {
+	const int *data = int_vector_data(vec);
+	int size = int_vector_size(vec);
+	long words = 0;
+	for (int from = 0; from < size;) {
+		bool touched;
+		int to = int_vector_run(vec, from, &touched);
+		for (int i = from; touched && i < to; i++) {
+			if (data[i] != 0 && out) {
+				out[words] = i;
+				out[words + 1] = data[i];
+			}
+			words += (data[i] != 0) ? 2 : 0;
+		}
+		from = to;
+	}
+	return words;
+}
+
+/**
+ * Static function that encodes {@param vec} as runs of zeros and literals in
+ * {@param out}, or only counts them if it's NULL
+ * @return the quantity of ints of the encoding
+ */
+static long encode_runs(const int_vector *vec, int *out) {
+	const int *data = int_vector_data(vec);
+	int size = int_vector_size(vec);
+	long words = 0;
+	int pos = 0;
+	while (pos < size) {
+		int zeros = zeros_from(vec, pos, size);
+		pos += zeros;
+		int first = pos;
+		while (pos < size) {
+			if (data[pos] != 0) {
+				pos++;
+				continue;
+			}
+			int limit = (size - pos > ENCODING_MIN_ZERO_RUN)
+						? pos + ENCODING_MIN_ZERO_RUN : size;
+			int z = zeros_from(vec, pos, limit);
+			if (z == ENCODING_MIN_ZERO_RUN || pos + z == size) {
+				break;
+			}
+			pos += z;
+		}
+		if (out) {
+			out[words] = zeros;
+			out[words + 1] = pos - first;
+			memcpy(&out[words + 2], &data[first],
+				   (size_t) (pos - first) * sizeof(int));
+		}
+		words += ENCODING_HEADER_INTS + (pos - first);
+	}
+	return words;
+}
+
+int jvm_protocol_send_variables(socket_t *skt, const int_vector *vec,
+								bool compact) {
+	int size = int_vector_size(vec);
+	uint32_t encoding = JVM_ENCODING_DENSE;
+	long words = size;
+	if (compact) {
+		long pairs = encode_pairs(vec, NULL);
+		long runs = encode_runs(vec, NULL);
+		if (pairs < words && pairs <= runs) {
+			encoding = JVM_ENCODING_PAIRS;
+			words = pairs;
+		} else if (runs < words) {
+			encoding = JVM_ENCODING_RUNS;
+			words = runs;
+		}
+		uint32_t values[ENCODING_HEADER_INTS] = {encoding, (uint32_t) words};
+		if (send_ints(skt, values, ENCODING_HEADER_INTS, words > 0) ==
+			SOCKET_CONNECTION_ERROR) {
+			return SOCKET_CONNECTION_ERROR;
+		}
+	}
+	if (encoding == JVM_ENCODING_DENSE) {
+		return (socket_send_ints(skt, int_vector_data(vec), size) ==
+				SOCKET_CONNECTION_ERROR) ? SOCKET_CONNECTION_ERROR
+										 : SOCKET_CONNECTION_SUCCESS;
+	} else if (words == 0) {
+		return SOCKET_CONNECTION_SUCCESS;
+	}
+
+	int *encoded = (int *) malloc((size_t) words * sizeof(int));
+	if (!encoded) {
+		return SOCKET_CONNECTION_ERROR;
+	}
+	if (encoding == JVM_ENCODING_PAIRS) {
+		encode_pairs(vec, encoded);
+	} else {
+		encode_runs(vec, encoded);
+	}
+	long sent = socket_send_ints(skt, encoded, words);
+	free(encoded);
+	return (sent == SOCKET_CONNECTION_ERROR) ? SOCKET_CONNECTION_ERROR
+											 : SOCKET_CONNECTION_SUCCESS;
+}
+
+/**
+ * Static function that decodes the {@param words} ints of {@param encoded}
+ * into the {@param var_size} {@param variables}
+ * @return false if the encoding refers to variables out of bounds
+ */
+static bool decode(uint32_t encoding, const int *encoded, long words,
+				   int *variables, int32_t var_size) {
+	memset(variables, 0, (size_t) var_size * sizeof(int));
+	if (encoding == JVM_ENCODING_PAIRS) {
+		for (long i = 0; i + 1 < words; i += 2) {
+			if (encoded[i] < 0 || encoded[i] >= var_size) {
+				return false;
+			}
+			variables[encoded[i]] = encoded[i + 1];
+		}
+		return words % 2 == 0;
+	}
+	long pos = 0;
+	for (long i = 0; i < words;) {
+		if (words - i < ENCODING_HEADER_INTS) {
+			return false;
+		}
+		long zeros = (uint32_t) encoded[i];
+		long literals = (uint32_t) encoded[i + 1];
+		i += ENCODING_HEADER_INTS;
+		if (literals > words - i || pos + zeros + literals > var_size) {
+			return false;
+		}
+		pos += zeros;
+		memcpy(&variables[pos], &encoded[i], (size_t) literals * sizeof(int));
+		pos += literals;
+		i += literals;
+	}
+	return true;
+}
+
+int jvm_protocol_recv_variables(socket_t *skt, int *variables,
+								int32_t var_size, bool compact) {
+	uint32_t values[ENCODING_HEADER_INTS] = {JVM_ENCODING_DENSE,
+											 (uint32_t) var_size};
+	if (compact && recv_ints(skt, values, ENCODING_HEADER_INTS) !=
+				   SOCKET_CONNECTION_SUCCESS) {
+		return SOCKET_CONNECTION_ERROR;
+	}
+	uint32_t encoding = values[0];
+	long words = values[1];
+	if (encoding > JVM_ENCODING_RUNS || words > var_size ||
+		(encoding == JVM_ENCODING_DENSE && words != var_size)) {
+		return SOCKET_CONNECTION_ERROR;
+	}
+	if (encoding == JVM_ENCODING_DENSE) {
+		return (socket_recv_ints(skt, variables, var_size) ==
+				SOCKET_CONNECTION_ERROR) ? SOCKET_CONNECTION_ERROR
+										 : SOCKET_CONNECTION_SUCCESS;
+	}
+
+	int *encoded = (int *) malloc(((size_t) words + 1) * sizeof(int));
+	if (!encoded) {
+		return SOCKET_CONNECTION_ERROR;
+	}
+	int s = SOCKET_CONNECTION_SUCCESS;
+	if (socket_recv_ints(skt, encoded, words) == SOCKET_CONNECTION_ERROR ||
+		!decode(encoding, encoded, words, variables, var_size)) {
+		s = SOCKET_CONNECTION_ERROR;
+	}
+	free(encoded);
+	return s;
+}
+
+/**
+ * Static function that fills the tables with the CRC-32 of every byte, and of
+ * every byte followed by 1 to 7 zeros
+ */
+static void fill_checksum_table(void) {
+	for (uint32_t byte = 0; byte < CHECKSUM_TABLE_SIZE; byte++) {
+		uint32_t crc = byte;
+		for (int bit = 0; bit < BYTE_BITS; bit++) {
+			crc = (crc & 1) ? (crc >> 1) ^ CHECKSUM_POLYNOMIAL : crc >> 1;
+		}
+		checksum_table[0][byte] = crc;
+	}
+	for (uint32_t byte = 0; byte < CHECKSUM_TABLE_SIZE; byte++) {
+		for (int slice = 1; slice < CHECKSUM_SLICE; slice++) {
+			uint32_t previous = checksum_table[slice - 1][byte];
+			checksum_table[slice][byte] =
+					checksum_table[0][previous & 0xFF] ^ (previous >> BYTE_BITS);
+		}
+	}
+}
+
+uint32_t jvm_protocol_checksum(uint32_t checksum, const char *data,
+							   long length) {
+	pthread_once(&checksum_table_once, fill_checksum_table);
+	const unsigned char *bytes = (const unsigned char *) data;
+	uint32_t crc = ~checksum;
+	long i = 0;
+	for (; i + CHECKSUM_SLICE <= length; i += CHECKSUM_SLICE) {
+		const unsigned char *b = &bytes[i];
+		uint32_t low = crc ^ ((uint32_t) b[0] | (uint32_t) b[1] << 8 |
+							  (uint32_t) b[2] << 16 | (uint32_t) b[3] << 24);
+		crc = checksum_table[7][low & 0xFF] ^
+			  checksum_table[6][(low >> 8) & 0xFF] ^
+			  checksum_table[5][(low >> 16) & 0xFF] ^
+			  checksum_table[4][low >> 24] ^
+			  checksum_table[3][b[4]] ^ checksum_table[2][b[5]] ^
+			  checksum_table[1][b[6]] ^ checksum_table[0][b[7]];
+	}
+	for (; i < length; i++) {
+		crc = checksum_table[0][(crc ^ bytes[i]) & 0xFF] ^ (crc >> BYTE_BITS);
+	}
+	return ~crc;
+}
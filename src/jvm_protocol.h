@@ -0,0 +1,215 @@
+#ifndef __JVM_PROTOCOL_H__
+#define __JVM_PROTOCOL_H__
+
+#include <stdint.h>
+
+#include "socket.h"
+#include "int_vector.h"
+
+/**
+ * Value sent instead of the quantity of variables as the first int of a
+ * connection to switch it to the framed protocol. Being negative, it can't be
+ * confused with a legacy quantity of variables
+ */
+#define PROTOCOL_FRAMED_MAGIC ((int32_t) 0xFFFF4A56)
+
+/**
+ * Channel through which the client and the server talk:
+ *          - TCP: TCP socket on a host and port
+ *          - UNIX: unix domain socket bound to a path, for co-located clients
+ *          - SHM: shared memory region with a name, for co-located clients.
+ *            The program and the variables aren't copied through the kernel
+ */
+typedef enum jvm_transport {
+	JVM_TRANSPORT_TCP,
+	JVM_TRANSPORT_UNIX,
+	JVM_TRANSPORT_SHM
+} jvm_transport;
+
+/**
+ * Returned by the receive functions when the peer finished the connection
+ * before sending a new header
+ */
+#define PROTOCOL_END_OF_STREAM 1
+
+/**
+ * Header sent before each program in the framed protocol. Every field travels
+ * as a 4 bytes big endian int
+ *          - id: chosen by the client, echoed in the response
+ *          - var_size: quantity of variables to store in memory
+ *          - flags: request options, any combination of PROTOCOL_FLAG_*
+ *          - program_length: quantity of byte_codes following the header
+ */
+typedef struct jvm_request_header {
+	uint32_t id;
+	int32_t var_size;
+	uint32_t flags;
+	uint32_t program_length;
+} jvm_request_header;
+
+/**
+ * Flag of a request by which the client accepts a compact encoding of the
+ * variables in its response
+ */
+#define PROTOCOL_FLAG_COMPACT 0x1
+
+/**
+ * Flag of a request followed by a projection: the quantity of ranges and, for
+ * each one of them, its first variable and its quantity of variables, every
+ * value as a 4 bytes big endian int. Only the projected variables are sent
+ * back, in the order of the ranges
+ */
+#define PROTOCOL_FLAG_PROJECTION 0x2
+
+/**
+ * Flag of a request followed by the name of a session: its length as a 4
+ * bytes big endian int and its characters. The program runs over the
+ * variables and operands kept by the server in that session, created by the
+ * first request naming it. The session name precedes the projection
+ */
+#define PROTOCOL_FLAG_SESSION 0x4
+
+/**
+ * Flag of a request whose program is preceded (after the session name and
+ * the projection) by its {@link jvm_protocol_checksum}, as a 4 bytes big
+ * endian int. A program that doesn't match it isn't executed
+ */
+#define PROTOCOL_FLAG_CHECKSUM 0x8
+#define PROTOCOL_FLAGS_SUPPORTED (PROTOCOL_FLAG_COMPACT | \
+								  PROTOCOL_FLAG_PROJECTION | \
+								  PROTOCOL_FLAG_SESSION | \
+								  PROTOCOL_FLAG_CHECKSUM)
+
+// Maximum length of the name of a session
+#define PROTOCOL_MAX_SESSION_NAME 255
+
+// Maximum quantity of ranges in a projection
+#define PROTOCOL_MAX_RANGES 65536
+
+/**
+ * Range of consecutive variables of a projection
+ */
+typedef struct jvm_range {
+	uint32_t first;
+	uint32_t count;
+} jvm_range;
+
+/**
+ * Encoding of the variables of a response to a request with
+ * PROTOCOL_FLAG_COMPACT. The server picks the one taking fewer ints:
+ *          - DENSE: every variable, in order
+ *          - PAIRS: an (index, value) pair for each variable that isn't zero
+ *          - RUNS: segments of a quantity of zeros, a quantity of literal
+ *            values and the literals themselves
+ */
+typedef enum jvm_encoding {
+	JVM_ENCODING_DENSE = 0,
+	JVM_ENCODING_PAIRS = 1,
+	JVM_ENCODING_RUNS = 2
+} jvm_encoding;
+
+/**
+ * Header sent before the variables in the framed protocol. Every field travels
+ * as a 4 bytes big endian int
+ *          - id: id of the request being answered
+ *          - status: {@link operation_result} of the request
+ *          - var_size: quantity of variables following the header
+ */
+typedef struct jvm_response_header {
+	uint32_t id;
+	int32_t status;
+	int32_t var_size;
+} jvm_response_header;
+
+/**
+ * Function that sends the {@param header} through {@param skt}
+ * @return SOCKET_CONNECTION_SUCCESS or SOCKET_CONNECTION_ERROR
+ */
+int jvm_protocol_send_request_header(socket_t *skt,
+									 const jvm_request_header *header);
+
+/**
+ * Function that receives a request header from {@param skt} in {@param header}
+ * @return SOCKET_CONNECTION_SUCCESS, PROTOCOL_END_OF_STREAM or
+ *         SOCKET_CONNECTION_ERROR
+ */
+int jvm_protocol_recv_request_header(socket_t *skt,
+									 jvm_request_header *header);
+
+/**
+ * Function that sends the {@param header} through {@param skt}
+ * @return SOCKET_CONNECTION_SUCCESS or SOCKET_CONNECTION_ERROR
+ */
+int jvm_protocol_send_response_header(socket_t *skt,
+									  const jvm_response_header *header);
+
+/**
+ * Function that receives a response header from {@param skt} in {@param header}
+ * @return SOCKET_CONNECTION_SUCCESS, PROTOCOL_END_OF_STREAM or
+ *         SOCKET_CONNECTION_ERROR
+ */
+int jvm_protocol_recv_response_header(socket_t *skt,
+									  jvm_response_header *header);
+
+/**
+ * Function that sends the session {@param name} through {@param skt}. If
+ * {@param more} is true, it's coalesced with the data that follows it
+ * @return SOCKET_CONNECTION_SUCCESS or SOCKET_CONNECTION_ERROR
+ */
+int jvm_protocol_send_session(socket_t *skt, const char *name, bool more);
+
+/**
+ * Function that receives a session name from {@param skt}
+ * @post   {@param name} points to the name received, null terminated, that
+ *         must be released with free
+ * @return SOCKET_CONNECTION_SUCCESS or SOCKET_CONNECTION_ERROR if the
+ *         connection failed or the name is empty or longer than
+ *         PROTOCOL_MAX_SESSION_NAME
+ */
+int jvm_protocol_recv_session(socket_t *skt, char **name);
+
+/**
+ * Function that sends the {@param count} {@param ranges} of a projection
+ * through {@param skt}. If {@param more} is true, they are coalesced with the
+ * data that follows them
+ * @return SOCKET_CONNECTION_SUCCESS or SOCKET_CONNECTION_ERROR
+ */
+int jvm_protocol_send_projection(socket_t *skt, const jvm_range *ranges,
+								 uint32_t count, bool more);
+
+/**
+ * Function that receives a projection from {@param skt}
+ * @post   {@param ranges} points to the {@param count} ranges received, that
+ *         must be released with free
+ * @return SOCKET_CONNECTION_SUCCESS or SOCKET_CONNECTION_ERROR if the
+ *         connection failed or there are more than PROTOCOL_MAX_RANGES
+ */
+int jvm_protocol_recv_projection(socket_t *skt, jvm_range **ranges,
+								 uint32_t *count);
+
+/**
+ * Function that sends the variables of {@param vec} through {@param skt}. If
+ * {@param compact} is true they are preceded by the {@link jvm_encoding} used
+ * and the quantity of ints following it, each one as a 4 bytes big endian int
+ * @return SOCKET_CONNECTION_SUCCESS or SOCKET_CONNECTION_ERROR
+ */
+int jvm_protocol_send_variables(socket_t *skt, const int_vector *vec,
+								bool compact);
+
+/**
+ * Function that receives the {@param var_size} variables of a response in
+ * {@param variables}, decoding them if {@param compact} is true
+ * @return SOCKET_CONNECTION_SUCCESS or SOCKET_CONNECTION_ERROR
+ */
+int jvm_protocol_recv_variables(socket_t *skt, int *variables,
+								int32_t var_size, bool compact);
+
+/**
+ * Function that continues the CRC-32 {@param checksum} (the one of zlib, 0
+ * for no data) with the {@param length} bytes of {@param data}
+ * @return the checksum of the data seen so far
+ */
+uint32_t jvm_protocol_checksum(uint32_t checksum, const char *data,
+							   long length);
+
+#endif //__JVM_PROTOCOL_H__
@@ -0,0 +1,590 @@
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jvm_register.h"
+#include "jvm_engine.h"
+#include "jvm_fault.h"
+#include "jvm_utils.h"
+
+#define INITIAL_CAPACITY 1024
+// Values that bipush can push, whose constants are shared
+#define SMALL_CONSTANTS 256
+#define SMALL_CONSTANTS_OFFSET 128
+
+/**
+ * Kind of the symbol of an operand while the program is translated
+ */
+typedef enum operand_kind {
+	KIND_VARIABLE,
+	KIND_CONSTANT,
+	KIND_TEMPORARY
+} operand_kind;
+
+/**
+ * State of a translation: the {@link jvm_register_code} being translated,
+ * the variables it runs over, the offset of the byte_code being translated
+ * and the constant of each value pushed by bipush so far (its index plus one,
+ * 0 if there's none yet)
+ */
+typedef struct translator {
+	jvm_register_code *code;
+	int_vector *vec;
+	uint32_t start;
+	uint32_t small_constants[SMALL_CONSTANTS];
+} translator;
+
+/**
+ * Static function that returns the operand of the symbol of {@param kind}
+ * and {@param index}
+ */
+static jvm_register_operand symbol(operand_kind kind, uint32_t index) {
+	jvm_register_operand operand;
+	operand.symbol.kind = kind;
+	operand.symbol.index = index;
+	return operand;
+}
+
+/**
+ * Static function that returns whether the symbols {@param x} and {@param
+ * y} are the same one
+ */
+static bool same(jvm_register_operand x, jvm_register_operand y) {
+	return x.symbol.kind == y.symbol.kind && x.symbol.index == y.symbol.index;
+}
+
+/**
+ * Static function that doubles the {@param capacity} of the {@param array}
+ * of elements of {@param size} bytes
+ * @return  the array grown or NULL if there's no memory, in which case
+ *          {@param array} and {@param capacity} are left as they were
+ */
+static void *grow(void *array, long *capacity, size_t size) {
+	long grown = *capacity ? *capacity * 2 : INITIAL_CAPACITY;
+	void *bigger = realloc(array, (size_t) grown * size);
+	if (bigger) {
+		*capacity = grown;
+	}
+	return bigger;
+}
+
+/**
+ * Static function that appends the instruction dst = a {@param operation} b
+ * to the code of {@param self}
+ * @return  {@link operation_result} with the result of the operation
+ */
+static operation_result emit(translator *self,
+							 jvm_register_operation operation,
+							 jvm_register_operand dst,
+							 jvm_register_operand a,
+							 jvm_register_operand b) {
+	jvm_register_code *code = self->code;
+	if (code->instructions == code->_capacity) {
+		jvm_register_instruction *grown = (jvm_register_instruction *) grow(
+				code->_instructions, &code->_capacity,
+				sizeof(jvm_register_instruction));
+		if (!grown) {
+			return OPERATION_FAILURE_NO_MEMORY;
+		}
+		code->_instructions = grown;
+	}
+	jvm_register_instruction *instruction =
+			&code->_instructions[code->instructions++];
+	instruction->operation = operation;
+	instruction->start = self->start;
+	instruction->dst = dst;
+	instruction->a = a;
+	instruction->b = b;
+	return OPERATION_SUCCESS;
+}
+
+/**
+ * Static function that returns in {@param operand} the constant of {@param
+ * value} in the code of {@param self}, adding it if needed
+ * @return  {@link operation_result} with the result of the operation
+ */
+static operation_result constant(translator *self, int value,
+								 jvm_register_operand *operand) {
+	jvm_register_code *code = self->code;
+	bool small = value >= -SMALL_CONSTANTS_OFFSET &&
+				 value < SMALL_CONSTANTS - SMALL_CONSTANTS_OFFSET;
+	uint32_t *known = small
+			? &self->small_constants[value + SMALL_CONSTANTS_OFFSET] : NULL;
+	if (known && *known) {
+		*operand = symbol(KIND_CONSTANT, *known - 1);
+		return OPERATION_SUCCESS;
+	}
+	if (code->_constants_count == code->_constants_capacity) {
+		int *grown = (int *) grow(code->_constants,
+								  &code->_constants_capacity, sizeof(int));
+		if (!grown) {
+			return OPERATION_FAILURE_NO_MEMORY;
+		}
+		code->_constants = grown;
+	}
+	uint32_t index = (uint32_t) code->_constants_count++;
+	code->_constants[index] = value;
+	if (known) {
+		*known = index + 1;
+	}
+	*operand = symbol(KIND_CONSTANT, index);
+	return OPERATION_SUCCESS;
+}
+
+/**
+ * Static function that pushes the {@param operand} in the operand stack of
+ * the code of {@param self}
+ * @return  {@link operation_result} with the result of the operation, an
+ *          overflow if the stack is full
+ */
+static operation_result push(translator *self, jvm_register_operand operand) {
+	jvm_register_code *code = self->code;
+	if (code->_operands_count == STACK_CAPACITY) {
+		return OPERATION_FAILURE_STACK_OVERFLOW;
+	}
+	if (code->_operands_count == code->_operands_capacity) {
+		jvm_register_operand *grown = (jvm_register_operand *) grow(
+				code->_operands, &code->_operands_capacity,
+				sizeof(jvm_register_operand));
+		if (!grown) {
+			return OPERATION_FAILURE_NO_MEMORY;
+		}
+		code->_operands = grown;
+	}
+	code->_operands[code->_operands_count++] = operand;
+	if (code->_operands_count > code->_temporaries_count) {
+		code->_temporaries_count = code->_operands_count;
+	}
+	return OPERATION_SUCCESS;
+}
+
+/**
+ * Static function that pops the operand on the top of the stack of the code
+ * of {@param self} in {@param operand}
+ * @return  {@link operation_result} with the result of the operation, an
+ *          underflow if the stack is empty
+ */
+static operation_result pop(translator *self, jvm_register_operand *operand) {
+	jvm_register_code *code = self->code;
+	if (code->_operands_count == 0) {
+		return OPERATION_FAILURE_STACK_UNDERFLOW;
+	}
+	*operand = code->_operands[--code->_operands_count];
+	return OPERATION_SUCCESS;
+}
+
+/**
+ * Static function that returns the value of the constant {@param operand} of
+ * {@param self}, if it's one
+ */
+static bool constant_value(const translator *self,
+						   jvm_register_operand operand, int *value) {
+	if (operand.symbol.kind != KIND_CONSTANT) {
+		return false;
+	}
+	*value = self->code->_constants[operand.symbol.index];
+	return true;
+}
+
+/**
+ * Static function that applies the {@param operation} to {@param a} and
+ * {@param b} as the byte_codes do: integers wrap on overflow
+ */
+static inline int apply(jvm_register_operation operation, int a, int b) {
+	int quotient;
+	int remainder;
+	switch (operation) {
+		case JVM_REGISTER_ADD:
+			return (int) ((unsigned) a + (unsigned) b);
+		case JVM_REGISTER_SUB:
+			return (int) ((unsigned) a - (unsigned) b);
+		case JVM_REGISTER_MUL:
+			return (int) ((unsigned) a * (unsigned) b);
+		case JVM_REGISTER_DIV:
+			jvm_fault_divide(a, b, &quotient, &remainder);
+			return quotient;
+		case JVM_REGISTER_REM:
+			jvm_fault_divide(a, b, &quotient, &remainder);
+			return remainder;
+		case JVM_REGISTER_AND:
+			return a & b;
+		case JVM_REGISTER_OR:
+			return a | b;
+		case JVM_REGISTER_XOR:
+			return a ^ b;
+		case JVM_REGISTER_NEG:
+			return (int) (0u - (unsigned) a);
+		default:
+			return a;
+	}
+}
+
+/**
+ * Static function that translates a byte_code that pops {@param operands}
+ * operands (one or two) and pushes the result of {@param operation}. Constant
+ * operands are folded into a constant, unless the operation would trap
+ * @return  {@link operation_result} with the result of the operation
+ */
+static operation_result translate_operation(translator *self,
+											jvm_register_operation operation,
+											int operands) {
+	jvm_register_operand a;
+	jvm_register_operand b;
+	operation_result result = pop(self, &b);
+	a = b;
+	if (result == OPERATION_SUCCESS && operands == 2) {
+		result = pop(self, &a);
+	}
+	if (result != OPERATION_SUCCESS) {
+		return result;
+	}
+	int x;
+	int y;
+	if (constant_value(self, a, &x) && constant_value(self, b, &y)) {
+		bool divides = operation == JVM_REGISTER_DIV ||
+					   operation == JVM_REGISTER_REM;
+		if (!divides || (y != 0 && !(x == INT_MIN && y == -1))) {
+			jvm_register_operand folded;
+			result = constant(self, apply(operation, x, y), &folded);
+			return (result == OPERATION_SUCCESS) ? push(self, folded) : result;
+		}
+	}
+	// The result is the temporary of the position of the stack where it goes
+	jvm_register_operand dst = symbol(
+			KIND_TEMPORARY, (uint32_t) self->code->_operands_count);
+	result = emit(self, operation, dst, a, b);
+	return (result == OPERATION_SUCCESS) ? push(self, dst) : result;
+}
+
+/**
+ * Static function that copies the variable {@param slot} into a temporary
+ * wherever the stack of {@param self} refers to it, before it's stored, so
+ * those operands keep the value loaded
+ * @post    {@param moved} tells whether a copy was emitted
+ * @return  {@link operation_result} with the result of the operation
+ */
+static operation_result materialize(translator *self, uint32_t slot,
+									bool *moved) {
+	jvm_register_code *code = self->code;
+	jvm_register_operand variable = symbol(KIND_VARIABLE, slot);
+	jvm_register_operand copy = variable;
+	*moved = false;
+	for (long i = 0; i < code->_operands_count; i++) {
+		if (!same(code->_operands[i], variable)) {
+			continue;
+		}
+		if (!*moved) {
+			// No operand above the first one refers to its temporary
+			copy = symbol(KIND_TEMPORARY, (uint32_t) i);
+			operation_result result = emit(self, JVM_REGISTER_MOVE, copy,
+										   variable, variable);
+			if (result != OPERATION_SUCCESS) {
+				return result;
+			}
+			*moved = true;
+		}
+		code->_operands[i] = copy;
+	}
+	return OPERATION_SUCCESS;
+}
+
+/**
+ * Static function that translates an istore of the variable {@param slot}.
+ * When the value stored is the result of the last instruction, that
+ * instruction stores it right away
+ * @return  {@link operation_result} with the result of the operation
+ */
+static operation_result translate_store(translator *self, uint32_t slot) {
+	jvm_register_code *code = self->code;
+	jvm_register_operand value;
+	operation_result result = pop(self, &value);
+	// A variable out of bounds isn't stored, as when setting it
+	if (result != OPERATION_SUCCESS ||
+		slot >= (uint32_t) int_vector_size(self->vec)) {
+		return result;
+	}
+	if (code->_stored < 0) {
+		code->_stored = (int) slot;
+	}
+	jvm_register_operand variable = symbol(KIND_VARIABLE, slot);
+	if (same(value, variable)) {
+		return OPERATION_SUCCESS;
+	}
+	bool moved;
+	result = materialize(self, slot, &moved);
+	if (result != OPERATION_SUCCESS) {
+		return result;
+	}
+	jvm_register_instruction *last = code->instructions
+			? &code->_instructions[code->instructions - 1] : NULL;
+	// Only the temporary of its own position of the stack was produced by
+	// the last instruction without any other operand referring to it
+	if (!moved && last && value.symbol.kind == KIND_TEMPORARY &&
+		value.symbol.index == (uint32_t) code->_operands_count &&
+		same(last->dst, value)) {
+		last->dst = variable;
+		return OPERATION_SUCCESS;
+	}
+	return emit(self, JVM_REGISTER_MOVE, variable, value, value);
+}
+
+/**
+ * Static function that translates the byte_code {@param byte_code} with its
+ * {@param argument} (if it takes one)
+ * @post    {@param known} tells whether it's a known byte_code
+ * @return  {@link operation_result} with the result of the operation
+ */
+static operation_result translate_byte_code(translator *self,
+											unsigned char byte_code,
+											char argument, bool *known) {
+	*known = true;
+	jvm_register_operand operand;
+	operation_result result;
+	switch (byte_code) {
+		case ISTORE:
+			return translate_store(self, (unsigned char) argument);
+		case ILOAD:
+			// A variable out of bounds is loaded as 0, as when getting it
+			if ((unsigned char) argument >=
+				(uint32_t) int_vector_size(self->vec)) {
+				result = constant(self, 0, &operand);
+				return (result == OPERATION_SUCCESS) ? push(self, operand)
+													 : result;
+			}
+			return push(self, symbol(KIND_VARIABLE, (unsigned char) argument));
+		case BIPUSH:
+			result = constant(self, argument, &operand);
+			return (result == OPERATION_SUCCESS) ? push(self, operand)
+												 : result;
+		case DUP:
+			result = pop(self, &operand);
+			if (result == OPERATION_SUCCESS) {
+				result = push(self, operand);
+			}
+			return (result == OPERATION_SUCCESS) ? push(self, operand)
+												 : result;
+		case INEG:
+			return translate_operation(self, JVM_REGISTER_NEG, 1);
+		case IADD:
+			return translate_operation(self, JVM_REGISTER_ADD, 2);
+		case ISUB:
+			return translate_operation(self, JVM_REGISTER_SUB, 2);
+		case IMUL:
+			return translate_operation(self, JVM_REGISTER_MUL, 2);
+		case IDIV:
+			return translate_operation(self, JVM_REGISTER_DIV, 2);
+		case IREM:
+			return translate_operation(self, JVM_REGISTER_REM, 2);
+		case IAND:
+			return translate_operation(self, JVM_REGISTER_AND, 2);
+		case IOR:
+			return translate_operation(self, JVM_REGISTER_OR, 2);
+		case IXOR:
+			return translate_operation(self, JVM_REGISTER_XOR, 2);
+		default:
+			*known = false;
+			return OPERATION_SUCCESS;
+	}
+}
+
+/**
+ * Static function that pushes the operands of {@param operands} as constants
+ * in the stack of {@param self}, from the bottom to the top
+ * @return  {@link operation_result} with the result of the operation
+ */
+static operation_result seed_operands(translator *self,
+									  const stack *operands) {
+	size_t count = stack_size(operands);
+	if (count == 0) {
+		return OPERATION_SUCCESS;
+	}
+	int *values = (int *) malloc(count * sizeof(int));
+	if (!values) {
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
+	stack_elements(operands, values);
+	operation_result result = OPERATION_SUCCESS;
+	for (size_t i = count; result == OPERATION_SUCCESS && i > 0; i--) {
+		jvm_register_operand operand;
+		result = constant(self, values[i - 1], &operand);
+		if (result == OPERATION_SUCCESS) {
+			result = push(self, operand);
+		}
+	}
+	free(values);
+	return result;
+}
+
+/**
+ * Static function that replaces the {@param operand} symbol by the address
+ * of its value in the frame of {@param code} or in {@param variables}
+ */
+static void link_operand(const jvm_register_code *code, int *variables,
+						 jvm_register_operand *operand) {
+	uint32_t index = operand->symbol.index;
+	switch ((operand_kind) operand->symbol.kind) {
+		case KIND_VARIABLE:
+			operand->value = &variables[index];
+			break;
+		case KIND_CONSTANT:
+			operand->value = &code->_constants[index];
+			break;
+		default:
+			operand->value = &code->_temporaries[index];
+	}
+}
+
+/**
+ * Static function that allocates the temporaries of the {@param code} and
+ * replaces every symbol by the address of its value
+ * @return  {@link operation_result} with the result of the operation
+ */
+static operation_result link(jvm_register_code *code, int_vector *vec) {
+	code->_temporaries = (int *) calloc(
+			(size_t) code->_temporaries_count + 1, sizeof(int));
+	if (!code->_temporaries) {
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
+	int *variables = (int *) int_vector_data(vec);
+	for (long i = 0; i < code->instructions; i++) {
+		jvm_register_instruction *instruction = &code->_instructions[i];
+		link_operand(code, variables, &instruction->dst);
+		link_operand(code, variables, &instruction->a);
+		link_operand(code, variables, &instruction->b);
+	}
+	for (long i = 0; i < code->_operands_count; i++) {
+		link_operand(code, variables, &code->_operands[i]);
+	}
+	return OPERATION_SUCCESS;
+}
+
+operation_result jvm_register_translate(jvm_register_code *code,
+										const char *program, long length,
+										int_vector *vec,
+										const stack *operands) {
+	if (!code || !program || !vec || !operands)
+		return OPERATION_FAILURE_NULL_POINTER;
+	// The offsets of the byte_codes must fit in the instructions
+	if (length < 0 || length > (long) UINT32_MAX)
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	memset(code, 0, sizeof(jvm_register_code));
+	code->_program = program;
+	code->_stored = -1;
+	code->fault = OPERATION_SUCCESS;
+	translator self;
+	self.code = code;
+	self.vec = vec;
+	memset(self.small_constants, 0, sizeof(self.small_constants));
+
+	operation_result result = seed_operands(&self, operands);
+	long i = 0;
+	while (result == OPERATION_SUCCESS && i < length) {
+		unsigned char byte_code = (unsigned char) program[i];
+		bool argument = byte_code == ISTORE || byte_code == ILOAD ||
+						byte_code == BIPUSH;
+		if (argument && i + 1 == length) {
+			// A last byte_code missing its argument isn't executed
+			break;
+		}
+		bool known;
+		self.start = (uint32_t) i;
+		result = translate_byte_code(&self, byte_code,
+									 argument ? program[i + 1] : 0, &known);
+		if (jvm_fault_is(result)) {
+			// Nothing runs from the byte_code that faults on
+			code->fault = result;
+			result = OPERATION_SUCCESS;
+			break;
+		}
+		i += (known && argument) ? 2 : 1;
+		code->byte_codes += known;
+	}
+	code->consumed = i;
+	if (result == OPERATION_SUCCESS) {
+		result = link(code, vec);
+	}
+	if (result != OPERATION_SUCCESS) {
+		jvm_register_destroy(code);
+	}
+	return result;
+}
+
+/**
+ * Static function that runs the instructions of the {@param context} code,
+ * keeping the one running so the one that faults is known
+ */
+static void run_instructions(void *context) {
+	jvm_register_code *code = (jvm_register_code *) context;
+	const jvm_register_instruction *instruction = code->_instructions;
+	const jvm_register_instruction *end = instruction + code->instructions;
+	for (; instruction < end; instruction++) {
+		code->_running = instruction;
+		*instruction->dst.value = apply(instruction->operation,
+										*instruction->a.value,
+										*instruction->b.value);
+	}
+}
+
+operation_result jvm_register_run(jvm_register_code *code, int_vector *vec,
+								  stack *operands) {
+	if (!code || !vec || !operands)
+		return OPERATION_FAILURE_NULL_POINTER;
+	// Every variable is in the first page, marked as written beforehand as
+	// the stores don't go through the vector
+	if (code->_stored >= 0) {
+		int_vector_set(vec, code->_stored,
+					   int_vector_get(vec, code->_stored));
+	}
+	// Only the divisions fault, as the stack is a frame of its own
+	operation_result fault = jvm_fault_run(NULL, run_instructions, code);
+	if (fault != OPERATION_SUCCESS) {
+		code->fault = fault;
+		code->consumed = code->_running->start;
+		jvm_engine_verify(code->_program, code->consumed, -1,
+						  &code->byte_codes);
+	}
+	stack_clear(operands);
+	if (code->fault != OPERATION_SUCCESS) {
+		return code->fault;
+	}
+	// The operands left replace the ones the program started with
+	for (long i = 0; i < code->_operands_count; i++) {
+		int value = *code->_operands[i].value;
+		if (stack_push(operands, &value) != OPERATION_SUCCESS) {
+			return OPERATION_FAILURE_NO_MEMORY;
+		}
+	}
+	return OPERATION_SUCCESS;
+}
+
+void jvm_register_destroy(jvm_register_code *code) {
+	free(code->_instructions);
+	free(code->_constants);
+	free(code->_temporaries);
+	free(code->_operands);
+	memset(code, 0, sizeof(jvm_register_code));
+}
+
+operation_result jvm_register_execute(const char *program, long length,
+									  int_vector *vec, stack *operands,
+									  uint64_t limit, uint64_t *instructions,
+									  long *consumed, bool *executed) {
+	if (!program || !vec || !operands || !instructions || !consumed ||
+		!executed)
+		return OPERATION_FAILURE_NULL_POINTER;
+	*executed = false;
+	jvm_register_code code;
+	if (jvm_register_translate(&code, program, length, vec, operands) !=
+		OPERATION_SUCCESS) {
+		return OPERATION_SUCCESS;
+	}
+	operation_result result = OPERATION_SUCCESS;
+	if (limit == 0 || code.byte_codes <= limit) {
+		result = jvm_register_run(&code, vec, operands);
+		*instructions = code.byte_codes;
+		*consumed = code.consumed;
+		*executed = true;
+	}
+	jvm_register_destroy(&code);
+	return result;
+}
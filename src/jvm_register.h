@@ -0,0 +1,134 @@
+#ifndef __JVM_REGISTER_H__
+#define __JVM_REGISTER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "result.h"
+#include "int_vector.h"
+#include "stack.h"
+
+/**
+ * Operation of the register code: dst = a op b (only a for MOVE and NEG)
+ */
+typedef enum jvm_register_operation {
+	JVM_REGISTER_MOVE,
+	JVM_REGISTER_ADD,
+	JVM_REGISTER_SUB,
+	JVM_REGISTER_MUL,
+	JVM_REGISTER_DIV,
+	JVM_REGISTER_REM,
+	JVM_REGISTER_AND,
+	JVM_REGISTER_OR,
+	JVM_REGISTER_XOR,
+	JVM_REGISTER_NEG
+} jvm_register_operation;
+
+/**
+ * Operand of an instruction: a variable, a constant or a temporary, which
+ * is a symbol while the program is translated and the address of its value
+ * in the frame once linked
+ */
+typedef union jvm_register_operand {
+	int *value;
+	struct {
+		uint32_t kind;
+		uint32_t index;
+	} symbol;
+} jvm_register_operand;
+
+/**
+ * Three-address instruction of the register code, with the offset of the
+ * byte_code it comes from in the program
+ */
+typedef struct jvm_register_instruction {
+	jvm_register_operand dst;
+	jvm_register_operand a;
+	jvm_register_operand b;
+	jvm_register_operation operation;
+	uint32_t start;
+} jvm_register_instruction;
+
+/**
+ * Program translated from byte_codes into register code. Each position of
+ * the operand stack is a temporary of a flat frame and the byte_codes that
+ * only move operands (iload, bipush, dup) are folded into the operands of
+ * the instructions that consume them, as the constant operations are:
+ *          - byte_codes: byte_codes translated
+ *          - instructions: register instructions they became
+ *          - consumed: bytes translated (a last byte_code missing its
+ *            argument isn't)
+ *          - fault: OPERATION_SUCCESS, or the fault of the byte_code at
+ *            consumed, which ends the program. As the depth of the operand
+ *            stack is known while translating, popping an empty stack and
+ *            pushing into a full one are found then; a division faults when
+ *            the code runs, which updates the three of them
+ */
+typedef struct jvm_register_code {
+	const char *_program;
+	jvm_register_instruction *_instructions;
+	long _capacity;
+	int *_constants;
+	long _constants_count;
+	long _constants_capacity;
+	int *_temporaries;
+	long _temporaries_count;
+	jvm_register_operand *_operands;
+	long _operands_count;
+	long _operands_capacity;
+	int _stored;
+	const jvm_register_instruction *volatile _running;
+	uint64_t byte_codes;
+	long instructions;
+	long consumed;
+	operation_result fault;
+} jvm_register_code;
+
+/**
+ * Translates the {@param program} of {@param length} bytes into the register
+ * {@param code} that runs it over {@param vec}, starting with the operands of
+ * {@param operands}, which aren't changed
+ * @post    {@param code} must be released with {@link jvm_register_destroy}
+ *          and the program must outlive it
+ * @return  {@link operation_result} with the result of the operation.
+ *          Programs beyond 4 GiB aren't translated
+ */
+operation_result jvm_register_translate(jvm_register_code *code,
+										const char *program, long length,
+										int_vector *vec,
+										const stack *operands);
+
+/**
+ * Runs the {@param code} over the variables it was translated for, leaving
+ * in {@param operands} the ones left by the program, with the same effect
+ * as executing its byte_codes. If it faults, the variables keep the changes
+ * made until then and the operands are discarded
+ * @return  {@link operation_result} with the result of the operation, the
+ *          fault if there's one
+ */
+operation_result jvm_register_run(jvm_register_code *code, int_vector *vec,
+								  stack *operands);
+
+/**
+ * Releases the {@param code}
+ */
+void jvm_register_destroy(jvm_register_code *code);
+
+/**
+ * Executes the whole {@param program} of {@param length} bytes over {@param
+ * vec} and {@param operands} through the register code, unless it runs more
+ * than {@param limit} byte_codes (0 doesn't limit them)
+ * @post    {@param executed} tells whether it was executed, in which case
+ *          {@param instructions} contains the byte_codes executed and {@param
+ *          consumed} the bytes (a last byte_code missing its argument isn't
+ *          executed, as when running the byte_codes, nor the ones from a
+ *          fault on)
+ * @return  {@link operation_result} with the result of the operation. The
+ *          program isn't executed if it can't be translated
+ */
+operation_result jvm_register_execute(const char *program, long length,
+									  int_vector *vec, stack *operands,
+									  uint64_t limit, uint64_t *instructions,
+									  long *consumed, bool *executed);
+
+#endif //__JVM_REGISTER_H__
@@ -0,0 +1,374 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "jvm_replay.h"
+#include "jvm_capture.h"
+#include "jvm_client.h"
+#include "jvm_engine.h"
+#include "jvm_metrics.h"
+#include "jvm_register.h"
+#include "jvm_session.h"
+
+// Latencies kept before growing the array
+#define LATENCIES_INITIAL 1024
+#define P50 0.5
+#define P99 0.99
+#define MILLISECONDS 1e3
+
+/**
+ * Result of replaying a request: its status and the variables once executed,
+ * which must be released with free
+ */
+typedef struct replay_outcome {
+	operation_result status;
+	int *variables;
+	int32_t variables_count;
+} replay_outcome;
+
+/**
+ * State kept along the replay: the sessions of the requests executed by this
+ * process, or the pipeline (and the session it's bound to) of the ones sent
+ * to the server
+ */
+typedef struct replayer {
+	const jvm_replay_options *options;
+	jvm_session_table sessions;
+	jvm_pipeline pipeline;
+	bool connected;
+	char *session;
+} replayer;
+
+void jvm_replay_options_default(jvm_replay_options *options) {
+	options->speed = JVM_REPLAY_SPEED_MAX;
+	options->host = NULL;
+	options->port = NULL;
+	options->engine = JVM_ENGINE_STACK;
+}
+
+/**
+ * Static function that keeps a copy of the variables of {@param vec} in
+ * {@param outcome}
+ */
+static void keep_variables(replay_outcome *outcome, const int_vector *vec) {
+	outcome->variables_count = int_vector_size(vec);
+	outcome->variables = (int *) malloc(
+			(size_t) outcome->variables_count * sizeof(int) + 1);
+	if (!outcome->variables) {
+		outcome->status = OPERATION_FAILURE_NO_MEMORY;
+		outcome->variables_count = 0;
+		return;
+	}
+	memcpy(outcome->variables, int_vector_data(vec),
+		   (size_t) outcome->variables_count * sizeof(int));
+}
+
+/**
+ * Static function that executes the request of {@param entry} with the
+ * engine of this process configured in {@param self}, within its session if
+ * it has one.
+ * As in the server, a legacy program ignores a last byte_code missing its
+ * argument
+ */
+static void replay_locally(replayer *self, const jvm_capture_entry *entry,
+						   replay_outcome *outcome) {
+	jvm_session *session = NULL;
+	int_vector vec;
+	stack operands;
+	if (entry->session) {
+		outcome->status = jvm_session_table_acquire(
+				&self->sessions, entry->session, entry->var_size, &session);
+		if (outcome->status != OPERATION_SUCCESS) {
+			return;
+		}
+	} else {
+		outcome->status = int_vector_create(&vec, entry->var_size);
+		if (outcome->status != OPERATION_SUCCESS) {
+			return;
+		}
+		outcome->status = stack_create(&operands, sizeof(int));
+		if (outcome->status != OPERATION_SUCCESS) {
+			int_vector_destroy(&vec);
+			return;
+		}
+	}
+	int_vector *variables = session ? &session->variables : &vec;
+	stack *stack_operands = session ? &session->operands : &operands;
+	long pc = 0;
+	bool executed = false;
+	if (self->options->engine == JVM_ENGINE_REGISTER) {
+		uint64_t instructions;
+		outcome->status = jvm_register_execute(
+				entry->program, entry->program_length, variables,
+				stack_operands, 0, &instructions, &pc, &executed);
+	}
+	if (!executed) {
+		bool finished;
+		outcome->status = jvm_engine_run_slice(
+				entry->program, entry->program_length, &pc, UINT64_MAX,
+				variables, stack_operands, NULL, &finished);
+	}
+	if (outcome->status == OPERATION_SUCCESS &&
+		pc != entry->program_length && entry->protocol != JVM_CAPTURE_LEGACY) {
+		outcome->status = OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	}
+	keep_variables(outcome, variables);
+	if (!session) {
+		stack_destroy(&operands);
+		int_vector_destroy(&vec);
+	}
+}
+
+/**
+ * Static function that finishes the pipeline of {@param self}, if connected
+ */
+static void disconnect_pipeline(replayer *self) {
+	if (self->connected) {
+		jvm_pipeline_close(&self->pipeline);
+		self->connected = false;
+	}
+}
+
+/**
+ * Static function that sends the request of {@param entry} to the server of
+ * {@param self} through its own legacy connection
+ */
+static void replay_legacy(replayer *self, const jvm_capture_entry *entry,
+						  replay_outcome *outcome) {
+	// A server without workers serves one connection at a time
+	disconnect_pipeline(self);
+	outcome->status = OPERATION_FAILURE_CONNECTION_FAILED;
+	if (entry->var_size < 0) {
+		return;
+	}
+	outcome->variables = (int *) malloc(
+			(size_t) entry->var_size * sizeof(int) + 1);
+	if (!outcome->variables) {
+		outcome->status = OPERATION_FAILURE_NO_MEMORY;
+		return;
+	}
+	outcome->status = jvm_client_execute_legacy(
+			self->options->host, self->options->port, entry->var_size,
+			entry->program, entry->program_length, outcome->variables);
+	if (outcome->status == OPERATION_SUCCESS) {
+		outcome->variables_count = entry->var_size;
+	}
+}
+
+/**
+ * Static function that tells whether the pipeline of {@param self} is bound
+ * to the {@param session} (NULL for none)
+ */
+static bool bound_to(const replayer *self, const char *session) {
+	return (!self->session || !session) ? self->session == session
+										: strcmp(self->session, session) == 0;
+}
+
+/**
+ * Static function that connects the pipeline of {@param self} to the server,
+ * bound to the {@param session}, replacing the previous connection
+ */
+static operation_result connect_pipeline(replayer *self, const char *session) {
+	disconnect_pipeline(self);
+	free(self->session);
+	self->session = session ? strdup(session) : NULL;
+	if (session && !self->session) {
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
+	jvm_client_options options;
+	jvm_client_options_default(&options);
+	options.protocol = JVM_CLIENT_PROTOCOL_FRAMED;
+	options.session = self->session;
+	operation_result result = jvm_pipeline_open(
+			&self->pipeline, self->options->host, self->options->port,
+			&options);
+	self->connected = (result == OPERATION_SUCCESS);
+	return result;
+}
+
+/**
+ * Static function that sends the framed (or shared memory) request of {@param
+ * entry} to the server of {@param self} through the pipeline bound to its
+ * session, waiting for its response
+ */
+static void replay_framed(replayer *self, const jvm_capture_entry *entry,
+						  replay_outcome *outcome) {
+	if (!self->connected || !bound_to(self, entry->session)) {
+		outcome->status = connect_pipeline(self, entry->session);
+		if (outcome->status != OPERATION_SUCCESS) {
+			return;
+		}
+	}
+	uint32_t id;
+	jvm_response *response;
+	outcome->status = jvm_pipeline_submit(&self->pipeline, entry->var_size,
+										  entry->program,
+										  (uint32_t) entry->program_length,
+										  &id);
+	if (outcome->status == OPERATION_SUCCESS) {
+		outcome->status = jvm_pipeline_receive(&self->pipeline, &response);
+	}
+	if (outcome->status != OPERATION_SUCCESS) {
+		// The connection can't be trusted anymore
+		disconnect_pipeline(self);
+		return;
+	}
+	outcome->status = response->status;
+	outcome->variables = response->variables;
+	outcome->variables_count = response->var_size;
+	response->variables = NULL;
+	jvm_response_destroy(response);
+}
+
+/**
+ * Static function that tells whether the {@param outcome} of the replay
+ * matches the request captured in {@param entry}
+ */
+static bool matches(const jvm_capture_entry *entry,
+					const replay_outcome *outcome) {
+	return outcome->status == OPERATION_SUCCESS &&
+		   outcome->variables_count == entry->variables_count &&
+		   (entry->variables_count == 0 ||
+			memcmp(outcome->variables, entry->variables,
+				   (size_t) entry->variables_count * sizeof(int)) == 0);
+}
+
+/**
+ * Static function that sleeps until {@param instant} of {@link
+ * jvm_metrics_now}, if it's still to come
+ */
+static void sleep_until(double instant) {
+	double left = instant - jvm_metrics_now();
+	if (left > 0) {
+		struct timespec pause;
+		pause.tv_sec = (time_t) left;
+		pause.tv_nsec = (long) ((left - (double) pause.tv_sec) * 1e9);
+		nanosleep(&pause, NULL);
+	}
+}
+
+static int compare_latencies(const void *a, const void *b) {
+	double first = *(const double *) a;
+	double second = *(const double *) b;
+	return (first > second) - (first < second);
+}
+
+/**
+ * Static function that summarizes the {@param count} {@param latencies} in
+ * {@param report}
+ */
+static void summarize(double *latencies, long count,
+					  jvm_replay_report *report) {
+	report->p50 = 0;
+	report->p99 = 0;
+	report->max = 0;
+	if (count == 0) {
+		return;
+	}
+	qsort(latencies, (size_t) count, sizeof(double), compare_latencies);
+	report->p50 = latencies[(long) (P50 * (double) (count - 1))];
+	report->p99 = latencies[(long) (P99 * (double) (count - 1))];
+	report->max = latencies[count - 1];
+}
+
+/**
+ * Static function that replays every request of the {@param capture} through
+ * {@param self}, filling the {@param report}
+ */
+static operation_result replay_requests(replayer *self, jvm_capture *capture,
+										jvm_replay_report *report) {
+	long capacity = LATENCIES_INITIAL;
+	double *latencies = (double *) malloc((size_t) capacity * sizeof(double));
+	if (!latencies) {
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
+	operation_result result;
+	double started = jvm_metrics_now();
+	while (true) {
+		jvm_capture_entry entry;
+		bool end;
+		result = jvm_capture_next(capture, &entry, &end);
+		if (result != OPERATION_SUCCESS || end) {
+			break;
+		}
+		if (report->requests == capacity) {
+			double *grown = (double *) realloc(
+					latencies, (size_t) capacity * 2 * sizeof(double));
+			if (!grown) {
+				jvm_capture_entry_release(&entry);
+				result = OPERATION_FAILURE_NO_MEMORY;
+				break;
+			}
+			latencies = grown;
+			capacity *= 2;
+		}
+		if (self->options->speed == JVM_REPLAY_SPEED_ORIGINAL) {
+			sleep_until(started + entry.arrival);
+		}
+
+		replay_outcome outcome = {OPERATION_SUCCESS, NULL, 0};
+		double sent = jvm_metrics_now();
+		if (!self->options->port) {
+			replay_locally(self, &entry, &outcome);
+		} else if (entry.protocol == JVM_CAPTURE_LEGACY) {
+			replay_legacy(self, &entry, &outcome);
+		} else {
+			replay_framed(self, &entry, &outcome);
+		}
+		latencies[report->requests++] = jvm_metrics_now() - sent;
+
+		// Only the requests that succeeded when captured are deterministic
+		if (entry.status == OPERATION_SUCCESS) {
+			report->verified++;
+			report->mismatches += !matches(&entry, &outcome);
+		}
+		free(outcome.variables);
+		jvm_capture_entry_release(&entry);
+	}
+	report->elapsed = jvm_metrics_now() - started;
+	summarize(latencies, report->requests, report);
+	free(latencies);
+	return result;
+}
+
+operation_result jvm_replay_run(const char *path,
+								const jvm_replay_options *options,
+								jvm_replay_report *report) {
+	if (!path || !options || !report)
+		return OPERATION_FAILURE_NULL_POINTER;
+	if (options->port && !options->host)
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	memset(report, 0, sizeof(jvm_replay_report));
+	jvm_capture capture;
+	operation_result result = jvm_capture_open(&capture, path);
+	if (result != OPERATION_SUCCESS) {
+		return result;
+	}
+	replayer self;
+	self.options = options;
+	self.connected = false;
+	self.session = NULL;
+	// The sessions are never evicted, as nothing tells when the server did
+	result = jvm_session_table_create(&self.sessions, 0, SIZE_MAX);
+	if (result == OPERATION_SUCCESS) {
+		result = replay_requests(&self, &capture, report);
+		jvm_session_table_destroy(&self.sessions);
+	}
+	disconnect_pipeline(&self);
+	free(self.session);
+	jvm_capture_close(&capture);
+	return result;
+}
+
+void jvm_replay_print(const jvm_replay_report *report, FILE *out) {
+	fprintf(out, "requests: %ld\n", report->requests);
+	fprintf(out, "verified: %ld\n", report->verified);
+	fprintf(out, "mismatches: %ld\n", report->mismatches);
+	fprintf(out, "elapsed: %.3f s\n", report->elapsed);
+	fprintf(out, "latency p50: %.3f ms\n", report->p50 * MILLISECONDS);
+	fprintf(out, "latency p99: %.3f ms\n", report->p99 * MILLISECONDS);
+	fprintf(out, "latency max: %.3f ms\n", report->max * MILLISECONDS);
+}
@@ -0,0 +1,78 @@
+#ifndef __JVM_REPLAY_H__
+#define __JVM_REPLAY_H__
+
+#include <stdio.h>
+
+#include "result.h"
+#include "jvm_engine.h"
+
+/**
+ * Pace at which the requests of a capture are replayed:
+ *          - MAX: each one right after the previous one finishes
+ *          - ORIGINAL: each one once the time since its capture started
+ *            passed, unless the previous one is still running
+ */
+typedef enum jvm_replay_speed {
+	JVM_REPLAY_SPEED_MAX,
+	JVM_REPLAY_SPEED_ORIGINAL
+} jvm_replay_speed;
+
+/**
+ * Optional settings of the replay:
+ *          - speed: {@link jvm_replay_speed} of the replay
+ *          - host, port: server through which the requests are replayed, or
+ *            NULL to execute them with the engine of this process
+ *          - engine: {@link jvm_engine_kind} that executes them in this
+ *            process
+ */
+typedef struct jvm_replay_options {
+	jvm_replay_speed speed;
+	const char *host;
+	const char *port;
+	jvm_engine_kind engine;
+} jvm_replay_options;
+
+/**
+ * Outcome of a replay:
+ *          - requests: requests replayed
+ *          - verified: successful requests of the capture whose variables
+ *            were compared with the ones of the replay
+ *          - mismatches: verified requests that failed or ended with other
+ *            variables
+ *          - elapsed: seconds taken by the whole replay
+ *          - p50, p99, max: latencies of the requests, in seconds
+ */
+typedef struct jvm_replay_report {
+	long requests;
+	long verified;
+	long mismatches;
+	double elapsed;
+	double p50;
+	double p99;
+	double max;
+} jvm_replay_report;
+
+/**
+ * Initializes the {@param options} with the default values: as fast as
+ * possible, with the engine of this process
+ */
+void jvm_replay_options_default(jvm_replay_options *options);
+
+/**
+ * Replays the requests of the capture {@param path} in order, as configured in
+ * {@param options}. The sessions start empty, as they were when the capture
+ * started, and the requests of each one run over the variables left by the
+ * previous ones
+ * @post    {@param report} contains the outcome of the replay
+ * @return  {@link operation_result} with the result of the operation
+ */
+operation_result jvm_replay_run(const char *path,
+								const jvm_replay_options *options,
+								jvm_replay_report *report);
+
+/**
+ * Prints the {@param report} in {@param out}
+ */
+void jvm_replay_print(const jvm_replay_report *report, FILE *out);
+
+#endif //__JVM_REPLAY_H__
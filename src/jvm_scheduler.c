@@ -0,0 +1,205 @@
+#include <stdlib.h>
+
+#include "jvm_scheduler.h"
+#include "jvm_engine.h"
+#include "jvm_register.h"
+
+operation_result jvm_task_create(jvm_task *task, const char *program,
+								 long length, int_vector *variables,
+								 stack *operands, FILE *trace,
+								 unsigned weight, uint64_t limit) {
+	if (!task || !program || !variables || !operands)
+		return OPERATION_FAILURE_NULL_POINTER;
+	if (length < 0 || weight == 0)
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	if (pthread_cond_init(&task->_finished, NULL) != 0)
+		return OPERATION_FAILURE_NO_MEMORY;
+	task->_program = program;
+	task->_length = length;
+	task->_pc = 0;
+	task->_variables = variables;
+	task->_operands = operands;
+	task->_trace = trace;
+	task->_weight = weight;
+	task->_limit = limit ? limit : UINT64_MAX;
+	task->result = OPERATION_SUCCESS;
+	task->instructions = 0;
+	task->_done = false;
+	task->_next = NULL;
+	return OPERATION_SUCCESS;
+}
+
+void jvm_task_destroy(jvm_task *task) {
+	pthread_cond_destroy(&task->_finished);
+}
+
+/**
+ * Static function that appends the {@param task} to the run queue of {@param
+ * self}, waking up a worker
+ * @pre     The lock of {@param self} is held
+ */
+static void enqueue(jvm_scheduler *self, jvm_task *task) {
+	task->_next = NULL;
+	if (self->_tail) {
+		self->_tail->_next = task;
+	} else {
+		self->_head = task;
+	}
+	self->_tail = task;
+	pthread_cond_signal(&self->_runnable);
+}
+
+/**
+ * Static function that runs the whole {@param task} through the register
+ * code, as its byte_codes fit in a slice (each one takes a byte at least)
+ * @return true if the task was run
+ */
+static bool run_translated(jvm_task *task) {
+	uint64_t instructions;
+	long consumed;
+	bool executed;
+	operation_result result = jvm_register_execute(
+			task->_program, task->_length, task->_variables, task->_operands,
+			0, &instructions, &consumed, &executed);
+	if (!executed) {
+		return false;
+	}
+	if (task->_trace) {
+		jvm_engine_trace(task->_program, consumed, task->_trace);
+	}
+	task->instructions += instructions;
+	task->_pc = consumed;
+	// The last byte_code is missing its argument
+	task->result = (result == OPERATION_SUCCESS && consumed != task->_length)
+				   ? OPERATION_FAILURE_ILLEGAL_ARGUMENT : result;
+	return true;
+}
+
+/**
+ * Static function that runs a slice of the {@param task}
+ * @return true if the task is done
+ */
+static bool run_slice(jvm_scheduler *self, jvm_task *task) {
+	uint64_t before = jvm_engine_instructions();
+	uint64_t quantum = self->_quantum * task->_weight;
+	uint64_t left = task->_limit - task->instructions;
+	if (self->_engine == JVM_ENGINE_REGISTER && task->_pc == 0 &&
+		(uint64_t) task->_length <= (quantum < left ? quantum : left) &&
+		run_translated(task)) {
+		return true;
+	}
+	bool finished;
+	operation_result result = jvm_engine_run_slice(
+			task->_program, task->_length, &task->_pc,
+			quantum < left ? quantum : left, task->_variables,
+			task->_operands, task->_trace, &finished);
+	task->instructions += jvm_engine_instructions() - before;
+	if (result != OPERATION_SUCCESS) {
+		task->result = result;
+		return true;
+	}
+	if (!finished && task->instructions == task->_limit) {
+		task->result = OPERATION_FAILURE_LIMIT_EXCEEDED;
+		return true;
+	}
+	if (finished && task->_pc != task->_length) {
+		// The last byte_code is missing its argument
+		task->result = OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	}
+	return finished;
+}
+
+/**
+ * Static function run by each worker: it takes the first runnable task, runs
+ * a slice of it and puts it back at the end of the queue until it's done
+ */
+static void *work(void *arg) {
+	jvm_scheduler *self = (jvm_scheduler *) arg;
+	pthread_mutex_lock(&self->_lock);
+	while (true) {
+		while (!self->_head && !self->_stopping) {
+			pthread_cond_wait(&self->_runnable, &self->_lock);
+		}
+		if (!self->_head) {
+			break;
+		}
+		jvm_task *task = self->_head;
+		self->_head = task->_next;
+		if (!self->_head) {
+			self->_tail = NULL;
+		}
+		pthread_mutex_unlock(&self->_lock);
+
+		bool done = run_slice(self, task);
+
+		pthread_mutex_lock(&self->_lock);
+		if (done) {
+			self->_tasks--;
+			task->_done = true;
+			pthread_cond_signal(&task->_finished);
+		} else {
+			enqueue(self, task);
+		}
+	}
+	pthread_mutex_unlock(&self->_lock);
+	return NULL;
+}
+
+operation_result jvm_scheduler_create(jvm_scheduler *self, int workers,
+									  uint64_t quantum, jvm_engine_kind engine,
+									  int max_tasks) {
+	if (!self)
+		return OPERATION_FAILURE_NULL_POINTER;
+	if (workers < 1 || quantum == 0 || max_tasks < 0)
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	self->_workers = (pthread_t *) malloc((size_t) workers * sizeof(pthread_t));
+	if (!self->_workers)
+		return OPERATION_FAILURE_NO_MEMORY;
+	pthread_mutex_init(&self->_lock, NULL);
+	pthread_cond_init(&self->_runnable, NULL);
+	self->_quantum = quantum;
+	self->_engine = engine;
+	self->_max_tasks = max_tasks;
+	self->_tasks = 0;
+	self->_head = NULL;
+	self->_tail = NULL;
+	self->_stopping = false;
+	self->_workers_count = 0;
+	while (self->_workers_count < workers) {
+		if (pthread_create(&self->_workers[self->_workers_count], NULL, work,
+						   self) != 0) {
+			jvm_scheduler_destroy(self);
+			return OPERATION_FAILURE_NO_MEMORY;
+		}
+		self->_workers_count++;
+	}
+	return OPERATION_SUCCESS;
+}
+
+operation_result jvm_scheduler_run(jvm_scheduler *self, jvm_task *task) {
+	pthread_mutex_lock(&self->_lock);
+	if (self->_max_tasks > 0 && self->_tasks == self->_max_tasks) {
+		pthread_mutex_unlock(&self->_lock);
+		return OPERATION_FAILURE_BUSY;
+	}
+	self->_tasks++;
+	enqueue(self, task);
+	while (!task->_done) {
+		pthread_cond_wait(&task->_finished, &self->_lock);
+	}
+	pthread_mutex_unlock(&self->_lock);
+	return OPERATION_SUCCESS;
+}
+
+void jvm_scheduler_destroy(jvm_scheduler *self) {
+	pthread_mutex_lock(&self->_lock);
+	self->_stopping = true;
+	pthread_cond_broadcast(&self->_runnable);
+	pthread_mutex_unlock(&self->_lock);
+	for (int i = 0; i < self->_workers_count; i++) {
+		pthread_join(self->_workers[i], NULL);
+	}
+	free(self->_workers);
+	pthread_cond_destroy(&self->_runnable);
+	pthread_mutex_destroy(&self->_lock);
+}
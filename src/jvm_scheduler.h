@@ -0,0 +1,103 @@
+#ifndef __JVM_SCHEDULER_H__
+#define __JVM_SCHEDULER_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "result.h"
+#include "int_vector.h"
+#include "stack.h"
+#include "jvm_engine.h"
+
+#define JVM_SCHEDULER_DEFAULT_QUANTUM 10000
+
+/**
+ * Execution of a program, which is suspended after each slice and resumed
+ * from its program counter, over the same variables and operands:
+ *          - result: {@link operation_result} of the execution once done
+ *          - instructions: byte_codes executed
+ */
+typedef struct jvm_task {
+	const char *_program;
+	long _length;
+	long _pc;
+	int_vector *_variables;
+	stack *_operands;
+	FILE *_trace;
+	unsigned _weight;
+	uint64_t _limit;
+	operation_result result;
+	uint64_t instructions;
+	bool _done;
+	pthread_cond_t _finished;
+	struct jvm_task *_next;
+} jvm_task;
+
+/**
+ * Fixed set of workers that run the tasks submitted by any thread in slices
+ * of a quantum of byte_codes, rotating the runnable ones in order. A task of
+ * weight W runs W quanta per turn, so one huge program can't hold a worker
+ * while the small ones wait behind it. At most a maximum of tasks are admitted
+ * at once (running or waiting), so a burst is rejected instead of piling up
+ */
+typedef struct jvm_scheduler {
+	pthread_t *_workers;
+	int _workers_count;
+	uint64_t _quantum;
+	jvm_engine_kind _engine;
+	int _max_tasks;
+	int _tasks;
+	pthread_mutex_t _lock;
+	pthread_cond_t _runnable;
+	jvm_task *_head;
+	jvm_task *_tail;
+	bool _stopping;
+} jvm_scheduler;
+
+/**
+ * Initializes the {@param task} that runs the {@param program} of {@param
+ * length} bytes over {@param variables} and {@param operands}, printing the
+ * trace in {@param trace} (if it isn't NULL) with the {@param weight} given.
+ * The task fails with OPERATION_FAILURE_LIMIT_EXCEEDED if the program doesn't
+ * finish within {@param limit} byte_codes (0 doesn't limit it)
+ * @return  {@link operation_result} with the result of the operation
+ */
+operation_result jvm_task_create(jvm_task *task, const char *program,
+								 long length, int_vector *variables,
+								 stack *operands, FILE *trace,
+								 unsigned weight, uint64_t limit);
+
+/**
+ * Destroys the {@param task}, which must be done
+ */
+void jvm_task_destroy(jvm_task *task);
+
+/**
+ * Initializes the {@param self} scheduler starting its {@param workers}
+ * threads, which run the tasks in slices of {@param quantum} byte_codes, with
+ * at most {@param max_tasks} of them admitted at once (0 doesn't bound them).
+ * With the register {@param engine}, a program that fits in its first slice
+ * is translated and run at once
+ * @return  {@link operation_result} with the result of the operation
+ */
+operation_result jvm_scheduler_create(jvm_scheduler *self, int workers,
+									  uint64_t quantum, jvm_engine_kind engine,
+									  int max_tasks);
+
+/**
+ * Submits the {@param task} to {@param self} and waits until it's done
+ * @post    The result of the task is in {@param task}
+ * @return  OPERATION_FAILURE_BUSY, without running the task, if the maximum
+ *          of tasks is already admitted or OPERATION_SUCCESS otherwise
+ */
+operation_result jvm_scheduler_run(jvm_scheduler *self, jvm_task *task);
+
+/**
+ * Stops the workers of {@param self}, once the tasks submitted are done, and
+ * destroys it
+ */
+void jvm_scheduler_destroy(jvm_scheduler *self);
+
+#endif //__JVM_SCHEDULER_H__
@@ -1,72 +1,75 @@
+#define _GNU_SOURCE
+
 #include "jvm_server.h"
 #include "int_vector.h"
 #include "jvm_utils.h"
 #include "socket.h"
+#include "jvm_protocol.h"
+#include "jvm_engine.h"
+#include "shm_channel.h"
+#include "jvm_session.h"
+#include "jvm_snapshot.h"
+#include "jvm_metrics.h"
+#include "jvm_trace.h"
+#include "jvm_probes.h"
+#include "jvm_scheduler.h"
+#include "jvm_fault.h"
+#include "jvm_register.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
 
 #define CHUNK_SIZE 100
+// Bytes of output a request run by the workers keeps before printing them
+#define REQUEST_OUTPUT_CHUNK (64 * 1024)
+// Bytes received per call when a legacy program is received whole
+#define PROGRAM_BLOCK (64 * 1024)
+#define WEIGHTS_SEPARATOR ','
+#define WEIGHT_SEPARATOR '='
 
+/**
+ * Static function that sends every variable of {@param vec} through the socket
+ * in bulk
+ */
 static operation_result send_variables(socket_t *socket, int_vector *vec) {
-	int variables_quantity = int_vector_size(vec);
-	for (int i = 0; i < variables_quantity; i++) {
-		if (socket_send_int(socket, int_vector_get(vec, i)) ==
-			SOCKET_CONNECTION_ERROR) {
-			return OPERATION_FAILURE_CONNECTION_FAILED;
-		}
+	if (socket_send_ints(socket, int_vector_data(vec), int_vector_size(vec)) ==
+		SOCKET_CONNECTION_ERROR) {
+		return OPERATION_FAILURE_CONNECTION_FAILED;
 	}
 	return OPERATION_SUCCESS;
 }
 
 /**
- * Static function that process each byte_code by:
- *          - Creating a {@link jvm_argument} with the byte_code
- *          - Executing the jvm_argument
- *          - Printing the jvm_argument
- * @return  {@link operation_result} with the result of the operation
- */
-operation_result
-process_byte_codes_chunk(const char *byte_codes, long bytes, int_vector *vec,
-						 stack *s) {
-	bool error = false;
-	int i = 0;
-	while (!error && i < bytes) {
-		unsigned char byte_code = (unsigned char) byte_codes[i++];
-		jvm_argument arg;
-		if (jvm_argument_detect(&arg, byte_code) == OPERATION_SUCCESS) {
-			if (jvm_argument_requires_vector(&arg)) {
-				// First argument int_vector, second position
-				if (i == bytes) {
-					error = true;
-				} else {
-					unsigned char position = (unsigned char) byte_codes[i++];
-					arg.func(vec, &position, s);
-				}
-			} else {
-				if (jvm_argument_requires_operand(&arg)) {
-					// First argument is the next byte_code
-					if (i == bytes) {
-						error = true;
-					} else {
-						char extra_argument = byte_codes[i++];
-						arg.func(&extra_argument, NULL, s);
-					}
-				} else {
-					// No extra arguments are needed
-					arg.func(NULL, 0, s);
-				}
-			}
-			printf("%s\n", arg.byte_code_description);
-		} // Ignore unknown byte_codes
+ * Static function that ends the {@param span} of a request, logging it in the
+ * trace of the {@param server}. The requests rejected or failed fire a probe
+ */
+static void end_request(jvm_server *server, jvm_span *span) {
+	if (span->status != OPERATION_SUCCESS) {
+		JVM_PROBE3(request_failed, span->connection, span->id, span->status);
 	}
-	return error ? OPERATION_FAILURE_ILLEGAL_ARGUMENT : OPERATION_SUCCESS;
+	jvm_span_end(span, server->_trace);
 }
 
 /**
  * Static function that receives all the byte_codes to be executed in chunks
- * through the socket
+ * through the socket. The chunks are received and executed in turns, so both
+ * phases of the {@param span} are entered once per chunk. Once the program
+ * exceeds {@param max_program} bytes or {@param limit} byte_codes, it's
+ * stopped with OPERATION_FAILURE_LIMIT_EXCEEDED, and a program that faults
+ * is stopped with its fault. The bytes received are copied in {@param copy}
+ * too, if it isn't NULL
  */
 static operation_result
 receive_and_process_byte_codes(socket_t *skt, int_vector *vec, stack *s,
-							   int chunk_size) {
+							   int chunk_size, long max_program,
+							   uint64_t limit, FILE *copy, jvm_span *span) {
 	printf("%s\n", BYTE_CODES_OUTPUT_TITLE);
 
 	// Allocate necessary memory for the chunk
@@ -76,20 +79,55 @@ receive_and_process_byte_codes(socket_t *skt, int_vector *vec, stack *s,
 	}
 
 	long bytes_received = 0;
+	// Bytes of a byte_code whose argument didn't arrive yet
+	long pending = 0;
 	bool finished = false;
+	operation_result result = OPERATION_SUCCESS;
 
 	// Receive and process all the byte codes
 	do {
-		bytes_received = socket_recv(skt, buffer, chunk_size);
+		bytes_received = socket_recv(skt, &buffer[pending],
+									 chunk_size - pending);
+		jvm_span_mark(span, JVM_PHASE_RECEIVE);
+		if (copy && bytes_received > 0) {
+			fwrite(&buffer[pending], 1, (size_t) bytes_received, copy);
+		}
 		if (bytes_received <= 0) {
 			finished = true;
-		} else if (bytes_received > 0) {
-			// We send the corresponding chunk as buffer + bytes_already_processed
-			// We send the quantity of bytes as bytes_received - bytes_already_processed
-			if (process_byte_codes_chunk(buffer, bytes_received, vec, s) !=
-				OPERATION_SUCCESS) {
+		} else if (span->program_bytes + pending + bytes_received >
+				   max_program) {
+			jvm_metrics_add(JVM_COUNTER_SHED_COST, 1);
+			result = OPERATION_FAILURE_LIMIT_EXCEEDED;
+			finished = true;
+		} else if (span->instructions == limit) {
+			jvm_metrics_add(JVM_COUNTER_SHED_INSTRUCTIONS, 1);
+			result = OPERATION_FAILURE_LIMIT_EXCEEDED;
+			finished = true;
+		} else {
+			// The unprocessed bytes are moved to the beginning of the buffer
+			// so the next chunk is received right after them
+			long available = pending + bytes_received;
+			long consumed = 0;
+			bool done;
+			uint64_t instructions = jvm_engine_instructions();
+			operation_result executed = jvm_engine_run_slice(
+					buffer, available, &consumed, limit - span->instructions,
+					vec, s, stdout, &done);
+			span->instructions += jvm_engine_instructions() - instructions;
+			if (executed != OPERATION_SUCCESS) {
+				// The program faulted, so the rest isn't executed
+				jvm_metrics_add(JVM_COUNTER_FAULTS, 1);
+				result = executed;
+				finished = true;
+			} else if (!done) {
+				jvm_metrics_add(JVM_COUNTER_SHED_INSTRUCTIONS, 1);
+				result = OPERATION_FAILURE_LIMIT_EXCEEDED;
 				finished = true;
 			}
+			span->program_bytes += consumed;
+			jvm_span_mark(span, JVM_PHASE_EXECUTE);
+			pending = available - consumed;
+			memmove(buffer, &buffer[consumed], (size_t) pending);
 		}
 	} while (!finished);
 
@@ -97,92 +135,1485 @@ receive_and_process_byte_codes(socket_t *skt, int_vector *vec, stack *s,
 	printf("\n");
 
 	free(buffer);
+	return result;
+}
+
+void jvm_server_options_default(jvm_server_options *options) {
+	options->backend = SOCKET_BACKEND_CLASSIC;
+	options->connections = 1;
+	options->transport = JVM_TRANSPORT_TCP;
+	options->shm_size = SHM_CHANNEL_DEFAULT_SIZE;
+	options->session_ttl = JVM_SERVER_DEFAULT_SESSION_TTL;
+	options->session_memory = JVM_SERVER_DEFAULT_SESSION_MEMORY;
+	options->checkpoint = NULL;
+	options->checkpoint_interval = 0;
+	options->metrics = NULL;
+	options->trace_log = NULL;
+	options->trace_sample = 1;
+	options->workers = 0;
+	options->quantum = JVM_SCHEDULER_DEFAULT_QUANTUM;
+	options->weights = NULL;
+	options->max_connections = 0;
+	options->max_queue = 0;
+	options->max_request_bytes = 0;
+	options->max_instructions = 0;
+	options->processes = 0;
+	options->capture = NULL;
+	options->engine = JVM_ENGINE_STACK;
+	options->parallel = 0;
+}
+
+/**
+ * Static function that parses the {@param weights} of the sessions, as a list
+ * of session=weight separated by commas, in the {@param server}
+ * @return  {@link operation_result} with the result of the operation
+ */
+static operation_result parse_weights(jvm_server *server, const char *weights) {
+	server->_weights_count = 0;
+	while (weights && *weights) {
+		const char *end = strchr(weights, WEIGHTS_SEPARATOR);
+		if (!end) {
+			end = weights + strlen(weights);
+		}
+		const char *separator = memchr(weights, WEIGHT_SEPARATOR,
+									   (size_t) (end - weights));
+		if (!separator || separator == weights ||
+			server->_weights_count == JVM_SERVER_MAX_WEIGHTS) {
+			return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		}
+		char *parsed_end;
+		errno = 0;
+		long weight = strtol(separator + 1, &parsed_end, 10);
+		if (errno != 0 || parsed_end != end || weight < 1 ||
+			weight > JVM_SERVER_MAX_WEIGHT) {
+			return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		}
+		jvm_server_weight *entry = &server->_weights[server->_weights_count++];
+		entry->session = weights;
+		entry->length = (size_t) (separator - weights);
+		entry->weight = (unsigned) weight;
+		weights = *end ? end + 1 : end;
+	}
 	return OPERATION_SUCCESS;
 }
 
+operation_result jvm_server_config(const char *port,
+								   const jvm_server_options *options,
+								   jvm_server *server) {
+	if (!server || !options)
+		return OPERATION_FAILURE_NULL_POINTER;
+	if (options->session_ttl < 0 || options->checkpoint_interval < 0 ||
+		!(options->trace_sample >= 0 && options->trace_sample <= 1) ||
+		options->workers < 0 || options->quantum < 1 ||
+		options->max_connections < 0 || options->max_queue < 0 ||
+		options->max_instructions < 0 || options->processes < 0 ||
+		options->parallel < 0 ||
+		options->parallel > JVM_DATAFLOW_MAX_THREADS)
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	// The workers share nothing: neither a transport other than TCP, nor the
+	// files and the port of the metrics
+	if (options->processes > 0 &&
+		(options->transport != JVM_TRANSPORT_TCP || options->checkpoint ||
+		 options->metrics || options->capture))
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	// A ring belongs to the thread that selects it, so the connections served
+	// in their own threads (with workers) can't use the one of the listener
+	if (options->workers > 0 && options->backend == SOCKET_BACKEND_URING)
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	// The shared memory transport has no sessions to save
+	if (options->transport == JVM_TRANSPORT_SHM &&
+		(options->checkpoint || options->checkpoint_interval > 0))
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	server->port = port;
+	server->options = *options;
+	server->_scheduler = NULL;
+	server->_capture = NULL;
+	return parse_weights(server, options->weights);
+}
+
+/**
+ * Static function that records the request of the {@param span} in the
+ * capture of the {@param server}, if any: its {@param program} as it was
+ * received and the variables of {@param vec} once executed with {@param
+ * status}
+ */
+static void capture_request(jvm_server *server, const jvm_span *span,
+							const char *program, long program_length,
+							const int_vector *vec, operation_result status) {
+	if (!server->_capture) {
+		return;
+	}
+	jvm_capture_entry entry;
+	entry.arrival = jvm_span_started(span);
+	entry.protocol = (strcmp(span->protocol, "legacy") == 0)
+					 ? JVM_CAPTURE_LEGACY
+					 : (strcmp(span->protocol, "shm") == 0) ? JVM_CAPTURE_SHM
+															: JVM_CAPTURE_FRAMED;
+	entry.session = (char *) span->session;
+	entry.var_size = span->var_size;
+	entry.program = (char *) program;
+	entry.program_length = program_length;
+	entry.status = status;
+	entry.variables = vec ? (int *) int_vector_data(vec) : NULL;
+	entry.variables_count = vec ? int_vector_size(vec) : 0;
+	jvm_capture_record(server->_capture, &entry);
+}
+
+/**
+ * Static function that returns the maximum of byte_codes that a request of
+ * the {@param server} executes
+ */
+static uint64_t instructions_limit(const jvm_server *server) {
+	return server->options.max_instructions > 0
+		   ? (uint64_t) server->options.max_instructions : UINT64_MAX;
+}
+
+/**
+ * Static function that returns the maximum length of the program of a request
+ * of the {@param server} with {@param var_size} variables, according to the
+ * maximum cost of a request: the bytes of its program and its variables.
+ * Without a maximum cost, a program {@param stored} whole in memory is still
+ * bounded to {@link JVM_SERVER_DEFAULT_MAX_PROGRAM} bytes, as its length
+ * comes from the client
+ * @return  the maximum length or -1 if the variables alone exceed it
+ */
+static long program_budget(const jvm_server *server, long var_size,
+						   bool stored) {
+	size_t max_bytes = server->options.max_request_bytes;
+	size_t variables_bytes = (size_t) var_size * sizeof(int);
+	if (max_bytes == 0) {
+		return stored ? JVM_SERVER_DEFAULT_MAX_PROGRAM : LONG_MAX;
+	}
+	if (var_size < 0) {
+		// An invalid quantity of variables is rejected on its own
+		return LONG_MAX;
+	}
+	if (variables_bytes > max_bytes) {
+		return -1;
+	}
+	return (long) (max_bytes - variables_bytes);
+}
+
 /**
- * Static function that receives the quantity of variables to store in memory
- * through the socket and creates the corresponding int_vector
+ * Static function that runs the whole {@param program} over {@param vec} and
+ * the {@param operands} stack in the calling thread with the {@param engine},
+ * printing the bytecode trace in {@param out}, up to {@param limit}
+ * byte_codes. A program beyond the limit is run by the stack engine, which
+ * stops there
+ * @return  {@link operation_result} with the result of the operation
  */
 static operation_result
-receive_variables_quantity(socket_t *remote_skt, int_vector *vec) {
-	int variables_quantity;
+run_program(const char *program, long program_length, int_vector *vec,
+			stack *operands, jvm_engine_kind engine, uint64_t limit,
+			FILE *out, jvm_span *span) {
+	if (engine == JVM_ENGINE_REGISTER) {
+		uint64_t executed_instructions;
+		long consumed;
+		bool executed;
+		operation_result result = jvm_register_execute(
+				program, program_length, vec, operands, limit,
+				&executed_instructions, &consumed, &executed);
+		if (executed) {
+			jvm_engine_trace(program, consumed, out);
+			span->instructions += executed_instructions;
+			// The last byte_code is missing its argument
+			return (result == OPERATION_SUCCESS && consumed != program_length)
+				   ? OPERATION_FAILURE_ILLEGAL_ARGUMENT : result;
+		}
+	}
+	uint64_t instructions = jvm_engine_instructions();
+	long pc = 0;
+	bool finished;
+	operation_result result = jvm_engine_run_slice(program, program_length,
+												   &pc, limit, vec, operands,
+												   out, &finished);
+	if (result == OPERATION_SUCCESS && !finished) {
+		result = OPERATION_FAILURE_LIMIT_EXCEEDED;
+	} else if (result == OPERATION_SUCCESS && pc != program_length) {
+		// The last byte_code is missing its argument
+		result = OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	}
+	span->instructions += jvm_engine_instructions() - instructions;
+	return result;
+}
 
-	// Receive the integer with the quantity of variables through the socket
-	if (socket_recv_int(remote_skt, &variables_quantity) ==
-		SOCKET_CONNECTION_ERROR) {
+/**
+ * Static function that runs the whole {@param program} in the workers of the
+ * {@param scheduler}, in turns with the other requests, with its {@param
+ * weight}, up to {@param limit} byte_codes
+ * @return  {@link operation_result} with the result of the operation
+ */
+static operation_result
+schedule_program(jvm_scheduler *scheduler, const char *program,
+				 long program_length, int_vector *vec, stack *operands,
+				 unsigned weight, uint64_t limit, FILE *out, jvm_span *span) {
+	jvm_task task;
+	operation_result result = jvm_task_create(&task, program, program_length,
+											  vec, operands, out, weight,
+											  limit);
+	if (result == OPERATION_SUCCESS) {
+		result = jvm_scheduler_run(scheduler, &task);
+		if (result == OPERATION_SUCCESS) {
+			result = task.result;
+			span->instructions += task.instructions;
+		}
+		jvm_task_destroy(&task);
+	}
+	return result;
+}
+
+/**
+ * Output of a request run by the workers, kept until a chunk of whole lines
+ * can be printed, so memory doesn't grow with its trace
+ */
+typedef struct request_output {
+	char *buffer;
+	size_t used;
+	bool discarded;
+} request_output;
+
+/**
+ * Static function that prints the buffered lines of {@param output} in stdout,
+ * or all of it when {@param whole} (or when a line fills the buffer)
+ */
+static void print_request_output(request_output *output, bool whole) {
+	size_t printed = output->used;
+	if (!whole) {
+		while (printed > 0 && output->buffer[printed - 1] != '\n') {
+			printed--;
+		}
+		if (printed == 0) {
+			printed = output->used;
+		}
+	}
+	// A single fwrite holds the lock of stdout, so lines aren't mixed
+	fwrite(output->buffer, 1, printed, stdout);
+	memmove(output->buffer, &output->buffer[printed], output->used - printed);
+	output->used -= printed;
+}
+
+/**
+ * Static function that buffers the {@param size} bytes of {@param data}
+ * written to the stream of a request
+ */
+static ssize_t
+write_request_output(void *cookie, const char *data, size_t size) {
+	request_output *output = (request_output *) cookie;
+	size_t taken = 0;
+	while (taken < size) {
+		size_t room = REQUEST_OUTPUT_CHUNK - output->used;
+		size_t copied = (size - taken < room) ? size - taken : room;
+		memcpy(&output->buffer[output->used], &data[taken], copied);
+		output->used += copied;
+		taken += copied;
+		if (output->used == REQUEST_OUTPUT_CHUNK) {
+			print_request_output(output, false);
+		}
+	}
+	return (ssize_t) size;
+}
+
+/**
+ * Static function that prints what's left of the stream of a request, unless
+ * it was discarded, and releases it
+ */
+static int close_request_output(void *cookie) {
+	request_output *output = (request_output *) cookie;
+	if (!output->discarded) {
+		print_request_output(output, true);
+	}
+	free(output->buffer);
+	free(output);
+	return 0;
+}
+
+/**
+ * Static function that opens the stream where a request run by the workers
+ * prints its output. It's printed in chunks of whole lines, so memory is
+ * bounded but the lines of concurrent requests may alternate past a chunk
+ * @return  the stream or NULL if there's no memory
+ */
+static FILE *open_request_output(request_output **output) {
+	*output = (request_output *) calloc(1, sizeof(request_output));
+	if (!*output) {
+		return NULL;
+	}
+	(*output)->buffer = (char *) malloc(REQUEST_OUTPUT_CHUNK);
+	cookie_io_functions_t functions = {NULL, write_request_output, NULL,
+									   close_request_output};
+	FILE *out = (*output)->buffer ? fopencookie(*output, "w", functions)
+								  : NULL;
+	if (!out) {
+		free((*output)->buffer);
+		free(*output);
+	}
+	return out;
+}
+
+/**
+ * Static function that executes a whole {@param program} over {@param vec}
+ * and the {@param operands} stack, printing the bytecode trace and the
+ * variables dump in stdout, as the execute and dump phases of {@param span}.
+ * When the server has workers, the program is scheduled among them with its
+ * {@param weight}, and its output is printed in chunks of whole lines, so
+ * short outputs of concurrent requests aren't interleaved and long ones
+ * don't pile up in memory. A program rejected by the workers prints nothing
+ * (not even the variables), and one reaching the maximum of byte_codes of
+ * the server is stopped there. With parallel threads, a large program that
+ * starts with no operands is split in independent chains run in parallel
+ * instead, when it can be. The programs executed are captured
+ * @return  {@link operation_result} with the result of the operation. A
+ *          byte_code missing its argument is an illegal argument
+ */
+static operation_result
+execute_program(jvm_server *server, const char *program, long program_length,
+				int_vector *vec, stack *operands, unsigned weight,
+				jvm_span *span) {
+	request_output *output = NULL;
+	FILE *out = server->_scheduler ? open_request_output(&output) : stdout;
+	if (!out) {
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
+	fprintf(out, "%s\n", BYTE_CODES_OUTPUT_TITLE);
+	uint64_t limit = instructions_limit(server);
+	operation_result result = OPERATION_SUCCESS;
+	bool parallel = false;
+	if (server->options.parallel > 1 &&
+		program_length >= JVM_DATAFLOW_MIN_LENGTH &&
+		stack_size(operands) == 0) {
+		uint64_t instructions = 0;
+		result = jvm_dataflow_run(program, program_length, vec,
+								  server->options.parallel, out, limit,
+								  &instructions, &parallel);
+		span->instructions += instructions;
+	}
+	if (!parallel) {
+		result = server->_scheduler
+				? schedule_program(server->_scheduler, program,
+								   program_length, vec, operands, weight,
+								   limit, out, span)
+				: run_program(program, program_length, vec, operands,
+							  server->options.engine, limit, out, span);
+	}
+	if (result == OPERATION_FAILURE_BUSY) {
+		jvm_metrics_add(JVM_COUNTER_SHED_QUEUE, 1);
+	} else if (result == OPERATION_FAILURE_LIMIT_EXCEEDED) {
+		jvm_metrics_add(JVM_COUNTER_SHED_INSTRUCTIONS, 1);
+	} else if (jvm_fault_is(result)) {
+		jvm_metrics_add(JVM_COUNTER_FAULTS, 1);
+	}
+	fprintf(out, "\n");
+	jvm_span_mark(span, JVM_PHASE_EXECUTE);
+
+	if (result != OPERATION_FAILURE_BUSY) {
+		fprintf(out, "%s\n", VARIABLES_OUTPUT_TITLE);
+		int_vector_print_elements(vec, out);
+		capture_request(server, span, program, program_length, vec, result);
+	}
+	if (out != stdout) {
+		// A request rejected by the workers never ran, nothing was printed
+		output->discarded = (result == OPERATION_FAILURE_BUSY);
+		fclose(out);
+	}
+	jvm_span_mark(span, JVM_PHASE_DUMP);
+	return result;
+}
+
+/**
+ * Static function that receives a whole legacy {@param program}, until the
+ * client shutdowns the socket for writing
+ * @post    {@param program} must be released with free
+ * @return  {@link operation_result} with the result of the operation, which
+ *          is OPERATION_FAILURE_LIMIT_EXCEEDED beyond {@param max_length}
+ */
+static operation_result
+receive_program(socket_t *skt, long max_length, char **program,
+				long *length) {
+	// The buffer never grows beyond a byte past the maximum
+	long capacity = (max_length < PROGRAM_BLOCK) ? max_length + 1
+												 : PROGRAM_BLOCK;
+	char *buffer = (char *) malloc((size_t) capacity);
+	long received = 0;
+	long s = 0;
+	while (buffer && (s = socket_recv(skt, &buffer[received],
+									  capacity - received)) ==
+					 capacity - received) {
+		received = capacity;
+		if (received > max_length) {
+			free(buffer);
+			return OPERATION_FAILURE_LIMIT_EXCEEDED;
+		}
+		capacity = (capacity > max_length / 2) ? max_length + 1
+											   : capacity * 2;
+		char *grown = (char *) realloc(buffer, (size_t) capacity);
+		if (!grown) {
+			free(buffer);
+		}
+		buffer = grown;
+	}
+	if (!buffer) {
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
+	if (s == SOCKET_CONNECTION_ERROR) {
+		free(buffer);
 		return OPERATION_FAILURE_CONNECTION_FAILED;
 	}
+	*program = buffer;
+	*length = received + s;
+	return OPERATION_SUCCESS;
+}
+
+/**
+ * Static function that serves a legacy request: the byte_codes are received in
+ * chunks until the client shutdowns the socket for writing. When the server
+ * has workers, the whole program is received first and then scheduled
+ * @return  {@link operation_result} with the result of the operation
+ */
+static operation_result
+serve_legacy_request(jvm_server *server, socket_t *remote_connection_socket,
+					 int variables_quantity, jvm_span *span) {
+	// Rejects the request right away if its variables exceed its maximum cost
+	span->var_size = variables_quantity;
+	long max_program = program_budget(
+			server, variables_quantity, server->_scheduler || server->_capture);
+	if (max_program < 0) {
+		jvm_metrics_add(JVM_COUNTER_SHED_COST, 1);
+		return OPERATION_FAILURE_LIMIT_EXCEEDED;
+	}
 
 	// Create the int_vector with the received quantity
-	int_vector_create(vec, variables_quantity);
+	int_vector vec;
+	if (int_vector_create(&vec, variables_quantity) != OPERATION_SUCCESS) {
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
+
+	// Creates the stack
+	stack s;
+	if (stack_create(&s, sizeof(int)) != OPERATION_SUCCESS) {
+		int_vector_destroy(&vec);
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
+	jvm_span_mark(span, JVM_PHASE_DECODE);
+
+	operation_result result;
+	if (server->_scheduler) {
+		char *program;
+		result = receive_program(remote_connection_socket, max_program,
+								 &program, &span->program_bytes);
+		jvm_span_mark(span, JVM_PHASE_RECEIVE);
+		if (result == OPERATION_SUCCESS) {
+			// As when executing in chunks, a last byte_code missing its
+			// argument is ignored
+			operation_result executed = execute_program(
+					server, program, span->program_bytes, &vec, &s, 1, span);
+			if (executed == OPERATION_FAILURE_BUSY ||
+				executed == OPERATION_FAILURE_LIMIT_EXCEEDED ||
+				jvm_fault_is(executed)) {
+				result = executed;
+			}
+			free(program);
+		} else if (result == OPERATION_FAILURE_LIMIT_EXCEEDED) {
+			jvm_metrics_add(JVM_COUNTER_SHED_COST, 1);
+		}
+	} else {
+		// The program is only kept whole if it's captured
+		char *received = NULL;
+		size_t received_size = 0;
+		FILE *copy = server->_capture
+					 ? open_memstream(&received, &received_size) : NULL;
+		//Receive the byte_codes in chunks and process them
+		result = receive_and_process_byte_codes(
+				remote_connection_socket, &vec, &s, CHUNK_SIZE, max_program,
+				instructions_limit(server), copy, span);
+		if (copy) {
+			if (fclose(copy) == 0) {
+				capture_request(server, span, received, (long) received_size,
+								&vec, result);
+			}
+			free(received);
+		}
+		if (result == OPERATION_SUCCESS) {
+			// Print the stored variables in stdout
+			printf("%s\n", VARIABLES_OUTPUT_TITLE);
+			int_vector_print_elements(&vec, stdout);
+			jvm_span_mark(span, JVM_PHASE_DUMP);
+		}
+	}
+
+	// Destroys the stack
+	stack_destroy(&s);
+	if (result != OPERATION_SUCCESS) {
+		// A legacy client learns about a rejection by not getting variables
+		int_vector_destroy(&vec);
+		return (result == OPERATION_FAILURE_BUSY ||
+				result == OPERATION_FAILURE_LIMIT_EXCEEDED ||
+				jvm_fault_is(result))
+			   ? result : OPERATION_FAILURE_CONNECTION_FAILED;
+	}
+
+	// Send the variables through the socket
+	result = send_variables(remote_connection_socket, &vec);
+	jvm_span_mark(span, JVM_PHASE_SEND);
+	if (result == OPERATION_SUCCESS) {
+		JVM_PROBE3(dump_sent, span->connection, span->id, span->var_size);
+	}
+
+	// Destroys the int_vector
+	int_vector_destroy(&vec);
+
+	return result;
+}
+
+/**
+ * Static function that checks that the {@param count} {@param ranges} are
+ * within the {@param var_size} variables
+ * @return the quantity of variables projected or -1 if they aren't
+ */
+static long projected_size(const jvm_range *ranges, uint32_t count,
+						   int32_t var_size) {
+	long total = 0;
+	for (uint32_t i = 0; i < count; i++) {
+		if (ranges[i].first > (uint32_t) var_size ||
+			ranges[i].count > (uint32_t) var_size - ranges[i].first) {
+			return -1;
+		}
+		total += ranges[i].count;
+	}
+	return (total > INT32_MAX) ? -1 : total;
+}
+
+/**
+ * Static function that creates {@param projection} with the variables of
+ * {@param vec} within the {@param count} {@param ranges}, in their order. Only
+ * the variables that aren't zero are copied, so the untouched pages stay so
+ */
+static operation_result
+project_variables(const int_vector *vec, const jvm_range *ranges,
+				  uint32_t count, long size, int_vector *projection) {
+	if (int_vector_create(projection, (int) size) != OPERATION_SUCCESS) {
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
+	const int *data = int_vector_data(vec);
+	int pos = 0;
+	for (uint32_t i = 0; i < count; i++) {
+		for (uint32_t j = 0; j < ranges[i].count; j++, pos++) {
+			int value = data[ranges[i].first + j];
+			if (value != 0) {
+				int_vector_set(projection, pos, value);
+			}
+		}
+	}
+	return OPERATION_SUCCESS;
+}
+
+/**
+ * Body of a framed request, received after its header
+ *          - session: name of the session or NULL
+ *          - ranges: the ranges_count ranges of the projection or NULL
+ *          - checksum: the one sent for the program, if any
+ *          - program: the byte_codes to be executed
+ */
+typedef struct framed_request {
+	char *session;
+	jvm_range *ranges;
+	uint32_t ranges_count;
+	uint32_t checksum;
+	char *program;
+} framed_request;
 
+static void framed_request_release(framed_request *request) {
+	free(request->session);
+	free(request->ranges);
+	free(request->program);
+}
+
+/**
+ * Static function that receives and drops {@param length} bytes from {@param
+ * skt}, without storing them: they're received in blocks of {@link
+ * PROGRAM_BLOCK} bytes, so a huge program takes few syscalls
+ * @return  {@link operation_result} with the result of the operation
+ */
+static operation_result discard_bytes(socket_t *skt, long length) {
+	long size = (length < PROGRAM_BLOCK) ? length : PROGRAM_BLOCK;
+	char *scratch = (char *) malloc((size_t) size + 1);
+	if (!scratch) {
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
+	operation_result result = OPERATION_SUCCESS;
+	while (length > 0 && result == OPERATION_SUCCESS) {
+		long block = (length < size) ? length : size;
+		if (socket_recv(skt, scratch, block) != block) {
+			result = OPERATION_FAILURE_CONNECTION_FAILED;
+		}
+		length -= block;
+	}
+	free(scratch);
+	return result;
+}
+
+/**
+ * Static function that receives the session, the projection and the checksum
+ * (if any) and the program of the framed request described by {@param
+ * header}. As its length is known, the program is allocated once and received
+ * whole. The program of a request being rejected is dropped if {@param
+ * discard} is true, so the connection stays usable without storing it
+ */
+static operation_result
+receive_framed_request(socket_t *skt, const jvm_request_header *header,
+					   bool discard, framed_request *request) {
+	memset(request, 0, sizeof(framed_request));
+	int checksum = 0;
+	if (((header->flags & PROTOCOL_FLAG_SESSION) &&
+		 jvm_protocol_recv_session(skt, &request->session) ==
+		 SOCKET_CONNECTION_ERROR) ||
+		((header->flags & PROTOCOL_FLAG_PROJECTION) &&
+		 jvm_protocol_recv_projection(skt, &request->ranges,
+									  &request->ranges_count) ==
+		 SOCKET_CONNECTION_ERROR) ||
+		((header->flags & PROTOCOL_FLAG_CHECKSUM) &&
+		 socket_recv_int(skt, &checksum) == SOCKET_CONNECTION_ERROR)) {
+		framed_request_release(request);
+		return OPERATION_FAILURE_CONNECTION_FAILED;
+	}
+	request->checksum = (uint32_t) checksum;
+	long program_length = header->program_length;
+	if (discard) {
+		operation_result discarded = discard_bytes(skt, program_length);
+		if (discarded != OPERATION_SUCCESS) {
+			framed_request_release(request);
+		}
+		return discarded;
+	}
+	request->program = (char *) malloc((size_t) program_length + 1);
+	if (!request->program) {
+		framed_request_release(request);
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
+	if (socket_recv(skt, request->program, program_length) != program_length) {
+		framed_request_release(request);
+		return OPERATION_FAILURE_CONNECTION_FAILED;
+	}
 	return OPERATION_SUCCESS;
 }
 
-operation_result jvm_server_config(const char *port, jvm_server *server) {
-	if (!server)
-		return OPERATION_FAILURE_NULL_POINTER;
-	server->port = port;
+/**
+ * Static function that sends the response of a framed request, with the
+ * variables of {@param vec} if the execution succeeded
+ * @return  {@link operation_result} with the result of the operation
+ */
+static operation_result
+send_framed_response(socket_t *skt, const jvm_response_header *response,
+					 const int_vector *vec, bool compact) {
+	if (jvm_protocol_send_response_header(skt, response) ==
+		SOCKET_CONNECTION_ERROR ||
+		(response->var_size > 0 &&
+		 jvm_protocol_send_variables(skt, vec, compact) ==
+		 SOCKET_CONNECTION_ERROR)) {
+		return OPERATION_FAILURE_CONNECTION_FAILED;
+	}
 	return OPERATION_SUCCESS;
 }
 
-operation_result jvm_server_start(jvm_server *server) {
-	socket_t my_socket;
-	socket_t remote_connection_socket;
+/**
+ * Static function that adds the traffic of {@param skt} not accounted yet to
+ * the metrics
+ */
+static void publish_traffic(socket_t *skt) {
+	jvm_metrics_add(JVM_COUNTER_BYTES_RECEIVED, skt->bytes_received);
+	jvm_metrics_add(JVM_COUNTER_BYTES_SENT, skt->bytes_sent);
+	skt->bytes_received = 0;
+	skt->bytes_sent = 0;
+}
+
+/**
+ * Static function that publishes the statistics of the {@param sessions}
+ */
+static void publish_sessions(const jvm_session_table *sessions) {
+	jvm_session_stats stats;
+	jvm_session_table_stats(sessions, &stats);
+	jvm_metrics_set(JVM_GAUGE_SESSIONS, stats.sessions);
+	jvm_metrics_set(JVM_GAUGE_SESSION_BYTES, (int64_t) stats.memory);
+	jvm_metrics_set(JVM_GAUGE_SESSION_HITS, stats.hits);
+	jvm_metrics_set(JVM_GAUGE_SESSION_MISSES, stats.misses);
+	jvm_metrics_set(JVM_GAUGE_SESSION_EVICTIONS, stats.evictions);
+}
 
-	// Configure the socket to be a listener in the given port
-	if (socket_bind_and_address(&my_socket, server->port) ==
+/**
+ * Static function that finds or creates the session named {@param name} with
+ * {@param var_size} variables and pins it. Requests of the same session are
+ * served one at a time, so this waits until the session isn't in use
+ * @return  {@link operation_result} with the result of the operation
+ */
+static operation_result
+acquire_session(jvm_server *server, const char *name, int32_t var_size,
+				jvm_session **session) {
+	pthread_mutex_lock(&server->_sessions_lock);
+	operation_result result;
+	while ((result = jvm_session_table_acquire(&server->_sessions, name,
+											   var_size, session)) ==
+		   OPERATION_SUCCESS && jvm_session_pinned(*session)) {
+		pthread_cond_wait(&server->_sessions_idle, &server->_sessions_lock);
+	}
+	if (result == OPERATION_SUCCESS) {
+		jvm_session_pin(&server->_sessions, *session);
+	} else {
+		*session = NULL;
+	}
+	pthread_mutex_unlock(&server->_sessions_lock);
+	return result;
+}
+
+/**
+ * Static function that unpins the {@param session} once its request is done
+ */
+static void release_session(jvm_server *server, jvm_session *session) {
+	pthread_mutex_lock(&server->_sessions_lock);
+	jvm_session_unpin(&server->_sessions, session);
+	publish_sessions(&server->_sessions);
+	pthread_cond_broadcast(&server->_sessions_idle);
+	pthread_mutex_unlock(&server->_sessions_lock);
+}
+
+/**
+ * Static function that returns the weight configured for the {@param session}
+ * (1 if there's none or it has no weight)
+ */
+static unsigned weight_of(const jvm_server *server, const char *session) {
+	for (int i = 0; session && i < server->_weights_count; i++) {
+		const jvm_server_weight *entry = &server->_weights[i];
+		if (strlen(session) == entry->length &&
+			strncmp(entry->session, session, entry->length) == 0) {
+			return entry->weight;
+		}
+	}
+	return 1;
+}
+
+/**
+ * Static function that verifies the whole program of the framed {@param
+ * request} described by {@param header} before executing it: it must match
+ * its checksum (if it carries one), no byte_code can be missing its argument
+ * nor load a variable beyond the ones requested, and it can't run more
+ * byte_codes than the maximum of the {@param server}.
+ * So a request that would fail doesn't change the variables of its session
+ * @return  {@link operation_result} with the result of the verification
+ */
+static operation_result
+verify_framed_request(const jvm_server *server,
+					  const jvm_request_header *header,
+					  const framed_request *request) {
+	if ((header->flags & PROTOCOL_FLAG_CHECKSUM) &&
+		jvm_protocol_checksum(0, request->program, header->program_length) !=
+		request->checksum) {
+		return OPERATION_FAILURE_CHECKSUM_MISMATCH;
+	}
+	uint64_t instructions;
+	operation_result result = jvm_engine_verify(
+			request->program, header->program_length, header->var_size,
+			&instructions);
+	if (result == OPERATION_SUCCESS &&
+		instructions > instructions_limit(server)) {
+		jvm_metrics_add(JVM_COUNTER_SHED_INSTRUCTIONS, 1);
+		result = OPERATION_FAILURE_LIMIT_EXCEEDED;
+	}
+	return result;
+}
+
+/**
+ * Static function that receives the program of the framed request described
+ * by {@param header}, verifies it, executes it and sends back the response. A request
+ * within a session runs over the variables and operands kept by the server
+ * for it. When the request carries a projection, only the projected variables
+ * are sent. The span of the request starts once its header is received, as
+ * the connection is idle between requests
+ * @return  {@link operation_result} with the result of the operation. Only
+ *          failures that leave the connection unusable are returned, the
+ *          ones caused by the request itself travel in the response status
+ */
+static operation_result
+serve_framed_request(jvm_server *server, socket_t *skt, long connection,
+					 const jvm_request_header *header) {
+	jvm_span span;
+	jvm_span_begin(&span, connection, "framed");
+	span.id = header->id;
+	span.var_size = header->var_size;
+	span.program_bytes = header->program_length;
+	// A request beyond the maximum cost is rejected without storing it
+	bool too_costly = (long) header->program_length >
+					  program_budget(server, header->var_size, true);
+	framed_request request;
+	operation_result result = receive_framed_request(skt, header, too_costly,
+													 &request);
+	if (result != OPERATION_SUCCESS) {
+		return result;
+	}
+	span.session = request.session;
+	jvm_span_mark(&span, JVM_PHASE_RECEIVE);
+	bool projected = header->flags & PROTOCOL_FLAG_PROJECTION;
+	long projection_size = header->var_size;
+	if (projected && header->var_size >= 0) {
+		projection_size = projected_size(request.ranges, request.ranges_count,
+										 header->var_size);
+	}
+
+	jvm_response_header response = {header->id, OPERATION_SUCCESS, 0};
+	jvm_session *session = NULL;
+	int_vector own_vec;
+	stack own_operands;
+	int_vector *vec = NULL;
+	int_vector projection;
+	bool projection_created = false;
+	if ((header->flags & ~PROTOCOL_FLAGS_SUPPORTED) != 0 ||
+		header->var_size < 0 || projection_size < 0) {
+		response.status = OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	} else if (too_costly) {
+		jvm_metrics_add(JVM_COUNTER_SHED_COST, 1);
+		response.status = OPERATION_FAILURE_LIMIT_EXCEEDED;
+	} else {
+		response.status = verify_framed_request(server, header, &request);
+	}
+	if (response.status == OPERATION_SUCCESS && request.session) {
+		response.status = acquire_session(server, request.session,
+										  header->var_size, &session);
+		vec = session ? &session->variables : NULL;
+	} else if (response.status == OPERATION_SUCCESS) {
+		if (int_vector_create(&own_vec, header->var_size) !=
+			OPERATION_SUCCESS) {
+			response.status = OPERATION_FAILURE_NO_MEMORY;
+		} else if (stack_create(&own_operands, sizeof(int)) !=
+				   OPERATION_SUCCESS) {
+			int_vector_destroy(&own_vec);
+			response.status = OPERATION_FAILURE_NO_MEMORY;
+		} else {
+			vec = &own_vec;
+		}
+	}
+	jvm_span_mark(&span, JVM_PHASE_DECODE);
+
+	if (response.status == OPERATION_SUCCESS) {
+		response.status = execute_program(
+				server, request.program, header->program_length, vec,
+				session ? &session->operands : &own_operands,
+				weight_of(server, request.session), &span);
+		if (response.status == OPERATION_SUCCESS && projected) {
+			response.status = project_variables(vec, request.ranges,
+												request.ranges_count,
+												projection_size, &projection);
+			projection_created = response.status == OPERATION_SUCCESS;
+		}
+		if (response.status == OPERATION_SUCCESS) {
+			response.var_size = (int32_t) projection_size;
+		}
+	}
+
+	// The projection is part of sending the response
+	result = send_framed_response(skt, &response,
+								  projected ? &projection : vec,
+								  header->flags & PROTOCOL_FLAG_COMPACT);
+	jvm_span_mark(&span, JVM_PHASE_SEND);
+	if (result == OPERATION_SUCCESS && response.var_size > 0) {
+		JVM_PROBE3(dump_sent, connection, header->id, response.var_size);
+	}
+	span.status = response.status;
+	end_request(server, &span);
+	framed_request_release(&request);
+	if (projection_created) {
+		int_vector_destroy(&projection);
+	}
+	if (session) {
+		release_session(server, session);
+	}
+	if (vec == &own_vec) {
+		stack_destroy(&own_operands);
+		int_vector_destroy(&own_vec);
+	}
+	return result;
+}
+
+/**
+ * Static function that serves framed requests until the client finishes the
+ * connection. Requests are answered in the order they arrive, although the
+ * protocol allows the answers to be sent in any order
+ * @return  {@link operation_result} with the result of the operation
+ */
+static operation_result serve_framed_requests(jvm_server *server,
+											  socket_t *skt, long connection) {
+	operation_result result = OPERATION_SUCCESS;
+	int s = SOCKET_CONNECTION_SUCCESS;
+	jvm_request_header header;
+	while (result == OPERATION_SUCCESS &&
+		   (s = jvm_protocol_recv_request_header(skt, &header)) ==
+		   SOCKET_CONNECTION_SUCCESS) {
+		result = serve_framed_request(server, skt, connection, &header);
+		publish_traffic(skt);
+	}
+	return (s == SOCKET_CONNECTION_ERROR) ? OPERATION_FAILURE_CONNECTION_FAILED
+										  : result;
+}
+
+/**
+ * Static function that serves a single client connected through {@param
+ * remote_connection_socket}. The first int received is either the quantity of
+ * variables of a legacy request or {@link PROTOCOL_FRAMED_MAGIC}. The span of
+ * a legacy request starts with the connection, {@param connection} being its
+ * sequence number
+ * @return  {@link operation_result} with the result of the operation
+ */
+static operation_result serve_connection(jvm_server *server,
+										 socket_t *remote_connection_socket,
+										 long connection) {
+	jvm_span span;
+	jvm_span_begin(&span, connection, "legacy");
+	int first_int;
+	if (socket_recv_int(remote_connection_socket, &first_int) ==
 		SOCKET_CONNECTION_ERROR) {
 		return OPERATION_FAILURE_CONNECTION_FAILED;
 	}
+	if (first_int == PROTOCOL_FRAMED_MAGIC) {
+		return serve_framed_requests(server, remote_connection_socket,
+									 connection);
+	}
+	jvm_span_mark(&span, JVM_PHASE_HEADER);
+	operation_result result = serve_legacy_request(
+			server, remote_connection_socket, first_int, &span);
+	span.status = result;
+	end_request(server, &span);
+	return result;
+}
 
-	// Wait and accept for an incoming connection
-	if (socket_accept(&my_socket, &remote_connection_socket) ==
-		SOCKET_CONNECTION_ERROR) {
-		socket_close(&my_socket);
+/**
+ * Static function that serves the requests of co-located clients through a
+ * shared memory region named as the configured port. The programs are executed
+ * and their variables stored in place, within the region
+ * @return  {@link operation_result} with the result of the operation
+ */
+static operation_result serve_shared_memory(jvm_server *server) {
+	shm_channel channel;
+	if (shm_channel_create(&channel, server->port,
+						   server->options.shm_size) == SHM_CHANNEL_ERROR) {
 		return OPERATION_FAILURE_CONNECTION_FAILED;
 	}
 
-	// Receive the quantity of variables through the socket
-	int_vector vec;
-	if (receive_variables_quantity(&remote_connection_socket, &vec) !=
+	operation_result result = OPERATION_SUCCESS;
+	int connections = server->options.connections;
+	for (int served = 0; connections == 0 || served < connections; served++) {
+		const char *program;
+		size_t program_length;
+		int32_t var_size;
+		if (shm_channel_wait_request(&channel, &program, &program_length,
+									 &var_size) == SHM_CHANNEL_ERROR) {
+			result = OPERATION_FAILURE_CONNECTION_FAILED;
+			break;
+		}
+
+		jvm_span span;
+		jvm_span_begin(&span, served, "shm");
+		span.var_size = var_size;
+		span.program_bytes = (long) program_length;
+		int *variables = shm_channel_variables(&channel, var_size);
+		int_vector vec;
+		stack operands;
+		if (var_size < 0) {
+			result = OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		} else if (!variables ||
+				   stack_create(&operands, sizeof(int)) != OPERATION_SUCCESS) {
+			result = OPERATION_FAILURE_NO_MEMORY;
+		} else {
+			int_vector_attach(&vec, variables, var_size);
+			jvm_span_mark(&span, JVM_PHASE_DECODE);
+			result = execute_program(server, program, (long) program_length,
+									 &vec, &operands, 1, &span);
+			int_vector_destroy(&vec);
+			stack_destroy(&operands);
+		}
+		shm_channel_respond(&channel, (result == OPERATION_SUCCESS) ? var_size
+																	: 0,
+							result);
+		fflush(stdout);
+		jvm_span_mark(&span, JVM_PHASE_SEND);
+		span.status = result;
+		end_request(server, &span);
+	}
+
+	shm_channel_close(&channel);
+	return result;
+}
+
+/**
+ * Static function that serves the {@param served} connection accepted in
+ * {@param skt} until the client finishes, and closes it
+ * @return  {@link operation_result} with the result of the connection
+ */
+static operation_result
+handle_connection(jvm_server *server, socket_t *skt, int served) {
+	JVM_PROBE2(connection_accept, served, skt->fd);
+	jvm_metrics_add(JVM_COUNTER_CONNECTIONS, 1);
+	jvm_metrics_gauge_add(JVM_GAUGE_ACTIVE_CONNECTIONS, 1);
+	operation_result result = serve_connection(server, skt, served);
+	publish_traffic(skt);
+	jvm_metrics_gauge_add(JVM_GAUGE_ACTIVE_CONNECTIONS, -1);
+
+	// Closes the peer socket entirely
+	JVM_PROBE2(connection_close, served, result);
+	socket_close(skt);
+	fflush(stdout);
+	return result;
+}
+
+/**
+ * Connection served in its own thread while the scheduler is used
+ */
+typedef struct connection_thread {
+	jvm_server *server;
+	socket_t socket;
+	int served;
+} connection_thread;
+
+/**
+ * Static function run by the thread of each connection, which is detached
+ */
+static void *serve_connection_thread(void *arg) {
+	connection_thread *connection = (connection_thread *) arg;
+	jvm_server *server = connection->server;
+	handle_connection(server, &connection->socket, connection->served);
+	free(connection);
+	jvm_metrics_thread_exit();
+
+	pthread_mutex_lock(&server->_live_lock);
+	server->_live_connections--;
+	pthread_cond_broadcast(&server->_live_idle);
+	pthread_mutex_unlock(&server->_live_lock);
+	return NULL;
+}
+
+/**
+ * Static function that starts a thread serving the {@param served} connection
+ * accepted in {@param skt}. If the maximum of connections is already being
+ * served, it's closed right away instead, which isn't a failure of the server
+ * @return  {@link operation_result} with the result of the operation
+ */
+static operation_result
+spawn_connection(jvm_server *server, socket_t *skt, int served) {
+	int max_connections = server->options.max_connections;
+	pthread_mutex_lock(&server->_live_lock);
+	bool full = max_connections > 0 &&
+				server->_live_connections >= max_connections;
+	pthread_mutex_unlock(&server->_live_lock);
+	if (full) {
+		jvm_metrics_add(JVM_COUNTER_CONNECTIONS, 1);
+		jvm_metrics_add(JVM_COUNTER_SHED_CONNECTIONS, 1);
+		JVM_PROBE2(connection_close, served, OPERATION_FAILURE_BUSY);
+		socket_close(skt);
+		return OPERATION_SUCCESS;
+	}
+
+	connection_thread *connection =
+			(connection_thread *) malloc(sizeof(connection_thread));
+	if (!connection) {
+		socket_close(skt);
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
+	connection->server = server;
+	connection->socket = *skt;
+	connection->served = served;
+
+	pthread_mutex_lock(&server->_live_lock);
+	server->_live_connections++;
+	pthread_mutex_unlock(&server->_live_lock);
+	pthread_attr_t attributes;
+	pthread_attr_init(&attributes);
+	pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+	pthread_t thread;
+	int created = pthread_create(&thread, &attributes, serve_connection_thread,
+								 connection);
+	pthread_attr_destroy(&attributes);
+	if (created != 0) {
+		pthread_mutex_lock(&server->_live_lock);
+		server->_live_connections--;
+		pthread_mutex_unlock(&server->_live_lock);
+		socket_close(skt);
+		free(connection);
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
+	return OPERATION_SUCCESS;
+}
+
+/**
+ * Static function that lists the names of the sessions of the {@param server},
+ * from the least to the most recently used
+ * @post    {@param names} and each name must be released with free
+ * @return  {@link operation_result} with the result of the operation
+ */
+static operation_result list_sessions(jvm_server *server, char ***names,
+									  uint32_t *count) {
+	pthread_mutex_lock(&server->_sessions_lock);
+	jvm_session_stats stats;
+	jvm_session_table_stats(&server->_sessions, &stats);
+	*names = (char **) calloc((size_t) stats.sessions + 1, sizeof(char *));
+	*count = 0;
+	operation_result result = *names ? OPERATION_SUCCESS
+									 : OPERATION_FAILURE_NO_MEMORY;
+	for (const jvm_session *s = jvm_session_table_oldest(&server->_sessions);
+		 s && result == OPERATION_SUCCESS; s = jvm_session_newer(s)) {
+		(*names)[*count] = strdup(s->name);
+		result = (*names)[(*count)++] ? OPERATION_SUCCESS
+									  : OPERATION_FAILURE_NO_MEMORY;
+	}
+	pthread_mutex_unlock(&server->_sessions_lock);
+	return result;
+}
+
+/**
+ * Static function that pins the session named {@param name} of the {@param
+ * server} for the checkpoint, once the request using it (if any) is done.
+ * New requests wait for it meanwhile, as it's pinned
+ * @return the session or NULL if it was evicted
+ */
+static jvm_session *pin_for_checkpoint(jvm_server *server, const char *name) {
+	pthread_mutex_lock(&server->_sessions_lock);
+	jvm_session *session = jvm_session_table_find(&server->_sessions, name);
+	if (session) {
+		jvm_session_pin(&server->_sessions, session);
+		while (jvm_session_pins(session) > 1) {
+			pthread_cond_wait(&server->_sessions_idle,
+							  &server->_sessions_lock);
+		}
+	}
+	pthread_mutex_unlock(&server->_sessions_lock);
+	return session;
+}
+
+/**
+ * Static function that saves the sessions of the {@param server} in its
+ * checkpoint a session at a time: each one is written while it's pinned, so
+ * it only waits for the request using that session and the rest keep
+ * serving requests. The sessions evicted meanwhile aren't saved
+ * @return  {@link operation_result} with the result of the operation
+ */
+static operation_result save_checkpoint(jvm_server *server) {
+	char **names;
+	uint32_t count;
+	operation_result result = list_sessions(server, &names, &count);
+	jvm_snapshot_writer writer;
+	if (result == OPERATION_SUCCESS) {
+		result = jvm_snapshot_writer_open(&writer, server->options.checkpoint,
+										  count);
+	}
+	if (result == OPERATION_SUCCESS) {
+		for (uint32_t i = 0; i < count && result == OPERATION_SUCCESS; i++) {
+			jvm_session *session = pin_for_checkpoint(server, names[i]);
+			if (session) {
+				result = jvm_snapshot_writer_add(&writer, session);
+				release_session(server, session);
+			}
+		}
+		// A failed snapshot is committed too, only to discard it
+		operation_result committed = jvm_snapshot_writer_commit(&writer);
+		result = (result == OPERATION_SUCCESS) ? committed : result;
+	}
+	for (uint32_t i = 0; names && i < count; i++) {
+		free(names[i]);
+	}
+	free(names);
+	return result;
+}
+
+/**
+ * Static function that serves the connections of the clients through a TCP or
+ * unix domain socket, keeping the sessions among them
+ * @return  {@link operation_result} with the result of the operation
+ */
+static operation_result serve_sockets(jvm_server *server) {
+	socket_t my_socket;
+	socket_t remote_connection_socket;
+
+	if (jvm_session_table_create(&server->_sessions,
+								 server->options.session_ttl,
+								 server->options.session_memory) !=
 		OPERATION_SUCCESS) {
-		socket_close(&my_socket);
-		socket_close(&remote_connection_socket);
-		return OPERATION_FAILURE_CONNECTION_FAILED;
+		return OPERATION_FAILURE_NO_MEMORY;
 	}
+	if (server->options.checkpoint) {
+		operation_result restored = jvm_snapshot_load(
+				&server->_sessions, server->options.checkpoint);
+		if (restored != OPERATION_SUCCESS) {
+			jvm_session_table_destroy(&server->_sessions);
+			return restored;
+		}
+	}
+	publish_sessions(&server->_sessions);
+	time_t last_checkpoint = time(NULL);
 
-	// Creates the stack
-	stack s;
-	stack_create(&s, sizeof(int));
+	// Falls back to the classic backend if the kernel doesn't support io_uring
+	bool concurrent = server->options.workers > 0;
+	socket_select_backend(server->options.backend);
 
-	//Receive the byte_codes in chunks and process them
-	if (receive_and_process_byte_codes(&remote_connection_socket, &vec, &s,
-									   CHUNK_SIZE) != OPERATION_SUCCESS) {
-		socket_close(&my_socket);
-		socket_close(&remote_connection_socket);
-		int_vector_destroy(&vec);
-		stack_destroy(&s);
+	// Configure the socket to be a listener in the given port (or path)
+	bool is_unix = server->options.transport == JVM_TRANSPORT_UNIX;
+	if ((is_unix ? socket_bind_unix(&my_socket, server->port)
+				 : socket_bind_and_address(&my_socket, server->port,
+										   server->options.processes > 0)) ==
+		SOCKET_CONNECTION_ERROR) {
+		socket_release_backend();
+		jvm_session_table_destroy(&server->_sessions);
 		return OPERATION_FAILURE_CONNECTION_FAILED;
 	}
 
-	// Destroys the stack
-	stack_destroy(&s);
+	jvm_scheduler scheduler;
+	if (concurrent) {
+		if (jvm_scheduler_create(&scheduler, server->options.workers,
+								 (uint64_t) server->options.quantum,
+								 server->options.engine,
+								 server->options.max_queue) !=
+			OPERATION_SUCCESS) {
+			socket_close(&my_socket);
+			socket_release_backend();
+			jvm_session_table_destroy(&server->_sessions);
+			return OPERATION_FAILURE_NO_MEMORY;
+		}
+		server->_scheduler = &scheduler;
+	}
+	pthread_mutex_init(&server->_sessions_lock, NULL);
+	pthread_cond_init(&server->_sessions_idle, NULL);
+	pthread_mutex_init(&server->_live_lock, NULL);
+	pthread_cond_init(&server->_live_idle, NULL);
+	server->_live_connections = 0;
 
-	// Print the stored variables in stdout
-	printf("%s\n", VARIABLES_OUTPUT_TITLE);
-	int_vector_print_elements(&vec, stdout);
+	// The listener failing stops the server, while a connection failing only
+	// makes it finish with the first of those failures
+	operation_result result = OPERATION_SUCCESS;
+	operation_result connection_failure = OPERATION_SUCCESS;
+	int connections = server->options.connections;
+	for (int served = 0; connections == 0 || served < connections; served++) {
+		// Wait and accept for an incoming connection
+		if (socket_accept(&my_socket, &remote_connection_socket) ==
+			SOCKET_CONNECTION_ERROR) {
+			result = OPERATION_FAILURE_CONNECTION_FAILED;
+			break;
+		}
 
-	// Send the variables through the socket
-	operation_result result = send_variables(&remote_connection_socket, &vec);
+		operation_result served_result = concurrent
+				? spawn_connection(server, &remote_connection_socket, served)
+				: handle_connection(server, &remote_connection_socket, served);
+		if (connection_failure == OPERATION_SUCCESS) {
+			connection_failure = served_result;
+		}
 
-	// Destroys the int_vector
-	int_vector_destroy(&vec);
+		long interval = server->options.checkpoint_interval;
+		if (server->options.checkpoint && interval > 0 &&
+			time(NULL) - last_checkpoint >= interval) {
+			save_checkpoint(server);
+			last_checkpoint = time(NULL);
+		}
+	}
 
-	// Closes the original and the peer socket entirely
+	// Waits for the connections still being served
+	pthread_mutex_lock(&server->_live_lock);
+	while (server->_live_connections > 0) {
+		pthread_cond_wait(&server->_live_idle, &server->_live_lock);
+	}
+	pthread_mutex_unlock(&server->_live_lock);
+	if (concurrent) {
+		jvm_scheduler_destroy(&scheduler);
+		server->_scheduler = NULL;
+	}
+
+	// Closes the original socket entirely
 	socket_close(&my_socket);
-	socket_close(&remote_connection_socket);
+	socket_release_backend();
+	if (is_unix) {
+		unlink(server->port);
+	}
+	if (result == OPERATION_SUCCESS) {
+		result = connection_failure;
+	}
+	if (server->options.checkpoint &&
+		save_checkpoint(server) != OPERATION_SUCCESS &&
+		result == OPERATION_SUCCESS) {
+		result = OPERATION_FAILURE_CONNECTION_FAILED;
+	}
+	jvm_session_table_destroy(&server->_sessions);
+	pthread_cond_destroy(&server->_live_idle);
+	pthread_mutex_destroy(&server->_live_lock);
+	pthread_cond_destroy(&server->_sessions_idle);
+	pthread_mutex_destroy(&server->_sessions_lock);
 
 	return result;
 }
+
+/**
+ * Static function that serves the clients of the {@param server} in the
+ * calling process, through the configured transport
+ * @return  {@link operation_result} with the result of the operation
+ */
+static operation_result serve(jvm_server *server) {
+	jvm_trace_log trace;
+	server->_trace = NULL;
+	if (server->options.trace_log) {
+		operation_result opened = jvm_trace_log_open(
+				&trace, server->options.trace_log, server->options.trace_sample);
+		if (opened != OPERATION_SUCCESS) {
+			return opened;
+		}
+		server->_trace = &trace;
+	}
+	jvm_capture capture;
+	operation_result result = OPERATION_SUCCESS;
+	if (server->options.capture) {
+		result = jvm_capture_create(&capture, server->options.capture);
+		server->_capture = (result == OPERATION_SUCCESS) ? &capture : NULL;
+	}
+	jvm_metrics_listener metrics;
+	if (result == OPERATION_SUCCESS && server->options.metrics &&
+		jvm_metrics_listen(&metrics, server->options.metrics) !=
+		OPERATION_SUCCESS) {
+		result = OPERATION_FAILURE_CONNECTION_FAILED;
+	} else if (result == OPERATION_SUCCESS) {
+		result = (server->options.transport == JVM_TRANSPORT_SHM)
+				 ? serve_shared_memory(server)
+				 : serve_sockets(server);
+		if (server->options.metrics) {
+			jvm_metrics_stop(&metrics);
+		}
+	}
+	if (server->_capture) {
+		jvm_capture_close(&capture);
+		server->_capture = NULL;
+	}
+	if (server->_trace) {
+		jvm_trace_log_close(&trace);
+		server->_trace = NULL;
+	}
+	return result;
+}
+
+// Workers of the supervisor, read by its signal handler
+static pid_t *supervised = NULL;
+static int supervised_count = 0;
+static volatile sig_atomic_t supervisor_stopping = 0;
+
+/**
+ * Static function that handles the signals that finish the supervisor: the
+ * workers are finished and won't be restarted
+ */
+static void stop_workers(int signal_number) {
+	supervisor_stopping = 1;
+	for (int i = 0; i < supervised_count; i++) {
+		if (supervised[i] > 0) {
+			kill(supervised[i], signal_number);
+		}
+	}
+}
+
+/**
+ * Static function that forks the worker process {@param index} of the
+ * supervisor, which serves the clients of the {@param server} until it
+ * finishes its connections and exits with the result
+ * @return  {@link operation_result} with the result of the operation
+ */
+static operation_result start_worker(jvm_server *server, int index) {
+	// The buffered output isn't duplicated in the worker
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid == -1) {
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
+	if (pid == 0) {
+		signal(SIGTERM, SIG_DFL);
+		signal(SIGINT, SIG_DFL);
+		operation_result result = serve(server);
+		fflush(stdout);
+		_exit((int) result);
+	}
+	supervised[index] = pid;
+	return OPERATION_SUCCESS;
+}
+
+/**
+ * Static function that supervises the worker processes of the {@param
+ * server}. A worker killed by a signal (it crashed) is started again, unless
+ * the supervisor itself is being finished by SIGTERM or SIGINT, which are
+ * forwarded to the workers. The supervisor finishes once every worker exits
+ * @return  {@link operation_result} with the result of the operation: the
+ *          first failure of a worker, if any
+ */
+static operation_result supervise(jvm_server *server) {
+	int processes = server->options.processes;
+	supervised = (pid_t *) calloc((size_t) processes, sizeof(pid_t));
+	time_t *started = (time_t *) calloc((size_t) processes, sizeof(time_t));
+	if (!supervised || !started) {
+		free(supervised);
+		free(started);
+		supervised = NULL;
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
+	supervised_count = processes;
+	supervisor_stopping = 0;
+	struct sigaction action;
+	memset(&action, 0, sizeof(struct sigaction));
+	action.sa_handler = stop_workers;
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGTERM, &action, NULL);
+	sigaction(SIGINT, &action, NULL);
+
+	operation_result result = OPERATION_SUCCESS;
+	int alive = 0;
+	for (int i = 0; i < processes && result == OPERATION_SUCCESS; i++) {
+		result = start_worker(server, i);
+		started[i] = time(NULL);
+		alive += result == OPERATION_SUCCESS;
+	}
+	if (result != OPERATION_SUCCESS) {
+		stop_workers(SIGTERM);
+	}
+
+	while (alive > 0) {
+		int status;
+		pid_t pid = waitpid(-1, &status, 0);
+		if (pid == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+		int i = 0;
+		while (i < processes && supervised[i] != pid) {
+			i++;
+		}
+		if (i == processes) {
+			continue;
+		}
+		supervised[i] = 0;
+		alive--;
+		if (WIFSIGNALED(status) && !supervisor_stopping) {
+			fprintf(stderr, "Worker %d killed by signal %d, restarting it\n",
+					(int) pid, WTERMSIG(status));
+			// A worker crashing as soon as it starts isn't restarted in a loop
+			if (time(NULL) - started[i] < 1) {
+				sleep(1);
+			}
+			if (start_worker(server, i) == OPERATION_SUCCESS) {
+				started[i] = time(NULL);
+				alive++;
+			}
+		} else if (WIFEXITED(status) && WEXITSTATUS(status) != 0 &&
+				   result == OPERATION_SUCCESS) {
+			result = (operation_result) WEXITSTATUS(status);
+		}
+	}
+
+	signal(SIGTERM, SIG_DFL);
+	signal(SIGINT, SIG_DFL);
+	supervised_count = 0;
+	free(supervised);
+	supervised = NULL;
+	free(started);
+	return result;
+}
+
+operation_result jvm_server_start(jvm_server *server) {
+	if (server->options.processes > 0) {
+		return supervise(server);
+	}
+	return serve(server);
+}
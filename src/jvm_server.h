@@ -2,22 +2,148 @@
 #define __SERVER_H__
 
 #include "result.h"
+#include <stddef.h>
+
+#include "socket.h"
+#include "jvm_protocol.h"
+#include "jvm_session.h"
+#include "jvm_trace.h"
+#include "jvm_scheduler.h"
+#include "jvm_capture.h"
+#include "jvm_dataflow.h"
+
+#define JVM_SERVER_DEFAULT_SESSION_TTL 300
+#define JVM_SERVER_DEFAULT_SESSION_MEMORY (256 * 1024 * 1024)
+#define JVM_SERVER_DEFAULT_MAX_PROGRAM (64 * 1024 * 1024)
+#define JVM_SERVER_MAX_WEIGHTS 16
+#define JVM_SERVER_MAX_WEIGHT 1000
+
+/**
+ * Optional settings of the server:
+ *          - backend: socket backend used for the accepted connections
+ *            (only the classic one with workers)
+ *          - connections: quantity of connections to serve before finishing
+ *            (0 serves forever)
+ *          - transport: {@link jvm_transport} where the clients are listened.
+ *            The port is used as the path or name for the co-located ones
+ *          - shm_size: bytes of the shared memory region
+ *          - session_ttl: seconds after which an unused session is evicted
+ *            (0 keeps them until the memory is needed)
+ *          - session_memory: bytes that the variables of all the sessions
+ *            can take, the least recently used ones are evicted beyond it
+ *          - checkpoint: path of the snapshot from which the sessions are
+ *            restored when starting and where they are saved when finishing,
+ *            or NULL to keep them only in memory
+ *          - checkpoint_interval: seconds after which the sessions are saved
+ *            again once a connection finishes (0 saves them only at the end)
+ *          - metrics: port (or path of the unix domain socket, if it has a
+ *            '/') where the metrics are scraped, or NULL to not listen
+ *          - trace_log: path of the file where the timing of the phases of
+ *            each request is appended as a JSON line, or NULL to not log them
+ *          - trace_sample: fraction of the requests logged, between 0 and 1
+ *          - workers: threads that run the programs of all the connections,
+ *            which are served concurrently, in slices of quantum byte_codes
+ *            (0 serves the connections one at a time, as they come)
+ *          - quantum: byte_codes run by a program before yielding its worker
+ *          - weights: list of session=weight separated by commas, where a
+ *            session of weight W runs W quanta per turn (1 if not listed)
+ *          - max_connections: connections served at once with workers, the
+ *            ones beyond it are closed as soon as accepted (0 doesn't bound)
+ *          - max_queue: programs admitted at once by the workers, running or
+ *            waiting, the ones beyond it are rejected as busy (0 doesn't bound)
+ *          - max_request_bytes: maximum cost of a request, the bytes of its
+ *            program and its variables (also the ones of a session), beyond
+ *            which it's rejected before being stored (0 only bounds the programs
+ *            stored whole to {@link JVM_SERVER_DEFAULT_MAX_PROGRAM} bytes)
+ *          - max_instructions: byte_codes after which a request is stopped
+ *            and rejected (0 doesn't bound them)
+ *          - processes: worker processes forked by a supervisor, which bind
+ *            the same TCP port and share nothing, each one serving the
+ *            configured connections (0 serves in the calling process)
+ *          - capture: path of the file where every request executed is
+ *            recorded to be replayed later, or NULL to not record them
+ *          - engine: {@link jvm_engine_kind} of the programs received whole.
+ *            With workers, only the ones that fit in a quantum are translated
+ *          - parallel: threads among which the independent chains of a
+ *            program of at least {@link JVM_DATAFLOW_MIN_LENGTH} bytes
+ *            received whole are run (0 or 1 runs every program sequentially)
+ */
+typedef struct jvm_server_options {
+	socket_backend backend;
+	int connections;
+	jvm_transport transport;
+	size_t shm_size;
+	long session_ttl;
+	size_t session_memory;
+	const char *checkpoint;
+	long checkpoint_interval;
+	const char *metrics;
+	const char *trace_log;
+	double trace_sample;
+	int workers;
+	long quantum;
+	const char *weights;
+	int max_connections;
+	int max_queue;
+	size_t max_request_bytes;
+	long max_instructions;
+	int processes;
+	const char *capture;
+	jvm_engine_kind engine;
+	int parallel;
+} jvm_server_options;
+
+/**
+ * Weight of a session, whose name is the first {@param length} characters of
+ * {@param session}
+ */
+typedef struct jvm_server_weight {
+	const char *session;
+	size_t length;
+	unsigned weight;
+} jvm_server_weight;
 
 typedef struct jvm_server {
 	const char* port;
+	jvm_server_options options;
+	jvm_session_table _sessions;
+	pthread_mutex_t _sessions_lock;
+	pthread_cond_t _sessions_idle;
+	jvm_trace_log *_trace;
+	jvm_capture *_capture;
+	jvm_scheduler *_scheduler;
+	jvm_server_weight _weights[JVM_SERVER_MAX_WEIGHTS];
+	int _weights_count;
+	int _live_connections;
+	pthread_mutex_t _live_lock;
+	pthread_cond_t _live_idle;
 } jvm_server;
 
 /**
- * Initializes the {@param server} with the {@param port} received as parameters.
+ * Initializes the {@param options} with the default values: classic backend, a
+ * single connection served, TCP transport and sessions evicted after {@link
+ * JVM_SERVER_DEFAULT_SESSION_TTL} seconds or beyond {@link
+ * JVM_SERVER_DEFAULT_SESSION_MEMORY} bytes, without checkpoints, metrics nor trace log,
+ * serving the connections one at a time
+ * @pre     {@param options} pointer to jvm_server_options already allocated
+ */
+void jvm_server_options_default(jvm_server_options *options);
+
+/**
+ * Initializes the {@param server} with the {@param port} and {@param options} received as parameters.
  * @pre     {@param server} pointer to jvm_server already allocated
  * @post    {@param server} pointer to jvm_server ready to be used
  * @return  {@link operation_result} with the result of the operation
  */
-operation_result jvm_server_config(const char* port, jvm_server *server);
+operation_result jvm_server_config(const char* port,
+								   const jvm_server_options *options,
+								   jvm_server *server);
 
 /**
  * Starts the {@param server} in the port already configured:
- *          - The server will wait for a client to connect in the port.
+ *          - The server will wait for a client to connect in the port. Once the
+ *            connection finishes, it will keep accepting new ones until the
+ *            configured quantity of connections is served
  *          - The server will receive a message through the socket with the following information:
  *                  - {@link jvm_utils.h#VARS_INTEGER_BITS} big endian bytes representing a signed int containing the quantity of variables to store in memory
  *                  - Further bytes representing byte_codes to be executed by the server
@@ -27,6 +153,8 @@ operation_result jvm_server_config(const char* port, jvm_server *server);
  *          - The server will print the variables stored in memory in stdout in hex with 8 digits
  *          - The server will send a message through the socket with the variables, each one of them as {@link jvm_utils.h#VARS_INTEGER_BITS} big endian bytes representing signed int
  *          - The server will close the socket for both reading and writing
+ * With processes, a supervisor forks the workers that do all of the above and
+ * restarts the ones that crash, until all of them finish
  * @pre     {@param server} pointer to server already configured
  * @return
  */
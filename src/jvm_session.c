@@ -0,0 +1,321 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "jvm_session.h"
+
+#define SESSION_BUCKETS 1024
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+static size_t bucket_of(const char *name) {
+	// djb2
+	size_t hash = 5381;
+	for (const unsigned char *c = (const unsigned char *) name; *c; c++) {
+		hash = hash * 33 + *c;
+	}
+	return hash % SESSION_BUCKETS;
+}
+
+static size_t memory_of(int32_t var_size) {
+	return (size_t) var_size * sizeof(int);
+}
+
+/**
+ * Static function that returns the memory taken by the {@param variables}
+ * and the {@param operands} of a session
+ */
+static size_t session_memory(const int_vector *variables,
+							 const stack *operands) {
+	return memory_of(int_vector_size(variables)) + stack_memory(operands);
+}
+
+/**
+ * Static function that unlinks the {@param session} from the recency list
+ */
+static void unlink_recency(jvm_session_table *self, jvm_session *session) {
+	if (session->_newer) {
+		session->_newer->_older = session->_older;
+	} else {
+		self->_newest = session->_older;
+	}
+	if (session->_older) {
+		session->_older->_newer = session->_newer;
+	} else {
+		self->_oldest = session->_newer;
+	}
+	session->_newer = NULL;
+	session->_older = NULL;
+}
+
+/**
+ * Static function that links the {@param session}, not in the recency list, as
+ * the most recently used one
+ */
+static void push_newest(jvm_session_table *self, jvm_session *session) {
+	session->_older = self->_newest;
+	if (self->_newest) {
+		self->_newest->_newer = session;
+	}
+	self->_newest = session;
+	if (!self->_oldest) {
+		self->_oldest = session;
+	}
+	session->_last_used = now();
+}
+
+/**
+ * Static function that makes the {@param session} the most recently used one
+ */
+static void touch(jvm_session_table *self, jvm_session *session) {
+	unlink_recency(self, session);
+	push_newest(self, session);
+}
+
+/**
+ * Static function that removes the {@param session} from the table and
+ * releases it
+ */
+static void evict(jvm_session_table *self, jvm_session *session) {
+	jvm_session **link = &self->_buckets[bucket_of(session->name)];
+	while (*link != session) {
+		link = &(*link)->_bucket_next;
+	}
+	*link = session->_bucket_next;
+	unlink_recency(self, session);
+	self->_memory -= session->_memory;
+	self->_count--;
+	int_vector_destroy(&session->variables);
+	stack_destroy(&session->operands);
+	free(session->name);
+	free(session);
+}
+
+/**
+ * Static function that evicts the sessions not used within the ttl. The
+ * oldest sessions are at the end of the recency list
+ */
+static void expire(jvm_session_table *self) {
+	if (self->_ttl == 0) {
+		return;
+	}
+	double deadline = now() - (double) self->_ttl;
+	jvm_session *s = self->_oldest;
+	while (s && s->_last_used < deadline) {
+		jvm_session *newer = s->_newer;
+		if (s->_pins == 0) {
+			evict(self, s);
+			self->_evictions++;
+		}
+		s = newer;
+	}
+}
+
+operation_result jvm_session_table_create(jvm_session_table *self, long ttl,
+										  size_t memory_cap) {
+	if (!self)
+		return OPERATION_FAILURE_NULL_POINTER;
+	if (ttl < 0)
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	self->_buckets = (jvm_session **) calloc(SESSION_BUCKETS,
+											 sizeof(jvm_session *));
+	if (!self->_buckets)
+		return OPERATION_FAILURE_NO_MEMORY;
+	self->_ttl = ttl;
+	self->_memory = 0;
+	self->_memory_cap = memory_cap;
+	self->_count = 0;
+	self->_hits = 0;
+	self->_misses = 0;
+	self->_evictions = 0;
+	self->_newest = NULL;
+	self->_oldest = NULL;
+	return OPERATION_SUCCESS;
+}
+
+/**
+ * Static function that evicts the least recently used sessions, but the
+ * pinned ones and {@param spared}, until {@param memory} more bytes fit
+ * within the memory cap
+ * @return whether they fit
+ */
+static bool make_room(jvm_session_table *self, size_t memory,
+					  const jvm_session *spared) {
+	jvm_session *victim = self->_oldest;
+	while (self->_memory + memory > self->_memory_cap) {
+		while (victim && (victim->_pins > 0 || victim == spared)) {
+			victim = victim->_newer;
+		}
+		if (!victim) {
+			// The rest of the memory is taken by sessions in use
+			return false;
+		}
+		jvm_session *newer = victim->_newer;
+		evict(self, victim);
+		self->_evictions++;
+		victim = newer;
+	}
+	return true;
+}
+
+/**
+ * Static function that inserts the session named {@param name} with the
+ * {@param variables} and {@param operands} already created, evicting the least
+ * recently used sessions until it fits within the memory cap
+ */
+static operation_result
+insert_session(jvm_session_table *self, const char *name,
+			   const int_vector *variables, const stack *operands,
+			   jvm_session **session) {
+	size_t memory = session_memory(variables, operands);
+	if (memory > self->_memory_cap)
+		return OPERATION_FAILURE_NO_MEMORY;
+	jvm_session *s = (jvm_session *) calloc(1, sizeof(jvm_session));
+	size_t name_length = strlen(name);
+	if (!s || !(s->name = (char *) malloc(name_length + 1))) {
+		free(s);
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
+	if (!make_room(self, memory, NULL)) {
+		free(s->name);
+		free(s);
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
+
+	memcpy(s->name, name, name_length + 1);
+	s->variables = *variables;
+	s->operands = *operands;
+	s->_memory = memory;
+	size_t bucket = bucket_of(name);
+	s->_bucket_next = self->_buckets[bucket];
+	self->_buckets[bucket] = s;
+	self->_memory += memory;
+	self->_count++;
+	push_newest(self, s);
+	*session = s;
+	return OPERATION_SUCCESS;
+}
+
+/**
+ * Static function that finds the session named {@param name}
+ * @return the session or NULL if there's none
+ */
+static jvm_session *find(const jvm_session_table *self, const char *name) {
+	for (jvm_session *s = self->_buckets[bucket_of(name)]; s;
+		 s = s->_bucket_next) {
+		if (strcmp(s->name, name) == 0) {
+			return s;
+		}
+	}
+	return NULL;
+}
+
+operation_result
+jvm_session_table_acquire(jvm_session_table *self, const char *name,
+						  int32_t var_size, jvm_session **session) {
+	if (!self || !name || !session)
+		return OPERATION_FAILURE_NULL_POINTER;
+	if (var_size < 0)
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	expire(self);
+
+	jvm_session *s = find(self, name);
+	if (s) {
+		if (int_vector_size(&s->variables) != var_size)
+			return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		touch(self, s);
+		self->_hits++;
+		*session = s;
+		return OPERATION_SUCCESS;
+	}
+
+	self->_misses++;
+	if (memory_of(var_size) > self->_memory_cap)
+		return OPERATION_FAILURE_NO_MEMORY;
+	int_vector variables;
+	stack operands;
+	if (int_vector_create(&variables, var_size) != OPERATION_SUCCESS)
+		return OPERATION_FAILURE_NO_MEMORY;
+	if (stack_create(&operands, sizeof(int)) != OPERATION_SUCCESS) {
+		int_vector_destroy(&variables);
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
+	operation_result result = insert_session(self, name, &variables, &operands,
+											 session);
+	if (result != OPERATION_SUCCESS) {
+		stack_destroy(&operands);
+		int_vector_destroy(&variables);
+	}
+	return result;
+}
+
+operation_result
+jvm_session_table_restore(jvm_session_table *self, const char *name,
+						  int_vector *variables, stack *operands) {
+	if (!self || !name || !variables || !operands)
+		return OPERATION_FAILURE_NULL_POINTER;
+	if (find(self, name))
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	jvm_session *session;
+	return insert_session(self, name, variables, operands, &session);
+}
+
+void jvm_session_pin(jvm_session_table *self, jvm_session *session) {
+	session->_pins++;
+}
+
+void jvm_session_unpin(jvm_session_table *self, jvm_session *session) {
+	if (--session->_pins == 0) {
+		// The programs changed the operands left in the stack
+		stack_trim(&session->operands);
+		self->_memory -= session->_memory;
+		session->_memory = session_memory(&session->variables,
+										  &session->operands);
+		// Beyond the cap with nothing else to evict, the session is kept
+		make_room(self, session->_memory, session);
+		self->_memory += session->_memory;
+	}
+}
+
+bool jvm_session_pinned(const jvm_session *session) {
+	return session->_pins > 0;
+}
+
+int jvm_session_pins(const jvm_session *session) {
+	return session->_pins;
+}
+
+jvm_session *jvm_session_table_find(jvm_session_table *self,
+									const char *name) {
+	return find(self, name);
+}
+
+void jvm_session_table_stats(const jvm_session_table *self,
+							 jvm_session_stats *stats) {
+	stats->sessions = self->_count;
+	stats->memory = self->_memory;
+	stats->hits = self->_hits;
+	stats->misses = self->_misses;
+	stats->evictions = self->_evictions;
+}
+
+const jvm_session *jvm_session_table_oldest(const jvm_session_table *self) {
+	return self->_oldest;
+}
+
+const jvm_session *jvm_session_newer(const jvm_session *session) {
+	return session->_newer;
+}
+
+void jvm_session_table_destroy(jvm_session_table *self) {
+	while (self->_oldest) {
+		evict(self, self->_oldest);
+	}
+	free(self->_buckets);
+}
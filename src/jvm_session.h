@@ -0,0 +1,155 @@
+#ifndef __JVM_SESSION_H__
+#define __JVM_SESSION_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "result.h"
+#include "int_vector.h"
+#include "stack.h"
+
+/**
+ * Named state kept by the server between framed requests: the variables and
+ * the operands left in the stack by the programs executed within it. Its
+ * memory counts both, the operands by the pages they keep
+ */
+typedef struct jvm_session {
+	char *name;
+	int_vector variables;
+	stack operands;
+	int _pins;
+	size_t _memory;
+	double _last_used;
+	struct jvm_session *_bucket_next;
+	struct jvm_session *_newer;
+	struct jvm_session *_older;
+} jvm_session;
+
+/**
+ * Sessions of the server indexed by their name. The ones not used within the
+ * ttl are evicted and, when creating one exceeds the memory cap, the least
+ * recently used ones are evicted first. Pinned sessions, being used by a
+ * request, are never evicted. The table isn't thread safe, its user must
+ * serialize the calls
+ */
+typedef struct jvm_session_table {
+	jvm_session **_buckets;
+	long _ttl;
+	size_t _memory;
+	size_t _memory_cap;
+	long _count;
+	long _hits;
+	long _misses;
+	long _evictions;
+	jvm_session *_newest;
+	jvm_session *_oldest;
+} jvm_session_table;
+
+/**
+ * Statistics of a session table:
+ *          - sessions: quantity of sessions kept
+ *          - memory: bytes taken by their variables and operands
+ *          - hits, misses: acquisitions that found the session or created it
+ *          - evictions: sessions evicted because they expired or to make room
+ */
+typedef struct jvm_session_stats {
+	long sessions;
+	size_t memory;
+	long hits;
+	long misses;
+	long evictions;
+} jvm_session_stats;
+
+/**
+ * Initializes the {@param self} with no sessions. Sessions not used within
+ * {@param ttl} seconds are evicted (never if it's 0), and the variables and
+ * operands of all of them take at most {@param memory_cap} bytes
+ * @pre     {@param self} pointer to jvm_session_table already allocated
+ * @return  {@link operation_result} with the result of the operation
+ */
+operation_result jvm_session_table_create(jvm_session_table *self, long ttl,
+										  size_t memory_cap);
+
+/**
+ * Finds the session named {@param name} or creates it with {@param var_size}
+ * variables, evicting the expired sessions first (but the pinned ones)
+ * @post    {@param session} points to the session, owned by the table
+ * @return  {@link operation_result} with the result of the operation: an
+ *          illegal argument if the session exists with another quantity of
+ *          variables, or no memory if it doesn't fit within the cap
+ */
+operation_result
+jvm_session_table_acquire(jvm_session_table *self, const char *name,
+						  int32_t var_size, jvm_session **session);
+
+/**
+ * Inserts in {@param self} the session named {@param name}, taking the
+ * ownership of the {@param variables} and {@param operands} already created
+ * (as when restoring a checkpoint). It becomes the most recently used session
+ * @return  {@link operation_result} with the result of the operation: an
+ *          illegal argument if the session already exists, or no memory if it
+ *          doesn't fit within the cap. The ownership isn't taken on failure
+ */
+operation_result
+jvm_session_table_restore(jvm_session_table *self, const char *name,
+						  int_vector *variables, stack *operands);
+
+/**
+ * Pins the {@param session} of {@param self}, so it isn't evicted while it's
+ * being used. Pins are counted, so each one must be undone
+ */
+void jvm_session_pin(jvm_session_table *self, jvm_session *session);
+
+/**
+ * Undoes a pin of the {@param session} of {@param self}. Once it's no longer
+ * pinned, the pages its operands don't need are released and its memory is
+ * counted again, evicting the least recently used sessions (but the pinned
+ * ones) if it grew beyond the cap
+ */
+void jvm_session_unpin(jvm_session_table *self, jvm_session *session);
+
+/**
+ * Returns whether the {@param session} is pinned
+ */
+bool jvm_session_pinned(const jvm_session *session);
+
+/**
+ * Returns the quantity of pins of the {@param session}
+ */
+int jvm_session_pins(const jvm_session *session);
+
+/**
+ * Finds the session named {@param name} in {@param self}, without using it
+ * nor evicting the expired ones
+ * @return the session or NULL if there's none
+ */
+jvm_session *jvm_session_table_find(jvm_session_table *self,
+									const char *name);
+
+/**
+ * Fills {@param stats} with the current statistics of {@param self}
+ */
+void jvm_session_table_stats(const jvm_session_table *self,
+							 jvm_session_stats *stats);
+
+/**
+ * Returns the least recently used session of {@param self}, from which every
+ * session is reached through {@link jvm_session_newer}
+ * @return the session or NULL if there are none
+ */
+const jvm_session *jvm_session_table_oldest(const jvm_session_table *self);
+
+/**
+ * Returns the session used right after {@param session}
+ * @return the session or NULL if {@param session} is the most recent one
+ */
+const jvm_session *jvm_session_newer(const jvm_session *session);
+
+/**
+ * Destroys the {@param self} and every session within it
+ * @post    The memory allocated is released
+ */
+void jvm_session_table_destroy(jvm_session_table *self);
+
+#endif //__JVM_SESSION_H__
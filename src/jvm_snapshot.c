@@ -0,0 +1,327 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "jvm_snapshot.h"
+#include "jvm_protocol.h"
+
+#define SNAPSHOT_MAGIC 0x4A564D43
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_TEMPORARY_SUFFIX ".tmp"
+#define SNAPSHOT_WORD_ALIGNMENT 8
+
+/**
+ * Header at the start of the snapshot, followed by an entry per session. The
+ * values are stored in the endianness of the host
+ *          - page_size: alignment of the variables, which are mapped
+ *          - size: bytes of the whole snapshot
+ */
+typedef struct snapshot_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t sessions;
+	uint32_t page_size;
+	uint64_t size;
+} snapshot_header;
+
+/**
+ * Entry describing a session: where its bitmap of touched pages, its operands
+ * (from the top to the bottom of the stack) and its variables are stored
+ */
+typedef struct snapshot_entry {
+	uint64_t variables_offset;
+	uint64_t bitmap_offset;
+	uint64_t operands_offset;
+	int32_t var_size;
+	uint32_t operands;
+	uint32_t name_length;
+	char name[PROTOCOL_MAX_SESSION_NAME + 1];
+} snapshot_entry;
+
+static uint64_t align(uint64_t offset, uint64_t alignment) {
+	return (offset + alignment - 1) / alignment * alignment;
+}
+
+/**
+ * Static function that writes the {@param size} bytes of {@param buffer} at
+ * {@param offset} of {@param fd}
+ */
+static bool write_at(int fd, const void *buffer, size_t size, uint64_t offset) {
+	const char *bytes = (const char *) buffer;
+	while (size > 0) {
+		ssize_t written = pwrite(fd, bytes, size, (off_t) offset);
+		if (written < 0 && errno == EINTR) {
+			continue;
+		} else if (written <= 0) {
+			return false;
+		}
+		bytes += written;
+		size -= (size_t) written;
+		offset += (uint64_t) written;
+	}
+	return true;
+}
+
+/**
+ * Static function that writes the sections of the {@param session} from
+ * {@param cursor}, describing them in {@param entry}
+ * @return the offset after the sections or 0 on error
+ */
+static uint64_t write_session(int fd, const jvm_session *session,
+							  uint64_t cursor, uint64_t page_size,
+							  snapshot_entry *entry) {
+	const int_vector *variables = &session->variables;
+	size_t words;
+	const uint64_t *touched = int_vector_touched(variables, &words);
+	entry->name_length = (uint32_t) strlen(session->name);
+	memcpy(entry->name, session->name, entry->name_length + 1);
+	entry->var_size = int_vector_size(variables);
+	entry->operands = (uint32_t) stack_size(&session->operands);
+
+	entry->bitmap_offset = align(cursor, SNAPSHOT_WORD_ALIGNMENT);
+	if (!write_at(fd, touched, words * sizeof(uint64_t), entry->bitmap_offset))
+		return 0;
+	cursor = entry->bitmap_offset + words * sizeof(uint64_t);
+
+	entry->operands_offset = cursor;
+	int *operands = (int *) malloc((entry->operands + 1) * sizeof(int));
+	if (!operands)
+		return 0;
+	stack_elements(&session->operands, operands);
+	bool written = write_at(fd, operands, entry->operands * sizeof(int),
+							cursor);
+	free(operands);
+	if (!written)
+		return 0;
+	cursor += entry->operands * sizeof(int);
+
+	// Only the touched pages are written, the rest of them are left as holes
+	entry->variables_offset = align(cursor, page_size);
+	const int *data = int_vector_data(variables);
+	for (int from = 0; from < entry->var_size;) {
+		bool is_touched;
+		int to = int_vector_run(variables, from, &is_touched);
+		if (is_touched &&
+			!write_at(fd, &data[from], (size_t) (to - from) * sizeof(int),
+					  entry->variables_offset + (uint64_t) from * sizeof(int)))
+			return 0;
+		from = to;
+	}
+	return entry->variables_offset + (uint64_t) entry->var_size * sizeof(int);
+}
+
+/**
+ * Static function that flushes the directory holding {@param path}, so the
+ * rename of the snapshot over it survives a crash
+ * @return whether it was flushed
+ */
+static bool sync_directory(const char *path) {
+	const char *slash = strrchr(path, '/');
+	char *directory = (char *) malloc(slash ? (size_t) (slash - path) + 2
+											 : sizeof("."));
+	if (!directory) {
+		return false;
+	}
+	if (!slash) {
+		snprintf(directory, sizeof("."), ".");
+	} else {
+		// The root keeps its slash
+		size_t length = (slash == path) ? 1 : (size_t) (slash - path);
+		memcpy(directory, path, length);
+		directory[length] = '\0';
+	}
+	int fd = open(directory, O_RDONLY | O_DIRECTORY);
+	free(directory);
+	if (fd == -1) {
+		return false;
+	}
+	bool synced = fsync(fd) == 0;
+	return (close(fd) == 0) && synced;
+}
+
+operation_result jvm_snapshot_writer_open(jvm_snapshot_writer *self,
+										  const char *path,
+										  uint32_t capacity) {
+	if (!self || !path)
+		return OPERATION_FAILURE_NULL_POINTER;
+	self->_entries = (snapshot_entry *) calloc((size_t) capacity + 1,
+											   sizeof(snapshot_entry));
+	self->_temporary = (char *) malloc(strlen(path) +
+									   sizeof(SNAPSHOT_TEMPORARY_SUFFIX));
+	if (!self->_entries || !self->_temporary) {
+		free(self->_entries);
+		free(self->_temporary);
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
+	snprintf(self->_temporary,
+			 strlen(path) + sizeof(SNAPSHOT_TEMPORARY_SUFFIX), "%s%s", path,
+			 SNAPSHOT_TEMPORARY_SUFFIX);
+	self->_path = path;
+	self->_capacity = capacity;
+	self->_count = 0;
+	self->_page_size = (uint64_t) sysconf(_SC_PAGESIZE);
+	// The entries are written last, in the room left for them after the header
+	self->_cursor = sizeof(snapshot_header) +
+					capacity * sizeof(snapshot_entry);
+	self->_fd = open(self->_temporary, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	return OPERATION_SUCCESS;
+}
+
+operation_result jvm_snapshot_writer_add(jvm_snapshot_writer *self,
+										 const jvm_session *session) {
+	if (!self || !session)
+		return OPERATION_FAILURE_NULL_POINTER;
+	if (self->_count == self->_capacity)
+		return OPERATION_FAILURE_OUT_OF_BOUNDS;
+	if (self->_fd != -1 && self->_cursor) {
+		self->_cursor = write_session(self->_fd, session, self->_cursor,
+									  self->_page_size,
+									  &self->_entries[self->_count]);
+	}
+	if (self->_fd == -1 || !self->_cursor)
+		return OPERATION_FAILURE_CONNECTION_FAILED;
+	self->_count++;
+	return OPERATION_SUCCESS;
+}
+
+operation_result jvm_snapshot_writer_commit(jvm_snapshot_writer *self) {
+	if (!self)
+		return OPERATION_FAILURE_NULL_POINTER;
+	snapshot_header header = {SNAPSHOT_MAGIC, SNAPSHOT_VERSION, self->_count,
+							  (uint32_t) self->_page_size, self->_cursor};
+	int fd = self->_fd;
+	bool saved = fd != -1 && self->_cursor &&
+				 write_at(fd, &header, sizeof(header), 0) &&
+				 write_at(fd, self->_entries,
+						  self->_count * sizeof(snapshot_entry),
+						  sizeof(header)) &&
+				 ftruncate(fd, (off_t) self->_cursor) == 0 && fsync(fd) == 0;
+	if (fd != -1) {
+		saved = (close(fd) == 0) && saved;
+	}
+	bool renamed = saved && rename(self->_temporary, self->_path) == 0;
+	if (!renamed && fd != -1) {
+		unlink(self->_temporary);
+	}
+	saved = renamed && sync_directory(self->_path);
+	free(self->_entries);
+	free(self->_temporary);
+	return saved ? OPERATION_SUCCESS : OPERATION_FAILURE_CONNECTION_FAILED;
+}
+
+/**
+ * Static function that checks that the sections of {@param entry} are within
+ * the {@param size} bytes of the snapshot and that its operands fit in a stack
+ */
+static bool entry_is_valid(const snapshot_entry *entry, uint64_t size,
+						   uint64_t page_size) {
+	uint64_t pages = ((uint64_t) entry->var_size + INT_VECTOR_PAGE - 1) /
+					 INT_VECTOR_PAGE;
+	uint64_t words = (pages + 63) / 64;
+	return entry->var_size >= 0 &&
+		   entry->name_length > 0 &&
+		   entry->name_length <= PROTOCOL_MAX_SESSION_NAME &&
+		   entry->name[entry->name_length] == '\0' &&
+		   entry->bitmap_offset % SNAPSHOT_WORD_ALIGNMENT == 0 &&
+		   entry->bitmap_offset <= size &&
+		   words * sizeof(uint64_t) <= size - entry->bitmap_offset &&
+		   entry->operands_offset <= size &&
+		   entry->operands <= STACK_CAPACITY &&
+		   entry->operands * sizeof(int) <= size - entry->operands_offset &&
+		   entry->variables_offset % page_size == 0 &&
+		   entry->variables_offset <= size &&
+		   (uint64_t) entry->var_size * sizeof(int) <=
+		   size - entry->variables_offset;
+}
+
+/**
+ * Static function that restores the session described by {@param entry}. The
+ * operands are pushed from the bottom to the top of the stack
+ */
+static operation_result restore_session(jvm_session_table *sessions, int fd,
+										const char *snapshot,
+										const snapshot_entry *entry) {
+	int_vector variables;
+	stack operands;
+	if (int_vector_map_file(&variables, fd, (long) entry->variables_offset,
+							entry->var_size,
+							(const uint64_t *) &snapshot[entry->bitmap_offset])
+		!= OPERATION_SUCCESS)
+		return OPERATION_FAILURE_NO_MEMORY;
+	if (stack_create(&operands, sizeof(int)) != OPERATION_SUCCESS) {
+		int_vector_destroy(&variables);
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
+	operation_result result = OPERATION_SUCCESS;
+	for (uint32_t i = entry->operands; i > 0 && result == OPERATION_SUCCESS;
+		 i--) {
+		int operand;
+		memcpy(&operand, &snapshot[entry->operands_offset +
+								   (i - 1) * sizeof(int)], sizeof(int));
+		result = stack_push(&operands, &operand);
+	}
+	if (result == OPERATION_SUCCESS) {
+		result = jvm_session_table_restore(sessions, entry->name, &variables,
+										   &operands);
+	}
+	if (result != OPERATION_SUCCESS) {
+		stack_destroy(&operands);
+		int_vector_destroy(&variables);
+	}
+	return result;
+}
+
+operation_result jvm_snapshot_load(jvm_session_table *sessions,
+								   const char *path) {
+	if (!sessions || !path)
+		return OPERATION_FAILURE_NULL_POINTER;
+	int fd = open(path, O_RDONLY);
+	if (fd == -1) {
+		return (errno == ENOENT) ? OPERATION_SUCCESS
+								 : OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	}
+	struct stat st;
+	if (fstat(fd, &st) == -1 || st.st_size < (off_t) sizeof(snapshot_header)) {
+		close(fd);
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	}
+	// Only the header, the entries, the bitmaps and the operands are read
+	// through this mapping, the variables are mapped on their own
+	uint64_t size = (uint64_t) st.st_size;
+	char *snapshot = (char *) mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (snapshot == MAP_FAILED) {
+		close(fd);
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
+
+	snapshot_header header;
+	memcpy(&header, snapshot, sizeof(header));
+	uint64_t page_size = (uint64_t) sysconf(_SC_PAGESIZE);
+	operation_result result = OPERATION_SUCCESS;
+	if (header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION ||
+		header.page_size != page_size || header.size != size ||
+		header.sessions > (size - sizeof(header)) / sizeof(snapshot_entry)) {
+		result = OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	}
+	for (uint32_t i = 0; i < header.sessions && result == OPERATION_SUCCESS;
+		 i++) {
+		snapshot_entry entry;
+		memcpy(&entry, &snapshot[sizeof(header) + i * sizeof(entry)],
+			   sizeof(entry));
+		result = entry_is_valid(&entry, size, page_size)
+				 ? restore_session(sessions, fd, snapshot, &entry)
+				 : OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	}
+
+	munmap(snapshot, size);
+	close(fd);
+	return result;
+}
@@ -0,0 +1,70 @@
+#ifndef __JVM_SNAPSHOT_H__
+#define __JVM_SNAPSHOT_H__
+
+#include <stdint.h>
+
+#include "result.h"
+#include "jvm_session.h"
+
+struct snapshot_entry;
+
+/**
+ * Snapshot being written a session at a time, so each one can be copied on
+ * its own while the rest keep being used
+ */
+typedef struct jvm_snapshot_writer {
+	const char *_path;
+	char *_temporary;
+	int _fd;
+	struct snapshot_entry *_entries;
+	uint32_t _capacity;
+	uint32_t _count;
+	uint64_t _cursor;
+	uint64_t _page_size;
+} jvm_snapshot_writer;
+
+/**
+ * Function that starts writing the snapshot file {@param path} with room for
+ * up to {@param capacity} sessions. It's written aside until it's committed
+ * @pre    {@param path} lives until the snapshot is committed
+ * @post   {@param self} must be committed with {@link
+ *         jvm_snapshot_writer_commit}, even if adding a session failed
+ * @return {@link operation_result} with the result of the operation
+ */
+operation_result jvm_snapshot_writer_open(jvm_snapshot_writer *self,
+										  const char *path,
+										  uint32_t capacity);
+
+/**
+ * Function that writes the {@param session} (its variables and its operands)
+ * in the snapshot of {@param self}, as the most recently used so far. Only
+ * the pages of variables ever written take space in the file
+ * @pre    {@param session} doesn't change while it's written
+ * @return {@link operation_result} with the result of the operation: out of
+ *         bounds beyond the capacity of the snapshot
+ */
+operation_result jvm_snapshot_writer_add(jvm_snapshot_writer *self,
+										 const jvm_session *session);
+
+/**
+ * Function that finishes the snapshot of {@param self}: it's flushed and
+ * renamed over its path, and then its directory is flushed, so a failure or
+ * a crash never leaves it half written. A snapshot that failed to write a
+ * session is discarded instead
+ * @post   the memory of {@param self} is released
+ * @return {@link operation_result} with the result of the operation
+ */
+operation_result jvm_snapshot_writer_commit(jvm_snapshot_writer *self);
+
+/**
+ * Function that restores in {@param sessions} the sessions of the snapshot
+ * file {@param path}, in the same order of use. The variables are mapped from
+ * the file, so their pages are only read when the sessions access them
+ * @return {@link operation_result} with the result of the operation. A
+ *         missing snapshot restores nothing and succeeds, one with another
+ *         version or corrupted is an illegal argument
+ */
+operation_result jvm_snapshot_load(jvm_session_table *sessions,
+								   const char *path);
+
+#endif //__JVM_SNAPSHOT_H__
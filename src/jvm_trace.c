@@ -0,0 +1,129 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <string.h>
+#include <time.h>
+
+#include "jvm_trace.h"
+
+static double wall_clock(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+void jvm_span_begin(jvm_span *span, long connection, const char *protocol) {
+	memset(span, 0, sizeof(jvm_span));
+	span->connection = connection;
+	span->protocol = protocol;
+	span->status = OPERATION_SUCCESS;
+	span->_started = jvm_metrics_now();
+	span->_wall_clock = wall_clock();
+	span->_mark = span->_started;
+}
+
+void jvm_span_mark(jvm_span *span, jvm_phase phase) {
+	double now = jvm_metrics_now();
+	span->_phases[phase] += now - span->_mark;
+	span->_seen |= 1u << phase;
+	span->_mark = now;
+}
+
+double jvm_span_started(const jvm_span *span) {
+	return span->_started;
+}
+
+/**
+ * Static function that writes {@param value} as a JSON string, escaping the
+ * quotes, backslashes and control characters
+ */
+static void write_string(FILE *out, const char *value) {
+	fputc('"', out);
+	for (const unsigned char *c = (const unsigned char *) value; *c; c++) {
+		if (*c == '"' || *c == '\\') {
+			fprintf(out, "\\%c", *c);
+		} else if (*c < 0x20) {
+			fprintf(out, "\\u%04x", *c);
+		} else {
+			fputc(*c, out);
+		}
+	}
+	fputc('"', out);
+}
+
+/**
+ * Static function that writes the {@param span} as a single line JSON object,
+ * with its times in microseconds
+ */
+static void write_span(FILE *out, const jvm_span *span) {
+	fprintf(out, "{\"time\":%.6f,\"start\":%.6f,\"connection\":%ld,"
+				 "\"request\":%d,\"protocol\":",
+			span->_wall_clock, span->_started, span->connection,
+			(int) span->id);
+	write_string(out, span->protocol);
+	if (span->session) {
+		fprintf(out, ",\"session\":");
+		write_string(out, span->session);
+	}
+	fprintf(out, ",\"status\":%d,\"variables\":%d,\"program_bytes\":%ld,"
+				 "\"instructions\":%llu,\"phases_us\":{",
+			(int) span->status, (int) span->var_size, span->program_bytes,
+			(unsigned long long) span->instructions);
+	bool first = true;
+	for (int p = 0; p < JVM_PHASES; p++) {
+		if (span->_seen & (1u << p)) {
+			fprintf(out, "%s\"%s\":%.3f", first ? "" : ",",
+					jvm_metrics_phase_name((jvm_phase) p),
+					span->_phases[p] * 1e6);
+			first = false;
+		}
+	}
+	fprintf(out, "},\"total_us\":%.3f}\n",
+			(span->_mark - span->_started) * 1e6);
+}
+
+void jvm_span_end(jvm_span *span, jvm_trace_log *log) {
+	for (int p = 0; p < JVM_PHASES; p++) {
+		if (span->_seen & (1u << p)) {
+			jvm_metrics_observe((jvm_phase) p, span->_phases[p]);
+		}
+	}
+	jvm_metrics_add(JVM_COUNTER_REQUESTS, 1);
+	jvm_metrics_add(JVM_COUNTER_INSTRUCTIONS, span->instructions);
+	jvm_metrics_add(JVM_COUNTER_FAILED_REQUESTS,
+					span->status != OPERATION_SUCCESS);
+	if (!log) {
+		return;
+	}
+	pthread_mutex_lock(&log->_lock);
+	// Every span adds the rate and a whole credit writes one, so the sampled
+	// spans are evenly spread instead of randomly
+	log->_credit += log->_rate;
+	if (log->_credit >= 1) {
+		log->_credit -= 1;
+		write_span(log->_file, span);
+	}
+	pthread_mutex_unlock(&log->_lock);
+}
+
+operation_result jvm_trace_log_open(jvm_trace_log *self, const char *path,
+									double rate) {
+	if (!self || !path)
+		return OPERATION_FAILURE_NULL_POINTER;
+	if (!(rate >= 0 && rate <= 1))
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	self->_file = fopen(path, "a");
+	if (!self->_file)
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	// Each span is visible right away, the sampling keeps the writes few
+	setvbuf(self->_file, NULL, _IOLBF, BUFSIZ);
+	self->_rate = rate;
+	// Unless nothing is sampled, the first span is always written
+	self->_credit = (rate > 0) ? 1 - rate : 0;
+	pthread_mutex_init(&self->_lock, NULL);
+	return OPERATION_SUCCESS;
+}
+
+void jvm_trace_log_close(jvm_trace_log *self) {
+	fclose(self->_file);
+	pthread_mutex_destroy(&self->_lock);
+}
@@ -0,0 +1,88 @@
+#ifndef __JVM_TRACE_H__
+#define __JVM_TRACE_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "result.h"
+#include "jvm_metrics.h"
+
+/**
+ * Timing of a single request, split in its {@link jvm_phase}s with monotonic
+ * timestamps taken at each boundary:
+ *          - connection: sequence number of the connection of the request
+ *          - id: id of the framed request (0 for the other protocols)
+ *          - protocol: name of the protocol of the request
+ *          - session: name of the session or NULL
+ *          - var_size, program_bytes: size of the request
+ *          - instructions: byte_codes executed
+ *          - status: {@link operation_result} of the request
+ */
+typedef struct jvm_span {
+	long connection;
+	int32_t id;
+	const char *protocol;
+	const char *session;
+	int32_t var_size;
+	long program_bytes;
+	uint64_t instructions;
+	operation_result status;
+	double _started;
+	double _wall_clock;
+	double _mark;
+	double _phases[JVM_PHASES];
+	unsigned _seen;
+} jvm_span;
+
+/**
+ * Log where a sample of the spans is written, one JSON object per line
+ */
+typedef struct jvm_trace_log {
+	FILE *_file;
+	double _rate;
+	double _credit;
+	pthread_mutex_t _lock;
+} jvm_trace_log;
+
+/**
+ * Starts the {@param span} of a request of the {@param protocol} received
+ * through the {@param connection}, taking its first timestamp
+ */
+void jvm_span_begin(jvm_span *span, long connection, const char *protocol);
+
+/**
+ * Ends the current {@param phase} of the {@param span}: the time since the
+ * previous boundary is added to it (phases may be entered more than once)
+ */
+void jvm_span_mark(jvm_span *span, jvm_phase phase);
+
+/**
+ * Returns the monotonic time, as {@link jvm_metrics_now}, when the {@param
+ * span} started
+ */
+double jvm_span_started(const jvm_span *span);
+
+/**
+ * Ends the {@param span}, recording it in the metrics and writing it
+ * in the {@param log} if it isn't NULL and the span is sampled
+ */
+void jvm_span_end(jvm_span *span, jvm_trace_log *log);
+
+/**
+ * Opens the {@param self} log appending to the file in {@param path}, where
+ * a {@param rate} fraction (between 0 and 1) of the spans is written, evenly
+ * spread among them
+ * @return  {@link operation_result} with the result of the operation
+ */
+operation_result jvm_trace_log_open(jvm_trace_log *self, const char *path,
+									double rate);
+
+/**
+ * Closes the {@param self} log
+ * @post    The spans written are flushed to the file
+ */
+void jvm_trace_log_close(jvm_trace_log *self);
+
+#endif //__JVM_TRACE_H__
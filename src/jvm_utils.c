@@ -1,5 +1,6 @@
 #include "jvm_utils.h"
 #include "int_vector.h"
+#include "jvm_fault.h"
 
 #define ISTORE_DESCRIPTION "istore"
 #define ILOAD_DESCRIPTION "iload"
@@ -47,12 +48,20 @@ static int _integer_mul(int a, int b) {
 	return a * b;
 }
 
+// Dividing by zero or INT_MIN by -1 raises SIGFPE instead of being checked,
+// and the engine turns it into a failure of the program
 static int _integer_div(int a, int b) {
-	return a / b;
+	int quotient;
+	int remainder;
+	jvm_fault_divide(a, b, &quotient, &remainder);
+	return quotient;
 }
 
 static int _integer_rem(int a, int b) {
-	return a % b;
+	int quotient;
+	int remainder;
+	jvm_fault_divide(a, b, &quotient, &remainder);
+	return remainder;
 }
 
 static int _logical_and(int a, int b) {
@@ -1,25 +1,236 @@
 #include <string.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <stdbool.h>
 
 #include "jvm_server.h"
 #include "jvm_client.h"
+#include "jvm_engine.h"
+#include "jvm_replay.h"
+#include "jvm_loadgen.h"
 
 #define PROGRAM_SUCCESS 0
 #define PROGRAM_FAILURE 1
 
 #define CLIENT_ARGUMENT "client"
 #define SERVER_ARGUMENT "server"
+#define RUN_ARGUMENT "run"
+#define REPLAY_ARGUMENT "replay"
+#define LOADGEN_ARGUMENT "loadgen"
+
+#define OPTION_PREFIX "--"
+#define PROTOCOL_OPTION "--protocol"
+#define PROTOCOL_LEGACY_VALUE "legacy"
+#define PROTOCOL_FRAMED_VALUE "framed"
+#define WINDOW_OPTION "--window"
+#define ENCODING_OPTION "--encoding"
+#define ENCODING_DENSE_VALUE "dense"
+#define ENCODING_COMPACT_VALUE "compact"
+#define VARIABLES_OPTION "--variables"
+#define RANGES_SEPARATOR ','
+#define RANGE_SEPARATOR '-'
+#define TRANSPORT_OPTION "--transport"
+#define TRANSPORT_TCP_VALUE "tcp"
+#define TRANSPORT_UNIX_VALUE "unix"
+#define TRANSPORT_SHM_VALUE "shm"
+#define SHM_SIZE_OPTION "--shm-size"
+#define CHECKSUM_OPTION "--checksum"
+#define CHECKSUM_NONE_VALUE "none"
+#define CHECKSUM_CRC32_VALUE "crc32"
+#define IO_OPTION "--io"
+#define IO_CLASSIC_VALUE "classic"
+#define IO_URING_VALUE "uring"
+#define CONNECTIONS_OPTION "--connections"
+#define SESSION_OPTION "--session"
+#define SESSION_TTL_OPTION "--session-ttl"
+#define SESSION_MEMORY_OPTION "--session-memory"
+#define CHECKPOINT_OPTION "--checkpoint"
+#define CHECKPOINT_INTERVAL_OPTION "--checkpoint-interval"
+#define METRICS_OPTION "--metrics"
+#define TRACE_LOG_OPTION "--trace-log"
+#define TRACE_SAMPLE_OPTION "--trace-sample"
+#define WORKERS_OPTION "--workers"
+#define QUANTUM_OPTION "--quantum"
+#define WEIGHTS_OPTION "--weights"
+#define MAX_WORKERS 256
+#define MAX_CONNECTIONS_OPTION "--max-connections"
+#define MAX_QUEUE_OPTION "--max-queue"
+#define MAX_REQUEST_BYTES_OPTION "--max-request-bytes"
+#define MAX_INSTRUCTIONS_OPTION "--max-instructions"
+#define PROCESSES_OPTION "--processes"
+#define MAX_PROCESSES 256
+#define CAPTURE_OPTION "--capture"
+#define PARALLEL_OPTION "--parallel"
+#define ENGINE_OPTION "--engine"
+#define ENGINE_STACK_VALUE "stack"
+#define ENGINE_REGISTER_VALUE "register"
+#define SPEED_OPTION "--speed"
+#define SPEED_ORIGINAL_VALUE "original"
+#define SPEED_MAX_VALUE "max"
+#define HOST_OPTION "--host"
+#define PORT_OPTION "--port"
+#define RATE_OPTION "--rate"
+#define DURATION_OPTION "--duration"
+#define MAX_LOADGEN_CONNECTIONS 4096
+
+/**
+ * Static function that parses the {@param value} of the transport option
+ */
+static operation_result
+parse_transport(const char *value, jvm_transport *transport) {
+	if (strcmp(value, TRANSPORT_TCP_VALUE) == 0) {
+		*transport = JVM_TRANSPORT_TCP;
+	} else if (strcmp(value, TRANSPORT_UNIX_VALUE) == 0) {
+		*transport = JVM_TRANSPORT_UNIX;
+	} else if (strcmp(value, TRANSPORT_SHM_VALUE) == 0) {
+		*transport = JVM_TRANSPORT_SHM;
+	} else {
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	}
+	return OPERATION_SUCCESS;
+}
+
+/**
+ * Static function that parses a variable index of a projection from {@param
+ * value}, leaving {@param end} after it
+ */
+static operation_result parse_index(const char *value, char **end,
+									uint32_t *index) {
+	errno = 0;
+	long parsed = strtol(value, end, 10);
+	if (errno == ERANGE || *end == value || parsed < 0 ||
+		parsed > INT32_MAX) {
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	}
+	*index = (uint32_t) parsed;
+	return OPERATION_SUCCESS;
+}
+
+/**
+ * Static function that parses the {@param value} of the variables option, a
+ * list of indexes and inclusive ranges separated by commas (as "0-3,7,10-12"),
+ * and stores the projection in {@param options}
+ */
+static operation_result
+parse_projection(jvm_client_options *options, const char *value) {
+	uint32_t quantity = 1;
+	for (const char *c = value; *c; c++) {
+		quantity += (*c == RANGES_SEPARATOR);
+	}
+	if (quantity > PROTOCOL_MAX_RANGES) {
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	}
+	jvm_range *ranges = (jvm_range *) malloc(quantity * sizeof(jvm_range));
+	if (!ranges) {
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
+	char *end = (char *) value;
+	for (uint32_t i = 0; i < quantity; i++) {
+		uint32_t first;
+		uint32_t last;
+		if (parse_index(end, &end, &first) != OPERATION_SUCCESS) {
+			free(ranges);
+			return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		}
+		last = first;
+		if (*end == RANGE_SEPARATOR &&
+			(parse_index(end + 1, &end, &last) != OPERATION_SUCCESS ||
+			 last < first)) {
+			free(ranges);
+			return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		}
+		if (*end != ((i + 1 < quantity) ? RANGES_SEPARATOR : '\0')) {
+			free(ranges);
+			return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		}
+		end++;
+		ranges[i].first = first;
+		ranges[i].count = last - first + 1;
+	}
+	free((jvm_range *) options->projection);
+	options->projection = ranges;
+	options->projection_ranges = quantity;
+	return OPERATION_SUCCESS;
+}
+
+/**
+ * Static function that parses a client option with its value and stores it in
+ * {@param options}
+ */
+static operation_result
+parse_client_option(jvm_client_options *options, const char *option,
+					const char *value) {
+	if (strcmp(option, PROTOCOL_OPTION) == 0) {
+		if (strcmp(value, PROTOCOL_LEGACY_VALUE) == 0) {
+			options->protocol = JVM_CLIENT_PROTOCOL_LEGACY;
+		} else if (strcmp(value, PROTOCOL_FRAMED_VALUE) == 0) {
+			options->protocol = JVM_CLIENT_PROTOCOL_FRAMED;
+		} else {
+			return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		}
+	} else if (strcmp(option, WINDOW_OPTION) == 0) {
+		char *end;
+		errno = 0;
+		long window = strtol(value, &end, 10);
+		if (errno == ERANGE || *end != '\0' || window < 1 ||
+			window > INT32_MAX) {
+			return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		}
+		options->window = (int) window;
+	} else if (strcmp(option, ENCODING_OPTION) == 0) {
+		if (strcmp(value, ENCODING_DENSE_VALUE) == 0) {
+			options->compact = false;
+		} else if (strcmp(value, ENCODING_COMPACT_VALUE) == 0) {
+			options->compact = true;
+		} else {
+			return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		}
+	} else if (strcmp(option, VARIABLES_OPTION) == 0) {
+		return parse_projection(options, value);
+	} else if (strcmp(option, SESSION_OPTION) == 0) {
+		if (strlen(value) == 0 || strlen(value) > PROTOCOL_MAX_SESSION_NAME) {
+			return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		}
+		options->session = value;
+	} else if (strcmp(option, TRANSPORT_OPTION) == 0) {
+		return parse_transport(value, &options->transport);
+	} else if (strcmp(option, CHECKSUM_OPTION) == 0) {
+		if (strcmp(value, CHECKSUM_NONE_VALUE) == 0) {
+			options->checksum = false;
+		} else if (strcmp(value, CHECKSUM_CRC32_VALUE) == 0) {
+			options->checksum = true;
+		} else {
+			return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		}
+	} else {
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	}
+	return OPERATION_SUCCESS;
+}
+
+/**
+ * Static function that closes the first {@param quantity} {@param sources}
+ */
+static void close_sources(FILE **sources, int quantity) {
+	for (int i = 0; i < quantity; i++) {
+		fclose(sources[i]);
+	}
+}
 
 /**
- * Static function that parses the client arguments and calls server_config. The program should be executed like this:
- *              ./program server <port>
+ * Static function that parses the client arguments and calls jvm_client_config. The program should be executed like this:
+ *              ./program client <host> <port> <N> [<filename>...] [--protocol legacy|framed] [--window <W>]
+ *                  [--encoding dense|compact] [--variables <ranges>] [--session <name>]
+ *                  [--transport tcp|unix|shm] [--checksum none|crc32]
+ * If no filename is specified, stdin will be used. More than one filename, the
+ * compact encoding, a projection of the variables, a session or a checksum
+ * imply the framed protocol
  * @param argc
  * @param argv
  */
 static operation_result
 parse_client_args(jvm_client *c, int argc, char *argv[]) {
-	if (argc < 5 || argc > 6) {
+	if (argc < 5) {
 		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
 	} else {
 		const char *port = argv[3];
@@ -27,32 +238,467 @@ parse_client_args(jvm_client *c, int argc, char *argv[]) {
 		int32_t var_size = (int32_t) strtol(argv[4], (char **) NULL, 10);
 		if (errno == ERANGE) {
 			return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
-		} else {
-			//Use filename or stdin
-			FILE *src = (argc == 5) ? stdin : fopen(argv[5], "rb");
-			if (!src) {
-				return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		}
+
+		jvm_client_options options;
+		jvm_client_options_default(&options);
+		bool protocol_given = false;
+		FILE **sources = (FILE **) malloc(argc * sizeof(FILE *));
+		if (!sources) {
+			return OPERATION_FAILURE_NO_MEMORY;
+		}
+		int sources_quantity = 0;
+		for (int i = 5; i < argc; i++) {
+			if (strncmp(argv[i], OPTION_PREFIX, strlen(OPTION_PREFIX)) == 0) {
+				protocol_given |= strcmp(argv[i], PROTOCOL_OPTION) == 0;
+				if (i + 1 == argc || parse_client_option(&options, argv[i],
+														 argv[i + 1]) !=
+									 OPERATION_SUCCESS) {
+					close_sources(sources, sources_quantity);
+					free(sources);
+					free((jvm_range *) options.projection);
+					return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+				}
+				i++;
+			} else {
+				sources[sources_quantity] = fopen(argv[i], "rb");
+				if (!sources[sources_quantity]) {
+					close_sources(sources, sources_quantity);
+					free(sources);
+					free((jvm_range *) options.projection);
+					return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+				}
+				sources_quantity++;
 			}
-			return jvm_client_config(argv[2], port, var_size, src, c);
 		}
+		//Use stdin if no filename was given
+		if (sources_quantity == 0) {
+			sources[sources_quantity++] = stdin;
+		}
+		if ((sources_quantity > 1 || options.compact ||
+			 options.projection_ranges > 0 || options.session ||
+			 options.checksum) &&
+			!protocol_given) {
+			options.protocol = JVM_CLIENT_PROTOCOL_FRAMED;
+		}
+		operation_result result = jvm_client_config(argv[2], port, var_size,
+													sources, sources_quantity,
+													&options, c);
+		if (result != OPERATION_SUCCESS) {
+			close_sources(sources, sources_quantity);
+		}
+		free(sources);
+		// The client keeps its own copy of the projection
+		free((jvm_range *) options.projection);
+		return result;
 	}
 }
 
 /**
- * Static function that parses the server arguments and calls client_config. The program should be executed like this:
- *              ./program client <host> <port> <N> [<filename>]
- * If no filename is specified, stdin will be used
+ * Static function that parses the name of an engine from {@param value} in
+ * {@param engine}
+ */
+static operation_result parse_engine(const char *value,
+									 jvm_engine_kind *engine) {
+	if (strcmp(value, ENGINE_STACK_VALUE) == 0) {
+		*engine = JVM_ENGINE_STACK;
+	} else if (strcmp(value, ENGINE_REGISTER_VALUE) == 0) {
+		*engine = JVM_ENGINE_REGISTER;
+	} else {
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	}
+	return OPERATION_SUCCESS;
+}
+
+/**
+ * Static function that parses a server option with its value and stores it in
+ * {@param options}
+ */
+static operation_result
+parse_server_option(jvm_server_options *options, const char *option,
+					const char *value) {
+	if (strcmp(option, IO_OPTION) == 0) {
+		if (strcmp(value, IO_CLASSIC_VALUE) == 0) {
+			options->backend = SOCKET_BACKEND_CLASSIC;
+		} else if (strcmp(value, IO_URING_VALUE) == 0) {
+			options->backend = SOCKET_BACKEND_URING;
+		} else {
+			return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		}
+	} else if (strcmp(option, CONNECTIONS_OPTION) == 0) {
+		char *end;
+		errno = 0;
+		long connections = strtol(value, &end, 10);
+		if (errno == ERANGE || *end != '\0' || connections < 0 ||
+			connections > INT32_MAX) {
+			return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		}
+		options->connections = (int) connections;
+	} else if (strcmp(option, TRANSPORT_OPTION) == 0) {
+		return parse_transport(value, &options->transport);
+	} else if (strcmp(option, SHM_SIZE_OPTION) == 0) {
+		char *end;
+		errno = 0;
+		long long shm_size = strtoll(value, &end, 10);
+		if (errno == ERANGE || *end != '\0' || shm_size < 1) {
+			return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		}
+		options->shm_size = (size_t) shm_size;
+	} else if (strcmp(option, SESSION_TTL_OPTION) == 0) {
+		char *end;
+		errno = 0;
+		long ttl = strtol(value, &end, 10);
+		if (errno == ERANGE || *end != '\0' || ttl < 0) {
+			return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		}
+		options->session_ttl = ttl;
+	} else if (strcmp(option, SESSION_MEMORY_OPTION) == 0) {
+		char *end;
+		errno = 0;
+		long long session_memory = strtoll(value, &end, 10);
+		if (errno == ERANGE || *end != '\0' || session_memory < 0) {
+			return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		}
+		options->session_memory = (size_t) session_memory;
+	} else if (strcmp(option, CHECKPOINT_OPTION) == 0) {
+		options->checkpoint = value;
+	} else if (strcmp(option, CHECKPOINT_INTERVAL_OPTION) == 0) {
+		char *end;
+		errno = 0;
+		long interval = strtol(value, &end, 10);
+		if (errno == ERANGE || *end != '\0' || interval < 0) {
+			return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		}
+		options->checkpoint_interval = interval;
+	} else if (strcmp(option, METRICS_OPTION) == 0) {
+		options->metrics = value;
+	} else if (strcmp(option, TRACE_LOG_OPTION) == 0) {
+		options->trace_log = value;
+	} else if (strcmp(option, TRACE_SAMPLE_OPTION) == 0) {
+		char *end;
+		errno = 0;
+		double sample = strtod(value, &end);
+		if (errno == ERANGE || *end != '\0' || end == value ||
+			!(sample >= 0 && sample <= 1)) {
+			return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		}
+		options->trace_sample = sample;
+	} else if (strcmp(option, WORKERS_OPTION) == 0) {
+		char *end;
+		errno = 0;
+		long workers = strtol(value, &end, 10);
+		if (errno == ERANGE || *end != '\0' || workers < 0 ||
+			workers > MAX_WORKERS) {
+			return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		}
+		options->workers = (int) workers;
+	} else if (strcmp(option, QUANTUM_OPTION) == 0) {
+		char *end;
+		errno = 0;
+		long quantum = strtol(value, &end, 10);
+		if (errno == ERANGE || *end != '\0' || quantum < 1) {
+			return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		}
+		options->quantum = quantum;
+	} else if (strcmp(option, WEIGHTS_OPTION) == 0) {
+		options->weights = value;
+	} else if (strcmp(option, MAX_CONNECTIONS_OPTION) == 0 ||
+			   strcmp(option, MAX_QUEUE_OPTION) == 0) {
+		char *end;
+		errno = 0;
+		long maximum = strtol(value, &end, 10);
+		if (errno == ERANGE || *end != '\0' || maximum < 0 ||
+			maximum > INT32_MAX) {
+			return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		}
+		if (strcmp(option, MAX_CONNECTIONS_OPTION) == 0) {
+			options->max_connections = (int) maximum;
+		} else {
+			options->max_queue = (int) maximum;
+		}
+	} else if (strcmp(option, MAX_REQUEST_BYTES_OPTION) == 0) {
+		char *end;
+		errno = 0;
+		long long max_bytes = strtoll(value, &end, 10);
+		if (errno == ERANGE || *end != '\0' || max_bytes < 0) {
+			return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		}
+		options->max_request_bytes = (size_t) max_bytes;
+	} else if (strcmp(option, MAX_INSTRUCTIONS_OPTION) == 0) {
+		char *end;
+		errno = 0;
+		long max_instructions = strtol(value, &end, 10);
+		if (errno == ERANGE || *end != '\0' || max_instructions < 0) {
+			return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		}
+		options->max_instructions = max_instructions;
+	} else if (strcmp(option, PROCESSES_OPTION) == 0) {
+		char *end;
+		errno = 0;
+		long processes = strtol(value, &end, 10);
+		if (errno == ERANGE || *end != '\0' || processes < 0 ||
+			processes > MAX_PROCESSES) {
+			return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		}
+		options->processes = (int) processes;
+	} else if (strcmp(option, CAPTURE_OPTION) == 0) {
+		options->capture = value;
+	} else if (strcmp(option, ENGINE_OPTION) == 0) {
+		return parse_engine(value, &options->engine);
+	} else if (strcmp(option, PARALLEL_OPTION) == 0) {
+		char *end;
+		errno = 0;
+		long parallel = strtol(value, &end, 10);
+		if (errno == ERANGE || *end != '\0' || parallel < 0 ||
+			parallel > JVM_DATAFLOW_MAX_THREADS) {
+			return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		}
+		options->parallel = (int) parallel;
+	} else {
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	}
+	return OPERATION_SUCCESS;
+}
+
+/**
+ * Static function that returns whether the server {@param option} configures
+ * the sessions, which the shared memory transport doesn't keep
+ */
+static bool is_session_option(const char *option) {
+	return strcmp(option, SESSION_TTL_OPTION) == 0 ||
+		   strcmp(option, SESSION_MEMORY_OPTION) == 0 ||
+		   strcmp(option, CHECKPOINT_OPTION) == 0 ||
+		   strcmp(option, CHECKPOINT_INTERVAL_OPTION) == 0;
+}
+
+/**
+ * Static function that parses the server arguments and calls jvm_server_config. The program should be executed like this:
+ *              ./program server <port> [--io classic|uring] [--connections <K>]
+ *                  [--transport tcp|unix|shm] [--shm-size <bytes>] [--session-ttl <seconds>]
+ *                  [--session-memory <bytes>] [--checkpoint <path>] [--checkpoint-interval <seconds>]
+ *                  [--metrics <port|path>] [--trace-log <path>] [--trace-sample <fraction>]
+ *                  [--workers <N>] [--quantum <byte_codes>] [--weights <session=weight,...>]
+ *                  [--max-connections <K>] [--max-queue <K>] [--max-request-bytes <bytes>]
+ *                  [--max-instructions <byte_codes>] [--processes <K>] [--capture <path>]
+ *                  [--parallel <threads>] [--engine stack|register]
  * @param argc
  * @param argv
  */
 static operation_result
 parse_server_args(jvm_server *s, int argc, char *argv[]) {
-	if (argc != 3) {
+	if (argc < 3 || (argc - 3) % 2 != 0) {
 		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
 	} else {
 		const char *port = argv[2];
-		return jvm_server_config(port, s);
+		jvm_server_options options;
+		jvm_server_options_default(&options);
+		bool sessions_configured = false;
+		for (int i = 3; i < argc; i += 2) {
+			if (parse_server_option(&options, argv[i], argv[i + 1]) !=
+				OPERATION_SUCCESS) {
+				return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+			}
+			sessions_configured |= is_session_option(argv[i]);
+		}
+		// Requests through shared memory never run within a session
+		if (sessions_configured && options.transport == JVM_TRANSPORT_SHM) {
+			return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		}
+		return jvm_server_config(port, &options, s);
+	}
+}
+
+/**
+ * Static function that parses the run arguments and executes the program
+ * locally, with no networking. The program should be executed like this:
+ *              ./program run <N> [<filename>]
+ * If no filename is specified, stdin will be used
+ * @param argc
+ * @param argv
+ */
+static operation_result run_locally(int argc, char *argv[]) {
+	if (argc < 3 || argc > 4) {
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	}
+	//Convert the var_size to int
+	errno = 0;
+	char *end;
+	long var_size = strtol(argv[2], &end, 10);
+	if (errno == ERANGE || *end != '\0' || var_size < 0 ||
+		var_size > INT32_MAX) {
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	}
+	//Use filename or stdin
+	FILE *src = (argc == 3) ? stdin : fopen(argv[3], "rb");
+	if (!src) {
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	}
+	operation_result result = jvm_engine_run(src, (int) var_size, stdout);
+	fclose(src);
+	return result;
+}
+
+/**
+ * Static function that parses the replay arguments and replays the capture,
+ * printing its report. The program should be executed like this:
+ *              ./program replay <capture> [--speed original|max] [--host <host>]
+ *                  [--port <port>] [--engine stack|register]
+ * If no port is specified, the requests are executed locally
+ * @param argc
+ * @param argv
+ * @return  {@link operation_result} with the result of the replay, which fails
+ *          if a request ended with other variables than the captured ones
+ */
+static operation_result replay_capture(int argc, char *argv[]) {
+	if (argc < 3 || (argc - 3) % 2 != 0) {
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	}
+	jvm_replay_options options;
+	jvm_replay_options_default(&options);
+	options.host = "localhost";
+	for (int i = 3; i < argc; i += 2) {
+		if (strcmp(argv[i], SPEED_OPTION) == 0 &&
+			strcmp(argv[i + 1], SPEED_ORIGINAL_VALUE) == 0) {
+			options.speed = JVM_REPLAY_SPEED_ORIGINAL;
+		} else if (strcmp(argv[i], SPEED_OPTION) == 0 &&
+				   strcmp(argv[i + 1], SPEED_MAX_VALUE) == 0) {
+			options.speed = JVM_REPLAY_SPEED_MAX;
+		} else if (strcmp(argv[i], HOST_OPTION) == 0) {
+			options.host = argv[i + 1];
+		} else if (strcmp(argv[i], PORT_OPTION) == 0) {
+			options.port = argv[i + 1];
+		} else if (strcmp(argv[i], ENGINE_OPTION) == 0) {
+			if (parse_engine(argv[i + 1], &options.engine) !=
+				OPERATION_SUCCESS) {
+				return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+			}
+		} else {
+			return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		}
+	}
+	jvm_replay_report report;
+	operation_result result = jvm_replay_run(argv[2], &options, &report);
+	if (result != OPERATION_SUCCESS) {
+		return result;
+	}
+	jvm_replay_print(&report, stdout);
+	return (report.mismatches == 0) ? OPERATION_SUCCESS
+									: OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+}
+
+/**
+ * Static function that parses the quantity of variables of the load
+ * generator from {@param value}: a single one (as "16") or an inclusive range
+ * drawn uniformly (as "4-64")
+ */
+static operation_result parse_variables_range(const char *value,
+											  jvm_loadgen_options *options) {
+	char *end;
+	errno = 0;
+	long first = strtol(value, &end, 10);
+	long last = first;
+	if (errno != ERANGE && end != value && *end == RANGE_SEPARATOR) {
+		const char *second = end + 1;
+		last = strtol(second, &end, 10);
+		if (end == second) {
+			return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		}
+	}
+	if (errno == ERANGE || end == value || *end != '\0' || first < 0 ||
+		last < first || last > INT32_MAX) {
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	}
+	options->min_variables = (int32_t) first;
+	options->max_variables = (int32_t) last;
+	return OPERATION_SUCCESS;
+}
+
+/**
+ * Static function that parses a load generator option with its value and
+ * stores it in {@param options}
+ */
+static operation_result
+parse_loadgen_option(jvm_loadgen_options *options, const char *option,
+					 const char *value) {
+	char *end;
+	errno = 0;
+	if (strcmp(option, RATE_OPTION) == 0 ||
+		strcmp(option, DURATION_OPTION) == 0) {
+		double parsed = strtod(value, &end);
+		if (errno == ERANGE || end == value || *end != '\0' ||
+			!(parsed > 0)) {
+			return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		}
+		if (strcmp(option, RATE_OPTION) == 0) {
+			options->rate = parsed;
+		} else {
+			options->duration = parsed;
+		}
+	} else if (strcmp(option, CONNECTIONS_OPTION) == 0) {
+		long connections = strtol(value, &end, 10);
+		if (errno == ERANGE || *end != '\0' || connections < 1 ||
+			connections > MAX_LOADGEN_CONNECTIONS) {
+			return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		}
+		options->connections = (int) connections;
+	} else if (strcmp(option, PROTOCOL_OPTION) == 0) {
+		if (strcmp(value, PROTOCOL_LEGACY_VALUE) == 0) {
+			options->protocol = JVM_CLIENT_PROTOCOL_LEGACY;
+		} else if (strcmp(value, PROTOCOL_FRAMED_VALUE) == 0) {
+			options->protocol = JVM_CLIENT_PROTOCOL_FRAMED;
+		} else {
+			return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		}
+	} else {
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	}
+	return OPERATION_SUCCESS;
+}
+
+/**
+ * Static function that parses the load generator arguments and drives the
+ * server, printing its report. The program should be executed like this:
+ *              ./program loadgen <host> <port> <N|min-max> <filename>... --rate <R>
+ *                  [--duration <seconds>] [--connections <C>] [--protocol legacy|framed]
+ * @param argc
+ * @param argv
+ */
+static operation_result generate_load(int argc, char *argv[]) {
+	if (argc < 6) {
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	}
+	jvm_loadgen_options options;
+	jvm_loadgen_options_default(&options);
+	if (parse_variables_range(argv[4], &options) != OPERATION_SUCCESS) {
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+	}
+	const char **corpus = (const char **) malloc((size_t) argc *
+												 sizeof(char *));
+	if (!corpus) {
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
+	int corpus_quantity = 0;
+	for (int i = 5; i < argc; i++) {
+		if (strncmp(argv[i], OPTION_PREFIX, strlen(OPTION_PREFIX)) != 0) {
+			corpus[corpus_quantity++] = argv[i];
+		} else if (i + 1 == argc ||
+				   parse_loadgen_option(&options, argv[i], argv[i + 1]) !=
+				   OPERATION_SUCCESS) {
+			free(corpus);
+			return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
+		} else {
+			i++;
+		}
+	}
+	jvm_loadgen_report report;
+	operation_result result = jvm_loadgen_run(argv[2], argv[3], corpus,
+											  corpus_quantity, &options,
+											  &report);
+	if (result == OPERATION_SUCCESS) {
+		jvm_loadgen_print(&report, &options, stdout);
 	}
+	free(corpus);
+	return result;
 }
 
 int main(int argc, char *argv[]) {
@@ -78,6 +724,15 @@ int main(int argc, char *argv[]) {
 				programResult = (jvm_server_start(&s) != OPERATION_SUCCESS)
 								? PROGRAM_FAILURE : PROGRAM_SUCCESS;
 			}
+		} else if (strcmp(modeArgument, RUN_ARGUMENT) == 0) {
+			programResult = (run_locally(argc, argv) != OPERATION_SUCCESS)
+							? PROGRAM_FAILURE : PROGRAM_SUCCESS;
+		} else if (strcmp(modeArgument, LOADGEN_ARGUMENT) == 0) {
+			programResult = (generate_load(argc, argv) != OPERATION_SUCCESS)
+							? PROGRAM_FAILURE : PROGRAM_SUCCESS;
+		} else if (strcmp(modeArgument, REPLAY_ARGUMENT) == 0) {
+			programResult = (replay_capture(argc, argv) != OPERATION_SUCCESS)
+							? PROGRAM_FAILURE : PROGRAM_SUCCESS;
 		} else {
 			programResult = PROGRAM_FAILURE;
 		}
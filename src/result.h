@@ -7,7 +7,13 @@ typedef enum operation_result {
 	OPERATION_FAILURE_NO_MEMORY,
 	OPERATION_FAILURE_OUT_OF_BOUNDS,
 	OPERATION_FAILURE_ILLEGAL_ARGUMENT,
-	OPERATION_FAILURE_CONNECTION_FAILED
+	OPERATION_FAILURE_CONNECTION_FAILED,
+	OPERATION_FAILURE_BUSY,
+	OPERATION_FAILURE_LIMIT_EXCEEDED,
+	OPERATION_FAILURE_CHECKSUM_MISMATCH,
+	OPERATION_FAILURE_ARITHMETIC,
+	OPERATION_FAILURE_STACK_OVERFLOW,
+	OPERATION_FAILURE_STACK_UNDERFLOW
 } operation_result;
 
 #endif //__RESULT_H__
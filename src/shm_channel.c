@@ -0,0 +1,249 @@
+#define _GNU_SOURCE
+
+#include "shm_channel.h"
+
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define SHM_MAGIC 0x4A564D53
+#define SHM_HEADER_SIZE 64
+#define SHM_ALIGNMENT 64
+// Waits are bounded so a peer that died is noticed
+#define SHM_WAIT_NANOSECONDS 100000000L
+
+#define SHM_STATE_IDLE 0
+#define SHM_STATE_REQUEST 1
+#define SHM_STATE_RESPONSE 2
+
+typedef struct shm_region {
+	uint32_t magic;
+	// Futex words: pid of the client holding the region (0 if it's free) and
+	// step of the exchange
+	uint32_t client;
+	uint32_t state;
+	int32_t server_pid;
+	int32_t var_size;
+	int32_t status;
+	uint64_t program_length;
+	uint64_t capacity;
+} shm_region;
+
+static char *region_data(shm_region *region) {
+	return (char *) region + SHM_HEADER_SIZE;
+}
+
+static size_t variables_offset(size_t program_length) {
+	return (program_length + SHM_ALIGNMENT - 1) & ~((size_t) SHM_ALIGNMENT - 1);
+}
+
+static bool fits(shm_region *region, size_t program_length, int32_t var_size) {
+	size_t offset = variables_offset(program_length);
+	return var_size >= 0 && offset <= region->capacity &&
+		   (size_t) var_size <= (region->capacity - offset) / sizeof(int);
+}
+
+static bool is_alive(pid_t pid) {
+	return kill(pid, 0) == 0 || errno != ESRCH;
+}
+
+/**
+ * Static function that sleeps while {@param word} is {@param expected}, at
+ * most SHM_WAIT_NANOSECONDS
+ */
+static void futex_wait(uint32_t *word, uint32_t expected) {
+	struct timespec timeout = {0, SHM_WAIT_NANOSECONDS};
+	syscall(SYS_futex, word, FUTEX_WAIT, expected, &timeout, NULL, 0);
+}
+
+static void futex_wake(uint32_t *word) {
+	syscall(SYS_futex, word, FUTEX_WAKE, INT32_MAX, NULL, NULL, 0);
+}
+
+/**
+ * Static function that stores the shm_open name of {@param name}, which must
+ * begin with a slash
+ */
+static int set_name(shm_channel *self, const char *name) {
+	size_t length = strlen(name);
+	self->_name = malloc(length + 2);
+	if (!self->_name) {
+		return SHM_CHANNEL_ERROR;
+	}
+	self->_name[0] = '/';
+	memcpy(&self->_name[1], (name[0] == '/') ? &name[1] : name,
+		   (name[0] == '/') ? length : length + 1);
+	return SHM_CHANNEL_SUCCESS;
+}
+
+static int map(shm_channel *self, int fd, size_t size) {
+	void *region = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (region == MAP_FAILED) {
+		return SHM_CHANNEL_ERROR;
+	}
+	self->_region = (shm_region *) region;
+	self->_size = size;
+	return SHM_CHANNEL_SUCCESS;
+}
+
+int shm_channel_create(shm_channel *self, const char *name, size_t capacity) {
+	if (set_name(self, name) == SHM_CHANNEL_ERROR) {
+		return SHM_CHANNEL_ERROR;
+	}
+	self->_owner = true;
+	int fd = shm_open(self->_name, O_CREAT | O_RDWR, 0600);
+	size_t size = SHM_HEADER_SIZE + capacity;
+	// Pages of the region are allocated by the kernel as they are touched
+	if (fd == -1 || ftruncate(fd, (off_t) size) == -1 ||
+		map(self, fd, size) == SHM_CHANNEL_ERROR) {
+		if (fd != -1) {
+			shm_unlink(self->_name);
+		}
+		free(self->_name);
+		return SHM_CHANNEL_ERROR;
+	}
+	shm_region *region = self->_region;
+	region->capacity = capacity;
+	region->server_pid = getpid();
+	__atomic_store_n(&region->state, SHM_STATE_IDLE, __ATOMIC_RELAXED);
+	__atomic_store_n(&region->client, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&region->magic, SHM_MAGIC, __ATOMIC_RELEASE);
+	return SHM_CHANNEL_SUCCESS;
+}
+
+int shm_channel_open(shm_channel *self, const char *name) {
+	if (set_name(self, name) == SHM_CHANNEL_ERROR) {
+		return SHM_CHANNEL_ERROR;
+	}
+	self->_owner = false;
+	int fd = shm_open(self->_name, O_RDWR, 0);
+	struct stat st;
+	if (fd == -1 || fstat(fd, &st) == -1 || st.st_size < SHM_HEADER_SIZE ||
+		map(self, fd, (size_t) st.st_size) == SHM_CHANNEL_ERROR) {
+		if (fd != -1) {
+			close(fd);
+		}
+		free(self->_name);
+		return SHM_CHANNEL_ERROR;
+	}
+	if (__atomic_load_n(&self->_region->magic, __ATOMIC_ACQUIRE) != SHM_MAGIC ||
+		SHM_HEADER_SIZE + self->_region->capacity > self->_size) {
+		shm_channel_close(self);
+		return SHM_CHANNEL_ERROR;
+	}
+	return SHM_CHANNEL_SUCCESS;
+}
+
+int shm_channel_claim(shm_channel *self) {
+	shm_region *region = self->_region;
+	uint32_t me = (uint32_t) getpid();
+	while (true) {
+		uint32_t holder = __atomic_load_n(&region->client, __ATOMIC_ACQUIRE);
+		if (!is_alive(region->server_pid)) {
+			return SHM_CHANNEL_ERROR;
+		}
+		if ((holder == 0 || !is_alive((pid_t) holder)) &&
+			__atomic_compare_exchange_n(&region->client, &holder, me, false,
+										__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			// A client that died could have left the exchange half done
+			__atomic_store_n(&region->state, SHM_STATE_IDLE, __ATOMIC_RELEASE);
+			return SHM_CHANNEL_SUCCESS;
+		}
+		futex_wait(&region->client, holder);
+	}
+}
+
+char *shm_channel_program(shm_channel *self, size_t *capacity) {
+	*capacity = self->_region->capacity;
+	return region_data(self->_region);
+}
+
+int shm_channel_request(shm_channel *self, int32_t var_size,
+						size_t program_length) {
+	shm_region *region = self->_region;
+	if (!fits(region, program_length, var_size)) {
+		return SHM_CHANNEL_ERROR;
+	}
+	region->var_size = var_size;
+	region->program_length = program_length;
+	__atomic_store_n(&region->state, SHM_STATE_REQUEST, __ATOMIC_RELEASE);
+	futex_wake(&region->state);
+
+	uint32_t state;
+	while ((state = __atomic_load_n(&region->state, __ATOMIC_ACQUIRE)) !=
+		   SHM_STATE_RESPONSE) {
+		if (!is_alive(region->server_pid)) {
+			return SHM_CHANNEL_ERROR;
+		}
+		futex_wait(&region->state, state);
+	}
+	return SHM_CHANNEL_SUCCESS;
+}
+
+const int *shm_channel_response(shm_channel *self, int32_t *var_size,
+								int32_t *status) {
+	shm_region *region = self->_region;
+	*var_size = region->var_size;
+	*status = region->status;
+	return (const int *) (region_data(region) +
+						  variables_offset(region->program_length));
+}
+
+void shm_channel_release(shm_channel *self) {
+	shm_region *region = self->_region;
+	__atomic_store_n(&region->state, SHM_STATE_IDLE, __ATOMIC_RELEASE);
+	__atomic_store_n(&region->client, 0, __ATOMIC_RELEASE);
+	futex_wake(&region->client);
+}
+
+int shm_channel_wait_request(shm_channel *self, const char **program,
+							 size_t *program_length, int32_t *var_size) {
+	shm_region *region = self->_region;
+	uint32_t state;
+	while ((state = __atomic_load_n(&region->state, __ATOMIC_ACQUIRE)) !=
+		   SHM_STATE_REQUEST) {
+		futex_wait(&region->state, state);
+	}
+	if (region->program_length > region->capacity) {
+		return SHM_CHANNEL_ERROR;
+	}
+	*program = region_data(region);
+	*program_length = region->program_length;
+	*var_size = region->var_size;
+	return SHM_CHANNEL_SUCCESS;
+}
+
+int *shm_channel_variables(shm_channel *self, int32_t var_size) {
+	shm_region *region = self->_region;
+	if (!fits(region, region->program_length, var_size)) {
+		return NULL;
+	}
+	return (int *) (region_data(region) +
+					variables_offset(region->program_length));
+}
+
+void shm_channel_respond(shm_channel *self, int32_t var_size, int32_t status) {
+	shm_region *region = self->_region;
+	region->var_size = var_size;
+	region->status = status;
+	__atomic_store_n(&region->state, SHM_STATE_RESPONSE, __ATOMIC_RELEASE);
+	futex_wake(&region->state);
+}
+
+void shm_channel_close(shm_channel *self) {
+	munmap(self->_region, self->_size);
+	if (self->_owner) {
+		shm_unlink(self->_name);
+	}
+	free(self->_name);
+}
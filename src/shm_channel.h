@@ -0,0 +1,104 @@
+#ifndef __SHM_CHANNEL_H__
+#define __SHM_CHANNEL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SHM_CHANNEL_ERROR -1
+#define SHM_CHANNEL_SUCCESS 0
+
+#define SHM_CHANNEL_DEFAULT_SIZE (64 * 1024 * 1024)
+
+/**
+ * Region of shared memory through which a co-located client and the server
+ * exchange a program and its variables without copying them through a socket.
+ * The client writes the program in the region, the server executes it in place
+ * and writes the variables right after it. Each side waits for the other one
+ * with a futex on the region
+ */
+typedef struct shm_channel {
+	struct shm_region *_region;
+	size_t _size;
+	char *_name;
+	bool _owner;
+} shm_channel;
+
+/**
+ * Function that creates the region named {@param name} able to hold {@param
+ * capacity} bytes of program and variables (server side)
+ * @return SHM_CHANNEL_SUCCESS or SHM_CHANNEL_ERROR
+ */
+int shm_channel_create(shm_channel *self, const char *name, size_t capacity);
+
+/**
+ * Function that maps the region named {@param name}, already created by a
+ * server (client side)
+ * @return SHM_CHANNEL_SUCCESS or SHM_CHANNEL_ERROR
+ */
+int shm_channel_open(shm_channel *self, const char *name);
+
+/**
+ * Function that waits until the region is free and takes it for the calling
+ * process. A region held by a process that died is taken over
+ * @return SHM_CHANNEL_SUCCESS or SHM_CHANNEL_ERROR
+ */
+int shm_channel_claim(shm_channel *self);
+
+/**
+ * Function that returns where the client must write the program
+ * @post   {@param capacity} contains the maximum length of the program
+ */
+char *shm_channel_program(shm_channel *self, size_t *capacity);
+
+/**
+ * Function that publishes the program of {@param program_length} bytes already
+ * written in the region, to be executed with {@param var_size} variables, and
+ * waits for the server to execute it
+ * @return SHM_CHANNEL_SUCCESS or SHM_CHANNEL_ERROR if the program and the
+ *         variables don't fit in the region or the server died
+ */
+int shm_channel_request(shm_channel *self, int32_t var_size,
+						size_t program_length);
+
+/**
+ * Function that returns the variables written by the server as response
+ * @post   {@param var_size} and {@param status} contain the quantity of
+ *         variables and the {@link operation_result} of the execution
+ */
+const int *shm_channel_response(shm_channel *self, int32_t *var_size,
+								int32_t *status);
+
+/**
+ * Function that frees the region so another client can claim it
+ */
+void shm_channel_release(shm_channel *self);
+
+/**
+ * Function that waits for a client to publish a program (server side)
+ * @post   {@param program}, {@param program_length} and {@param var_size}
+ *         describe the request
+ * @return SHM_CHANNEL_SUCCESS or SHM_CHANNEL_ERROR
+ */
+int shm_channel_wait_request(shm_channel *self, const char **program,
+							 size_t *program_length, int32_t *var_size);
+
+/**
+ * Function that returns where the server must store the {@param var_size}
+ * variables of the current request
+ * @return the area or NULL if they don't fit in the region
+ */
+int *shm_channel_variables(shm_channel *self, int32_t var_size);
+
+/**
+ * Function that wakes the client up after storing the variables, with the
+ * {@param status} of the execution
+ */
+void shm_channel_respond(shm_channel *self, int32_t var_size, int32_t status);
+
+/**
+ * Function that unmaps the region. The server also removes it
+ */
+void shm_channel_close(shm_channel *self);
+
+#endif //__SHM_CHANNEL_H__
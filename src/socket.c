@@ -1,15 +1,64 @@
-#define _POSIX_C_SOURCE 200112L
+#define _GNU_SOURCE
 
 #include "socket.h"
+#include "socket_uring.h"
+#include "jvm_probes.h"
 
 #include <sys/types.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include <netdb.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
 #include <unistd.h>
+#include <errno.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
 
 #define PROTOCOL_INT_BYTES 4
+#define LISTEN_BACKLOG 20
+// Quantity of ints byte swapped and sent per syscall
+#define SOCKET_INTS_BLOCK 16384
+// Bytes moved per syscall when sending the content of a file descriptor
+#define SOCKET_FILE_BLOCK (1024 * 1024)
+
+// Like the rings, each thread selects its own backend
+static __thread socket_backend selected_backend = SOCKET_BACKEND_CLASSIC;
+
+/**
+ * Static function that copies {@param count} ints from {@param src} to {@param
+ * dst} (which may be the same) swapping them between the architecture and the
+ * network endianness
+ */
+static void swap_ints(uint32_t *dst, const uint32_t *src, long count) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	memmove(dst, src, (size_t) count * sizeof(uint32_t));
+#else
+	long i = 0;
+#ifdef __SSSE3__
+	// Reverses the bytes of the four ints of a vector in a single shuffle
+	const __m128i mask = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11,
+									  4, 5, 6, 7, 0, 1, 2, 3);
+	for (; i + 4 <= count; i += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i *) &src[i]);
+		_mm_storeu_si128((__m128i *) &dst[i], _mm_shuffle_epi8(v, mask));
+	}
+#endif
+	// Vectorized by the compiler when SSSE3 isn't available
+	for (; i < count; i++) {
+		dst[i] = __builtin_bswap32(src[i]);
+	}
+#endif
+}
 
 /**
  * Static function that transforms a num to big endian (to be able to send through
@@ -69,10 +118,13 @@ int socket_connect(socket_t *self, const char *host, const char *port) {
 
 	freeaddrinfo(ptr);
 	self->fd = fd;
+	self->_uring = NULL;
+	self->bytes_sent = 0;
+	self->bytes_received = 0;
 	return SOCKET_CONNECTION_SUCCESS;
 }
 
-int socket_bind_and_address(socket_t *self, const char *port) {
+int socket_bind_and_address(socket_t *self, const char *port, bool shared) {
 	int s = 0;
 	int val;
 
@@ -99,6 +151,9 @@ int socket_bind_and_address(socket_t *self, const char *port) {
 
 	val = 1;
 	s = setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &val, sizeof(val));
+	if (s != -1 && shared) {
+		s = setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &val, sizeof(val));
+	}
 	if (s == -1) {
 		close(fd);
 		freeaddrinfo(ptr);
@@ -113,29 +168,138 @@ int socket_bind_and_address(socket_t *self, const char *port) {
 	}
 
 	freeaddrinfo(ptr);
-	s = listen(fd, 20);
+	s = listen(fd, LISTEN_BACKLOG);
 	if (s == -1) {
 		close(fd);
 		return SOCKET_CONNECTION_ERROR;
 	}
 
 	self->fd = fd;
+	self->_uring = NULL;
+	self->bytes_sent = 0;
+	self->bytes_received = 0;
+	return SOCKET_CONNECTION_SUCCESS;
+}
+
+/**
+ * Static function that fills the unix domain socket address of {@param path}
+ * @return false if the path is too long
+ */
+static bool unix_address(struct sockaddr_un *addr, const char *path) {
+	if (strlen(path) >= sizeof(addr->sun_path)) {
+		return false;
+	}
+	memset(addr, 0, sizeof(struct sockaddr_un));
+	addr->sun_family = AF_UNIX;
+	strncpy(addr->sun_path, path, sizeof(addr->sun_path) - 1);
+	return true;
+}
+
+int socket_connect_unix(socket_t *self, const char *path) {
+	struct sockaddr_un addr;
+	if (!unix_address(&addr, path)) {
+		return SOCKET_CONNECTION_ERROR;
+	}
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd == -1) {
+		return SOCKET_CONNECTION_ERROR;
+	}
+
+	if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == -1) {
+		close(fd);
+		return SOCKET_CONNECTION_ERROR;
+	}
+
+	self->fd = fd;
+	self->_uring = NULL;
+	self->bytes_sent = 0;
+	self->bytes_received = 0;
 	return SOCKET_CONNECTION_SUCCESS;
 }
 
+int socket_bind_unix(socket_t *self, const char *path) {
+	struct sockaddr_un addr;
+	if (!unix_address(&addr, path)) {
+		return SOCKET_CONNECTION_ERROR;
+	}
+
+	// Only a socket left by a previous server is removed, never another file
+	struct stat st;
+	if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+		unlink(path);
+	}
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd == -1) {
+		return SOCKET_CONNECTION_ERROR;
+	}
+
+	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) == -1) {
+		close(fd);
+		return SOCKET_CONNECTION_ERROR;
+	}
+
+	if (listen(fd, LISTEN_BACKLOG) == -1) {
+		close(fd);
+		unlink(path);
+		return SOCKET_CONNECTION_ERROR;
+	}
+
+	self->fd = fd;
+	self->_uring = NULL;
+	self->bytes_sent = 0;
+	self->bytes_received = 0;
+	return SOCKET_CONNECTION_SUCCESS;
+}
+
+socket_backend socket_select_backend(socket_backend backend) {
+	if (backend == SOCKET_BACKEND_URING && !socket_uring_available()) {
+		backend = SOCKET_BACKEND_CLASSIC;
+	}
+	selected_backend = backend;
+	return backend;
+}
+
+void socket_release_backend(void) {
+	socket_uring_release();
+}
+
 int socket_accept(socket_t *self, socket_t *remote_skt) {
-	remote_skt->fd = accept(self->fd, NULL, NULL);
+	remote_skt->_uring = NULL;
+	remote_skt->bytes_sent = 0;
+	remote_skt->bytes_received = 0;
+	if (selected_backend == SOCKET_BACKEND_URING) {
+		remote_skt->fd = socket_uring_accept(self->fd);
+		if (remote_skt->fd != -1) {
+			// If the ring can't be used, the classic path is taken instead
+			remote_skt->_uring = socket_uring_attach(remote_skt->fd);
+		}
+	} else {
+		remote_skt->fd = accept(self->fd, NULL, NULL);
+	}
 	return (remote_skt->fd == -1) ? SOCKET_CONNECTION_ERROR
 								  : SOCKET_CONNECTION_SUCCESS;
 }
 
-long socket_send(socket_t *self, const char *buffer, long size) {
+/**
+ * Static function that sends the whole {@param buffer} with the extra send
+ * {@param flags}
+ */
+static long
+send_with_flags(socket_t *self, const char *buffer, long size, int flags) {
+	if (self->_uring) {
+		long sent = socket_uring_send(self->_uring, buffer, size, flags);
+		self->bytes_sent += (sent > 0) ? (uint64_t) sent : 0;
+		JVM_PROBE2(chunk_sent, self->fd, sent);
+		return sent;
+	}
 	long sent = 0;
 	int s = 0;
 	bool is_the_socket_valid = true;
 	while (sent < size && is_the_socket_valid) {
 		s = (int) send(self->fd, &buffer[sent], (size_t) (size - sent),
-					   MSG_NOSIGNAL);
+					   MSG_NOSIGNAL | flags);
 
 		if (s <= 0) {
 			is_the_socket_valid = false;
@@ -144,6 +308,8 @@ long socket_send(socket_t *self, const char *buffer, long size) {
 		}
 	}
 
+	self->bytes_sent += (uint64_t) sent;
+	JVM_PROBE2(chunk_sent, self->fd, sent);
 	if (is_the_socket_valid) {
 		return sent;
 	} else {
@@ -151,32 +317,174 @@ long socket_send(socket_t *self, const char *buffer, long size) {
 	}
 }
 
+long socket_send(socket_t *self, const char *buffer, long size) {
+	return send_with_flags(self, buffer, size, 0);
+}
+
+long socket_send_more(socket_t *self, const char *buffer, long size) {
+	return send_with_flags(self, buffer, size, MSG_MORE);
+}
+
+/**
+ * Static function that copies the content of {@param fd} to the socket through
+ * a user space buffer, until {@param length} bytes are sent (or the end of the
+ * file if it's negative)
+ */
+static long copy_from_fd(socket_t *self, int fd, long length) {
+	char *buffer = (char *) malloc(SOCKET_FILE_BLOCK);
+	if (!buffer) {
+		return SOCKET_CONNECTION_ERROR;
+	}
+	long sent = 0;
+	while (length < 0 || sent < length) {
+		size_t wanted = (length < 0 || length - sent > SOCKET_FILE_BLOCK)
+						? SOCKET_FILE_BLOCK : (size_t) (length - sent);
+		ssize_t bytes_read = read(fd, buffer, wanted);
+		if (bytes_read < 0 && errno == EINTR) {
+			continue;
+		} else if (bytes_read < 0 || (bytes_read == 0 && length >= 0)) {
+			free(buffer);
+			return SOCKET_CONNECTION_ERROR;
+		} else if (bytes_read == 0) {
+			break;
+		}
+		if (socket_send(self, buffer, bytes_read) == SOCKET_CONNECTION_ERROR) {
+			free(buffer);
+			return SOCKET_CONNECTION_ERROR;
+		}
+		sent += bytes_read;
+	}
+	free(buffer);
+	return sent;
+}
+
+/**
+ * Static function that blocks SIGPIPE in the calling thread, as sendfile and
+ * splice can't take MSG_NOSIGNAL and a peer that stops reading would kill the
+ * process. The previous mask is kept in {@param previous}
+ * @return whether a SIGPIPE was already pending, so it isn't discarded later
+ */
+static bool block_broken_pipe(sigset_t *previous) {
+	sigset_t broken_pipe;
+	sigemptyset(&broken_pipe);
+	sigaddset(&broken_pipe, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &broken_pipe, previous);
+	sigset_t pending;
+	sigpending(&pending);
+	return sigismember(&pending, SIGPIPE) == 1;
+}
+
+/**
+ * Static function that discards the SIGPIPE raised while it was blocked (if
+ * it wasn't {@param was_pending} before) and restores the {@param previous}
+ * mask. The errno of the failed write is preserved
+ */
+static void restore_broken_pipe(const sigset_t *previous, bool was_pending) {
+	int saved_errno = errno;
+	if (!was_pending) {
+		sigset_t broken_pipe;
+		sigemptyset(&broken_pipe);
+		sigaddset(&broken_pipe, SIGPIPE);
+		struct timespec no_wait = {0, 0};
+		while (sigtimedwait(&broken_pipe, NULL, &no_wait) == -1 &&
+			   errno == EINTR) {
+		}
+	}
+	pthread_sigmask(SIG_SETMASK, previous, NULL);
+	errno = saved_errno;
+}
+
+long socket_send_file(socket_t *self, int fd, long length) {
+	long sent = 0;
+	if (!self->_uring) {
+		sigset_t previous;
+		bool was_pending = block_broken_pipe(&previous);
+		bool failed = false;
+		bool unsupported = false;
+		// The kernel copies the pages of the file straight to the socket
+		while (sent < length && !failed && !unsupported) {
+			size_t wanted = (length - sent > SOCKET_FILE_BLOCK)
+							? SOCKET_FILE_BLOCK : (size_t) (length - sent);
+			ssize_t s = sendfile(self->fd, fd, NULL, wanted);
+			if (s > 0) {
+				sent += s;
+				self->bytes_sent += (uint64_t) s;
+			} else if (s < 0 && errno == EINTR) {
+				continue;
+			} else if (s < 0 && sent == 0 &&
+					   (errno == EINVAL || errno == ENOSYS)) {
+				// The file doesn't support sendfile
+				unsupported = true;
+			} else {
+				// EPIPE included: the peer stopped reading
+				failed = true;
+			}
+		}
+		restore_broken_pipe(&previous, was_pending);
+		if (failed) {
+			return SOCKET_CONNECTION_ERROR;
+		} else if (sent == length) {
+			return sent;
+		}
+	}
+	long copied = copy_from_fd(self, fd, length - sent);
+	return (copied == SOCKET_CONNECTION_ERROR) ? SOCKET_CONNECTION_ERROR
+											   : sent + copied;
+}
+
+long socket_send_stream(socket_t *self, int fd) {
+	long sent = 0;
+	if (!self->_uring) {
+		sigset_t previous;
+		bool was_pending = block_broken_pipe(&previous);
+		// The pages of a pipe are moved to the socket without copying them
+		ssize_t s;
+		do {
+			s = splice(fd, NULL, self->fd, NULL, SOCKET_FILE_BLOCK,
+					   SPLICE_F_MOVE | SPLICE_F_MORE);
+			if (s > 0) {
+				sent += s;
+				self->bytes_sent += (uint64_t) s;
+			}
+		} while (s > 0 || (s < 0 && errno == EINTR));
+		bool spliced = (s == 0 || sent > 0 || errno != EINVAL);
+		restore_broken_pipe(&previous, was_pending);
+		if (spliced) {
+			return (s == 0) ? sent : SOCKET_CONNECTION_ERROR;
+		}
+		// Not a pipe, the content is copied instead
+	}
+	return copy_from_fd(self, fd, -1);
+}
+
 long socket_recv(socket_t *self, char *buffer,
 				 long chunk_size) {
+	if (self->_uring) {
+		long received = socket_uring_recv(self->_uring, buffer, chunk_size);
+		self->bytes_received += (received > 0) ? (uint64_t) received : 0;
+		JVM_PROBE2(chunk_received, self->fd, received);
+		return received;
+	}
 	long received = 0;
-	int s = 0;
 	bool are_we_connected = true;
-	bool finished = false;
 	bool result = true;
-	while (are_we_connected && !finished && (received < chunk_size)) {
-		int new_s = (int) recv(self->fd, &buffer[received],
-							   (chunk_size - received),
-							   MSG_NOSIGNAL);
-
-		if (new_s == s) { //Didn't get new bytes
-			finished = true;
+	while (are_we_connected && (received < chunk_size)) {
+		// The kernel wakes the thread up once the whole buffer arrived
+		long new_s = recv(self->fd, &buffer[received],
+						  (size_t) (chunk_size - received),
+						  MSG_NOSIGNAL | MSG_WAITALL);
+
+		if (new_s == 0) { // Socket closed
+			are_we_connected = false;
+		} else if (new_s < 0) { // Error
+			are_we_connected = false;
+			result = false;
 		} else {
-			if (new_s == 0) { // Socket closed
-				are_we_connected = false;
-			} else if (new_s < 0) { // Error
-				are_we_connected = false;
-				result = false;
-			} else {
-				s = new_s;
-				received += new_s;
-			}
+			received += new_s;
 		}
 	}
+	self->bytes_received += (uint64_t) received;
+	JVM_PROBE2(chunk_received, self->fd, received);
 	return result ? received : SOCKET_CONNECTION_ERROR;
 }
 
@@ -196,8 +504,61 @@ int socket_recv_int(socket_t *self, int *out) {
 	return SOCKET_CONNECTION_SUCCESS;
 }
 
+/**
+ * Static function that sends the {@param count} {@param values} in blocks,
+ * corking all of them but the last one, which is sent with {@param last_flags}
+ */
+static long send_ints_with_flags(socket_t *self, const int *values, long count,
+								 int last_flags) {
+	long block = (count < SOCKET_INTS_BLOCK) ? count : SOCKET_INTS_BLOCK;
+	uint32_t *buffer = (uint32_t *) malloc(
+			(size_t) (block ? block : 1) * sizeof(uint32_t));
+	if (!buffer) {
+		return SOCKET_CONNECTION_ERROR;
+	}
+	long sent = 0;
+	while (sent < count) {
+		long quantity = (count - sent < block) ? count - sent : block;
+		swap_ints(buffer, (const uint32_t *) &values[sent], quantity);
+		// Every block but the last is corked, so the kernel fills whole segments
+		long size = quantity * PROTOCOL_INT_BYTES;
+		if (send_with_flags(self, (const char *) buffer, size,
+							(sent + quantity < count) ? MSG_MORE : last_flags) !=
+			size) {
+			free(buffer);
+			return SOCKET_CONNECTION_ERROR;
+		}
+		sent += quantity;
+	}
+	free(buffer);
+	return sent * PROTOCOL_INT_BYTES;
+}
+
+long socket_send_ints(socket_t *self, const int *values, long count) {
+	return send_ints_with_flags(self, values, count, 0);
+}
+
+long socket_send_ints_more(socket_t *self, const int *values, long count) {
+	return send_ints_with_flags(self, values, count, MSG_MORE);
+}
+
+int socket_recv_ints(socket_t *self, int *out, long count) {
+	long size = count * PROTOCOL_INT_BYTES;
+	if (socket_recv(self, (char *) out, size) != size) {
+		return SOCKET_CONNECTION_ERROR;
+	}
+	swap_ints((uint32_t *) out, (const uint32_t *) out, count);
+	return SOCKET_CONNECTION_SUCCESS;
+}
+
 void socket_close(socket_t *self) {
-	close(self->fd);
+	if (self->_uring) {
+		socket_uring_close(self->_uring);
+		self->_uring = NULL;
+	} else {
+		socket_uring_forget_listener(self->fd);
+		close(self->fd);
+	}
 }
 
 int socket_shutdown(socket_t *self, int mode) {
@@ -1,13 +1,43 @@
 #ifndef __SOCKET_H__
 #define __SOCKET_H__
 
+#include <stdint.h>
+#include <stdbool.h>
+
 #define SOCKET_CONNECTION_ERROR -1
 #define SOCKET_CONNECTION_SUCCESS 0
 
+typedef enum socket_backend {
+	SOCKET_BACKEND_CLASSIC,
+	SOCKET_BACKEND_URING
+} socket_backend;
+
+/**
+ * Connected or listening socket:
+ *          - fd: its file descriptor
+ *          - bytes_sent, bytes_received: traffic since it was created, which
+ *            its user may reset once accounted
+ */
 typedef struct socket {
 	int fd;
+	struct socket_uring_conn *_uring;
+	uint64_t bytes_sent;
+	uint64_t bytes_received;
 } socket_t;
 
+/**
+ * Function that selects the {@param backend} used by the sockets accepted from
+ * now on by the calling thread. If the kernel doesn't support io_uring, the
+ * classic backend (blocking send/recv syscalls) is kept
+ * @return the backend actually selected
+ */
+socket_backend socket_select_backend(socket_backend backend);
+
+/**
+ * Function that releases the resources held by the backend in the calling thread
+ */
+void socket_release_backend(void);
+
 /**
  * Function that connects to a given {@param host} and {@param port} and creates
  * the socket_t instance in  {@param self}
@@ -17,10 +47,27 @@ int socket_connect(socket_t *self, const char *host, const char *port);
 
 /**
  * Function that opens a socket in the given {@param port} and configures a server
- * creating a socket_t instance in {@param self}
+ * creating a socket_t instance in {@param self}. If {@param shared} is true,
+ * the port can be bound by other processes as well (SO_REUSEPORT), and the
+ * kernel balances the incoming connections among all of them
+ * @return SOCKET_CONNECTION_SUCCESS or SOCKET_CONNECTION_ERROR
+ */
+int socket_bind_and_address(socket_t *self, const char *port, bool shared);
+
+/**
+ * Function that connects to the unix domain socket bound to {@param path} and
+ * creates the socket_t instance in {@param self}
  * @return SOCKET_CONNECTION_SUCCESS or SOCKET_CONNECTION_ERROR
  */
-int socket_bind_and_address(socket_t *self, const char *port);
+int socket_connect_unix(socket_t *self, const char *path);
+
+/**
+ * Function that binds a unix domain socket to {@param path} and configures a
+ * server creating a socket_t instance in {@param self}. A socket left in the
+ * path by a previous server is replaced
+ * @return SOCKET_CONNECTION_SUCCESS or SOCKET_CONNECTION_ERROR
+ */
+int socket_bind_unix(socket_t *self, const char *path);
 
 /**
  * Function that waits for incoming connection in the port already configured in
@@ -36,9 +83,35 @@ int socket_accept(socket_t *self, socket_t *remote_skt);
  */
 long socket_send(socket_t *self, const char *buffer, long size);
 
+/**
+ * Function that sends the message like {@link socket_send}, but hints the kernel
+ * that more data follows (MSG_MORE), so both are coalesced in the same segments
+ * @return the quantity of bytes sent or SOCKET_CONNECTION_ERROR
+ */
+long socket_send_more(socket_t *self, const char *buffer, long size);
+
+/**
+ * Function that sends {@param length} bytes of the regular file {@param fd},
+ * starting from its current offset, through the socket. The kernel copies the
+ * file straight to the socket with sendfile, without user space buffers. A
+ * peer that stops reading fails the send instead of raising SIGPIPE
+ * @return the quantity of bytes sent or SOCKET_CONNECTION_ERROR
+ */
+long socket_send_file(socket_t *self, int fd, long length);
+
+/**
+ * Function that sends everything read from {@param fd} until its end through
+ * the socket. Pipes are spliced into the socket, other descriptors are copied
+ * in large blocks. A peer that stops reading fails the send instead of raising
+ * SIGPIPE
+ * @return the quantity of bytes sent or SOCKET_CONNECTION_ERROR
+ */
+long socket_send_stream(socket_t *self, int fd);
+
 /**
  * Function that receives a message and stores it in {@param buffer} of size {@param chunk_size}
- * through the socket configured in {@param self}
+ * through the socket configured in {@param self}. Blocks until the buffer is full
+ * or the peer shutdowns the connection, so fewer bytes means the end of the stream
  * @return the quantity of bytes received or SOCKET_CONNECTION_ERROR
  */
 long socket_recv(socket_t *self, char *buffer, long chunk_size);
@@ -57,6 +130,29 @@ long socket_send_int(socket_t *self, int num);
  */
 int socket_recv_int(socket_t *self, int *out);
 
+/**
+ * Function that sends the {@param count} {@param values} through the socket,
+ * each one of them in the network endianess. The values are byte swapped in
+ * bulk into large blocks, so only a few syscalls are needed
+ * @return the quantity of bytes sent or SOCKET_CONNECTION_ERROR
+ */
+long socket_send_ints(socket_t *self, const int *values, long count);
+
+/**
+ * Function that sends the {@param count} {@param values} as {@link
+ * socket_send_ints}, coalescing them with the data sent afterwards
+ * @return the quantity of bytes sent or SOCKET_CONNECTION_ERROR
+ */
+long socket_send_ints_more(socket_t *self, const int *values, long count);
+
+/**
+ * Function that receives {@param count} ints in the network endianess through
+ * the socket with a single large receive, and converts them in bulk into
+ * {@param out}
+ * @return SOCKET_CONNECTION_SUCCESS or SOCKET_CONNECTION_ERROR
+ */
+int socket_recv_ints(socket_t *self, int *out, long count);
+
 /**
  * Function that closes the socket entirely and releases the resource
  */
@@ -0,0 +1,561 @@
+#define _GNU_SOURCE
+
+#include "socket_uring.h"
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define URING_ENTRIES 64
+#define URING_BUFFER_GROUP 0
+// Must be a power of two, it's used as the size of the provided buffers ring
+#define URING_BUFFERS 64
+#define URING_BUFFER_SIZE 16384
+
+// user_data values that aren't a socket_uring_conn pointer
+#define URING_TAG_NONE 0
+#define URING_TAG_ACCEPT 1
+#define URING_TAG_SEND 2
+
+struct socket_uring_conn {
+	int fd;
+	bool armed;
+	bool multishot;
+	bool eof;
+	int error;
+	// FIFO with the provided buffers filled by the multishot receive
+	unsigned short pending_bid[URING_BUFFERS];
+	int pending_len[URING_BUFFERS];
+	int pending_head;
+	int pending_count;
+	int pending_offset;
+};
+
+typedef struct uring {
+	int fd;
+	unsigned sq_entries;
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	void *sq_ring;
+	size_t sq_ring_size;
+	void *cq_ring;
+	size_t cq_ring_size;
+	size_t sqes_size;
+	unsigned to_submit;
+	// Provided buffers registered within the kernel
+	struct io_uring_buf_ring *buf_ring;
+	size_t buf_ring_size;
+	char *buffers;
+	unsigned short buf_tail;
+	// Multishot accept state
+	int listen_fd;
+	bool accept_armed;
+	bool accept_multishot;
+	int accept_error;
+	int *accepted;
+	int accepted_head;
+	int accepted_count;
+	int accepted_capacity;
+	// Result of the last send
+	bool send_done;
+	int send_result;
+} uring;
+
+static __thread uring *thread_ring = NULL;
+static __thread bool thread_ring_failed = false;
+
+static int uring_setup(unsigned entries, struct io_uring_params *p) {
+	return (int) syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uring_register(int fd, unsigned opcode, void *arg, unsigned args) {
+	return (int) syscall(__NR_io_uring_register, fd, opcode, arg, args);
+}
+
+/**
+ * Static function that submits the queued sqes and waits for {@param wait}
+ * completions
+ */
+static int uring_enter(uring *r, unsigned wait) {
+	int s;
+	do {
+		s = (int) syscall(__NR_io_uring_enter, r->fd, r->to_submit, wait,
+						  wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+	} while (s < 0 && errno == EINTR);
+	if (s > 0) {
+		r->to_submit -= (unsigned) s;
+	}
+	return s;
+}
+
+/**
+ * Static function that returns a zeroed sqe already queued for submission
+ */
+static struct io_uring_sqe *uring_get_sqe(uring *r) {
+	unsigned tail = *r->sq_tail;
+	while (tail - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE) >=
+		   r->sq_entries) {
+		uring_enter(r, 0);
+	}
+	unsigned index = tail & *r->sq_mask;
+	struct io_uring_sqe *sqe = &r->sqes[index];
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+	r->sq_array[index] = index;
+	__atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	r->to_submit++;
+	return sqe;
+}
+
+/**
+ * Static function that gives back the provided buffer {@param bid} to the kernel
+ */
+static void uring_recycle_buffer(uring *r, unsigned short bid) {
+	struct io_uring_buf *buf =
+			&r->buf_ring->bufs[r->buf_tail & (URING_BUFFERS - 1)];
+	buf->addr = (uintptr_t) (r->buffers + (size_t) bid * URING_BUFFER_SIZE);
+	buf->len = URING_BUFFER_SIZE;
+	buf->bid = bid;
+	r->buf_tail++;
+	__atomic_store_n(&r->buf_ring->tail, r->buf_tail, __ATOMIC_RELEASE);
+}
+
+static void uring_push_accepted(uring *r, int fd) {
+	if (r->accepted_count == r->accepted_capacity) {
+		int capacity = r->accepted_capacity ? r->accepted_capacity * 2 : 16;
+		int *accepted = malloc(capacity * sizeof(int));
+		if (!accepted) {
+			close(fd);
+			return;
+		}
+		for (int i = 0; i < r->accepted_count; i++) {
+			accepted[i] = r->accepted[(r->accepted_head + i) %
+									  r->accepted_capacity];
+		}
+		free(r->accepted);
+		r->accepted = accepted;
+		r->accepted_capacity = capacity;
+		r->accepted_head = 0;
+	}
+	r->accepted[(r->accepted_head + r->accepted_count) %
+				r->accepted_capacity] = fd;
+	r->accepted_count++;
+}
+
+static int uring_pop_accepted(uring *r) {
+	int fd = r->accepted[r->accepted_head];
+	r->accepted_head = (r->accepted_head + 1) % r->accepted_capacity;
+	r->accepted_count--;
+	return fd;
+}
+
+static void uring_complete_recv(uring *r, socket_uring_conn *c,
+								struct io_uring_cqe *cqe) {
+	if (cqe->res > 0 && (cqe->flags & IORING_CQE_F_BUFFER)) {
+		int tail = (c->pending_head + c->pending_count) % URING_BUFFERS;
+		c->pending_bid[tail] =
+				(unsigned short) (cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+		c->pending_len[tail] = cqe->res;
+		c->pending_count++;
+	} else if (cqe->res == 0) {
+		c->eof = true;
+	} else if (cqe->res == -EINVAL) {
+		// Multishot receive isn't supported by the running kernel
+		c->multishot = false;
+	} else if (cqe->res != -ENOBUFS && cqe->res != -ECANCELED) {
+		c->error = -cqe->res;
+	}
+	if (!(cqe->flags & IORING_CQE_F_MORE)) {
+		c->armed = false;
+	}
+}
+
+static void uring_complete_accept(uring *r, struct io_uring_cqe *cqe) {
+	if (cqe->res >= 0) {
+		uring_push_accepted(r, cqe->res);
+	} else if (cqe->res == -EINVAL && r->accept_multishot) {
+		// Multishot accept isn't supported, fall back to one sqe per accept
+		r->accept_multishot = false;
+	} else if (cqe->res != -ECANCELED) {
+		r->accept_error = -cqe->res;
+	}
+	if (!(cqe->flags & IORING_CQE_F_MORE)) {
+		r->accept_armed = false;
+	}
+}
+
+/**
+ * Static function that consumes every completion available in the cq ring
+ */
+static void uring_reap(uring *r) {
+	unsigned head = *r->cq_head;
+	unsigned tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+	while (head != tail) {
+		struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+		switch (cqe->user_data) {
+			case URING_TAG_NONE:
+				break;
+			case URING_TAG_ACCEPT:
+				uring_complete_accept(r, cqe);
+				break;
+			case URING_TAG_SEND:
+				r->send_done = true;
+				r->send_result = cqe->res;
+				break;
+			default:
+				uring_complete_recv(r, (socket_uring_conn *) (uintptr_t)
+						cqe->user_data, cqe);
+				break;
+		}
+		head++;
+	}
+	__atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+}
+
+/**
+ * Static function that waits for at least one new completion and consumes it
+ */
+static void uring_wait(uring *r) {
+	uring_enter(r, 1);
+	uring_reap(r);
+}
+
+static void uring_destroy(uring *r) {
+	if (r->buffers) {
+		free(r->buffers);
+	}
+	if (r->buf_ring) {
+		munmap(r->buf_ring, r->buf_ring_size);
+	}
+	if (r->sqes) {
+		munmap(r->sqes, r->sqes_size);
+	}
+	if (r->cq_ring && r->cq_ring != r->sq_ring) {
+		munmap(r->cq_ring, r->cq_ring_size);
+	}
+	if (r->sq_ring) {
+		munmap(r->sq_ring, r->sq_ring_size);
+	}
+	close(r->fd);
+	free(r->accepted);
+	free(r);
+}
+
+/**
+ * Static function that maps the rings of the io_uring instance in {@param r}
+ * and registers its provided buffers
+ * @return true on success
+ */
+static bool uring_map(uring *r, struct io_uring_params *p) {
+	r->sq_ring_size = p->sq_off.array + p->sq_entries * sizeof(unsigned);
+	r->cq_ring_size = p->cq_off.cqes +
+					  p->cq_entries * sizeof(struct io_uring_cqe);
+	bool single_mmap = (p->features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (single_mmap && r->cq_ring_size > r->sq_ring_size) {
+		r->sq_ring_size = r->cq_ring_size;
+	}
+
+	r->sq_ring = mmap(NULL, r->sq_ring_size, PROT_READ | PROT_WRITE,
+					  MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+	if (r->sq_ring == MAP_FAILED) {
+		r->sq_ring = NULL;
+		return false;
+	}
+	if (single_mmap) {
+		r->cq_ring = r->sq_ring;
+	} else {
+		r->cq_ring = mmap(NULL, r->cq_ring_size, PROT_READ | PROT_WRITE,
+						  MAP_SHARED | MAP_POPULATE, r->fd,
+						  IORING_OFF_CQ_RING);
+		if (r->cq_ring == MAP_FAILED) {
+			r->cq_ring = NULL;
+			return false;
+		}
+	}
+	r->sqes_size = p->sq_entries * sizeof(struct io_uring_sqe);
+	r->sqes = mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE,
+				   MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+	if (r->sqes == MAP_FAILED) {
+		r->sqes = NULL;
+		return false;
+	}
+
+	char *sq = (char *) r->sq_ring;
+	char *cq = (char *) r->cq_ring;
+	r->sq_entries = p->sq_entries;
+	r->sq_head = (unsigned *) (sq + p->sq_off.head);
+	r->sq_tail = (unsigned *) (sq + p->sq_off.tail);
+	r->sq_mask = (unsigned *) (sq + p->sq_off.ring_mask);
+	r->sq_array = (unsigned *) (sq + p->sq_off.array);
+	r->cq_head = (unsigned *) (cq + p->cq_off.head);
+	r->cq_tail = (unsigned *) (cq + p->cq_off.tail);
+	r->cq_mask = (unsigned *) (cq + p->cq_off.ring_mask);
+	r->cqes = (struct io_uring_cqe *) (cq + p->cq_off.cqes);
+
+	// Register the provided buffers used by the multishot receive
+	r->buf_ring_size = URING_BUFFERS * sizeof(struct io_uring_buf);
+	r->buf_ring = mmap(NULL, r->buf_ring_size, PROT_READ | PROT_WRITE,
+					   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (r->buf_ring == MAP_FAILED) {
+		r->buf_ring = NULL;
+		return false;
+	}
+	struct io_uring_buf_reg reg;
+	memset(&reg, 0, sizeof(struct io_uring_buf_reg));
+	reg.ring_addr = (uintptr_t) r->buf_ring;
+	reg.ring_entries = URING_BUFFERS;
+	reg.bgid = URING_BUFFER_GROUP;
+	if (uring_register(r->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+		return false;
+	}
+	r->buffers = malloc((size_t) URING_BUFFERS * URING_BUFFER_SIZE);
+	if (!r->buffers) {
+		return false;
+	}
+	for (unsigned short bid = 0; bid < URING_BUFFERS; bid++) {
+		uring_recycle_buffer(r, bid);
+	}
+	return true;
+}
+
+/**
+ * Static function that returns the io_uring instance of the calling thread,
+ * creating it the first time
+ * @return the instance or NULL if the kernel doesn't support it
+ */
+static uring *uring_get(void) {
+	if (thread_ring || thread_ring_failed) {
+		return thread_ring;
+	}
+	struct io_uring_params p;
+	memset(&p, 0, sizeof(struct io_uring_params));
+	int fd = uring_setup(URING_ENTRIES, &p);
+	if (fd < 0 || !(p.features & IORING_FEAT_NODROP)) {
+		if (fd >= 0) {
+			close(fd);
+		}
+		thread_ring_failed = true;
+		return NULL;
+	}
+	uring *r = calloc(1, sizeof(uring));
+	if (!r) {
+		close(fd);
+		thread_ring_failed = true;
+		return NULL;
+	}
+	r->fd = fd;
+	r->listen_fd = -1;
+	r->accept_multishot = true;
+	if (!uring_map(r, &p)) {
+		uring_destroy(r);
+		thread_ring_failed = true;
+		return NULL;
+	}
+	thread_ring = r;
+	return r;
+}
+
+bool socket_uring_available(void) {
+	return uring_get() != NULL;
+}
+
+int socket_uring_accept(int listen_fd) {
+	uring *r = uring_get();
+	if (!r) {
+		return -1;
+	}
+	if (r->listen_fd != listen_fd) {
+		socket_uring_forget_listener(r->listen_fd);
+		r->listen_fd = listen_fd;
+	}
+	while (r->accepted_count == 0) {
+		if (r->accept_error) {
+			errno = r->accept_error;
+			r->accept_error = 0;
+			return -1;
+		}
+		if (!r->accept_armed) {
+			struct io_uring_sqe *sqe = uring_get_sqe(r);
+			sqe->opcode = IORING_OP_ACCEPT;
+			sqe->fd = listen_fd;
+			sqe->ioprio = r->accept_multishot ? IORING_ACCEPT_MULTISHOT : 0;
+			sqe->user_data = URING_TAG_ACCEPT;
+			r->accept_armed = true;
+		}
+		uring_wait(r);
+	}
+	return uring_pop_accepted(r);
+}
+
+void socket_uring_forget_listener(int listen_fd) {
+	uring *r = thread_ring;
+	if (!r || listen_fd < 0 || r->listen_fd != listen_fd) {
+		return;
+	}
+	if (r->accept_armed) {
+		struct io_uring_sqe *sqe = uring_get_sqe(r);
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->fd = listen_fd;
+		sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+		sqe->user_data = URING_TAG_NONE;
+		while (r->accept_armed) {
+			uring_wait(r);
+		}
+	}
+	while (r->accepted_count > 0) {
+		close(uring_pop_accepted(r));
+	}
+	r->accept_error = 0;
+	r->listen_fd = -1;
+}
+
+/**
+ * Static function that arms the multishot receive of {@param c}
+ */
+static void uring_arm_recv(uring *r, socket_uring_conn *c) {
+	struct io_uring_sqe *sqe = uring_get_sqe(r);
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = c->fd;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = URING_BUFFER_GROUP;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->user_data = (uintptr_t) c;
+	c->armed = true;
+}
+
+socket_uring_conn *socket_uring_attach(int fd) {
+	uring *r = uring_get();
+	if (!r) {
+		return NULL;
+	}
+	socket_uring_conn *c = calloc(1, sizeof(socket_uring_conn));
+	if (!c) {
+		return NULL;
+	}
+	c->fd = fd;
+	c->multishot = true;
+	// The sqe is submitted along with the first operation on the connection
+	uring_arm_recv(r, c);
+	return c;
+}
+
+long socket_uring_send(socket_uring_conn *c, const char *buffer, long size,
+					   int flags) {
+	uring *r = thread_ring;
+	long sent = 0;
+	while (sent < size) {
+		struct io_uring_sqe *sqe = uring_get_sqe(r);
+		sqe->opcode = IORING_OP_SEND;
+		sqe->fd = c->fd;
+		sqe->addr = (uintptr_t) &buffer[sent];
+		sqe->len = (unsigned) (size - sent);
+		sqe->msg_flags = MSG_NOSIGNAL | flags;
+		sqe->user_data = URING_TAG_SEND;
+		r->send_done = false;
+		while (!r->send_done) {
+			uring_wait(r);
+		}
+		if (r->send_result <= 0) {
+			return -1;
+		}
+		sent += r->send_result;
+	}
+	return sent;
+}
+
+long socket_uring_recv(socket_uring_conn *c, char *buffer, long size) {
+	uring *r = thread_ring;
+	long received = 0;
+	while (received < size) {
+		if (c->pending_count > 0) {
+			// Copy from the oldest provided buffer
+			unsigned short bid = c->pending_bid[c->pending_head];
+			int available = c->pending_len[c->pending_head] -
+							c->pending_offset;
+			long wanted = size - received;
+			int copied = (wanted < available) ? (int) wanted : available;
+			memcpy(&buffer[received], r->buffers +
+					(size_t) bid * URING_BUFFER_SIZE + c->pending_offset,
+				   (size_t) copied);
+			received += copied;
+			c->pending_offset += copied;
+			if (copied == available) {
+				uring_recycle_buffer(r, bid);
+				c->pending_head = (c->pending_head + 1) % URING_BUFFERS;
+				c->pending_count--;
+				c->pending_offset = 0;
+			}
+		} else if (c->error) {
+			return -1;
+		} else if (c->eof) {
+			break;
+		} else if (!c->multishot) {
+			long s = recv(c->fd, &buffer[received],
+						  (size_t) (size - received), 0);
+			if (s < 0) {
+				return -1;
+			} else if (s == 0) {
+				c->eof = true;
+			} else {
+				received += s;
+			}
+		} else {
+			if (!c->armed) {
+				// Either it ran out of buffers or it's the first receive
+				uring_arm_recv(r, c);
+			}
+			uring_wait(r);
+		}
+	}
+	return received;
+}
+
+void socket_uring_close(socket_uring_conn *c) {
+	uring *r = thread_ring;
+	if (c->armed) {
+		struct io_uring_sqe *sqe = uring_get_sqe(r);
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->addr = (uintptr_t) c;
+		sqe->user_data = URING_TAG_NONE;
+		sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+		while (c->armed) {
+			uring_wait(r);
+		}
+	}
+	while (c->pending_count > 0) {
+		uring_recycle_buffer(r, c->pending_bid[c->pending_head]);
+		c->pending_head = (c->pending_head + 1) % URING_BUFFERS;
+		c->pending_count--;
+	}
+	struct io_uring_sqe *sqe = uring_get_sqe(r);
+	sqe->opcode = IORING_OP_CLOSE;
+	sqe->fd = c->fd;
+	sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+	sqe->user_data = URING_TAG_NONE;
+	free(c);
+}
+
+void socket_uring_release(void) {
+	uring *r = thread_ring;
+	if (!r) {
+		return;
+	}
+	socket_uring_forget_listener(r->listen_fd);
+	while (r->to_submit > 0 && uring_enter(r, 0) > 0) {
+		continue;
+	}
+	uring_destroy(r);
+	thread_ring = NULL;
+}
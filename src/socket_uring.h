@@ -0,0 +1,67 @@
+#ifndef __SOCKET_URING_H__
+#define __SOCKET_URING_H__
+
+#include <stdbool.h>
+
+/**
+ * Per connection state of the io_uring backend. Holds the provided buffers
+ * filled by the multishot receive that were not consumed yet
+ */
+typedef struct socket_uring_conn socket_uring_conn;
+
+/**
+ * Function that creates (if it wasn't already) the io_uring instance of the
+ * calling thread, registering the provided buffers ring
+ * @return true if the kernel supports every feature needed by the backend
+ */
+bool socket_uring_available(void);
+
+/**
+ * Function that accepts a connection from the listener {@param listen_fd}. The
+ * first call arms a multishot accept, so further connections are taken from
+ * the completion queue without entering the kernel
+ * @return the file descriptor of the peer or -1 on error
+ */
+int socket_uring_accept(int listen_fd);
+
+/**
+ * Function that attaches the connected {@param fd} to the ring of the calling
+ * thread and arms a multishot receive on it
+ * @return the connection state or NULL if the ring isn't available
+ */
+socket_uring_conn *socket_uring_attach(int fd);
+
+/**
+ * Function that sends {@param size} bytes from {@param buffer} through {@param c}
+ * with the extra send {@param flags}
+ * @return the quantity of bytes sent or -1 on error
+ */
+long socket_uring_send(socket_uring_conn *c, const char *buffer, long size,
+					   int flags);
+
+/**
+ * Function that receives {@param size} bytes in {@param buffer} from {@param c}.
+ * Blocks until the buffer is full or the peer shutdowns the connection
+ * @return the quantity of bytes received or -1 on error
+ */
+long socket_uring_recv(socket_uring_conn *c, char *buffer, long size);
+
+/**
+ * Function that cancels the pending receive of {@param c}, queues the close of
+ * its file descriptor (submitted along with the next operation) and releases it
+ */
+void socket_uring_close(socket_uring_conn *c);
+
+/**
+ * Function that cancels the multishot accept armed on {@param listen_fd} (if
+ * any) and closes the connections already accepted but not taken
+ */
+void socket_uring_forget_listener(int listen_fd);
+
+/**
+ * Function that flushes the queued operations and destroys the io_uring
+ * instance of the calling thread
+ */
+void socket_uring_release(void);
+
+#endif //__SOCKET_URING_H__
@@ -1,53 +1,145 @@
+#define _DEFAULT_SOURCE
+
 #include <memory.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #include "stack.h"
 
+// Stacks destroyed whose mapping is kept to create the next ones, as mapping
+// one for each request costs more than running most programs
+#define STACK_POOL_SIZE 16
+
+// Bytes of a page, kept so the signal handlers don't ask for them
+static size_t page_size = 0;
+
+static int *pool[STACK_POOL_SIZE];
+static int pooled = 0;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Static function that returns the bytes of the guard pages
+ */
+static size_t guard_size(void) {
+	if (!page_size) {
+		page_size = (size_t) sysconf(_SC_PAGESIZE);
+	}
+	return page_size;
+}
+
 operation_result stack_create(stack *pS, size_t elem_size) {
+	if (!pS)
+		return OPERATION_FAILURE_NULL_POINTER;
+	if (elem_size != sizeof(int))
+		return OPERATION_FAILURE_ILLEGAL_ARGUMENT;
 	pS->_elem_size = elem_size;
-	pS->_stack_size = 0;
+	pS->_base = NULL;
 	pS->_top = NULL;
+	pS->_mapped = 0;
+
+	size_t guard = guard_size();
+	size_t bytes = (size_t) STACK_CAPACITY * sizeof(int);
+	bytes = (bytes + guard - 1) / guard * guard;
+	size_t mapped = guard + bytes + guard;
+	pthread_mutex_lock(&pool_lock);
+	int *reused = (pooled > 0) ? pool[--pooled] : NULL;
+	pthread_mutex_unlock(&pool_lock);
+	if (reused) {
+		pS->_base = reused;
+		pS->_top = reused;
+		pS->_mapped = mapped;
+		return OPERATION_SUCCESS;
+	}
+
+	// The whole region is reserved inaccessible and then the stack is opened
+	// between the guard pages
+	char *region = (char *) mmap(NULL, mapped, PROT_NONE,
+								 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+								 -1, 0);
+	if (region == MAP_FAILED)
+		return OPERATION_FAILURE_NO_MEMORY;
+	if (mprotect(region + guard, bytes, PROT_READ | PROT_WRITE) != 0) {
+		munmap(region, mapped);
+		return OPERATION_FAILURE_NO_MEMORY;
+	}
+	pS->_base = (int *) (region + guard);
+	pS->_top = pS->_base;
+	pS->_mapped = mapped;
 	return OPERATION_SUCCESS;
 }
 
 operation_result stack_push(stack *pS, int *elem) {
 	if (!elem || !pS)
 		return OPERATION_FAILURE_NULL_POINTER;
+	*pS->_top++ = *elem;
+	return OPERATION_SUCCESS;
+}
 
-	stack_node *node = malloc(sizeof(stack_node));
-	if (!node)
-		return OPERATION_FAILURE_NO_MEMORY;
+int stack_pop(stack *pS) {
+	return *--pS->_top;
+}
 
-	node->_data = malloc(sizeof(pS->_elem_size));
-	if (!node->_data) {
-		return OPERATION_FAILURE_NO_MEMORY;
+size_t stack_size(const stack *pS) {
+	return (size_t) (pS->_top - pS->_base);
+}
+
+void stack_elements(const stack *pS, int *out) {
+	size_t i = 0;
+	for (const int *element = pS->_top; element > pS->_base;) {
+		out[i++] = *--element;
 	}
+}
 
-	memcpy(node->_data, elem, pS->_elem_size);
+void stack_clear(stack *pS) {
+	pS->_top = pS->_base;
+}
 
-	node->_lower = pS->_top;
-	pS->_top = node;
-	pS->_stack_size += 1;
-	return OPERATION_SUCCESS;
+size_t stack_memory(const stack *pS) {
+	size_t guard = guard_size();
+	return (stack_size(pS) * sizeof(int) + guard - 1) / guard * guard;
 }
 
-int stack_pop(stack *pS) {
-	if (!pS->_top) {
-		return OPERATION_FAILURE_NULL_POINTER;
+void stack_trim(stack *pS) {
+	if (!pS->_base) {
+		return;
 	}
+	char *kept = (char *) pS->_base + stack_memory(pS);
+	char *limit = (char *) pS->_base + pS->_mapped - 2 * guard_size();
+	if (kept < limit) {
+		// The pages are zeroed again if the stack grows back into them
+		madvise(kept, (size_t) (limit - kept), MADV_DONTNEED);
+	}
+}
 
-	stack_node *node = pS->_top;
-	int result = *(int*)node->_data;
-
-	pS->_top = node->_lower;
-	free(node->_data);
-	free(node);
-
-	pS->_stack_size -= 1;
-	return result;
+operation_result stack_fault(const stack *pS, const void *address) {
+	if (!pS || !pS->_base)
+		return OPERATION_SUCCESS;
+	uintptr_t touched = (uintptr_t) address;
+	uintptr_t base = (uintptr_t) pS->_base;
+	uintptr_t guard = (uintptr_t) page_size;
+	uintptr_t limit = base + pS->_mapped - 2 * guard;
+	if (touched < base && touched >= base - guard)
+		return OPERATION_FAILURE_STACK_UNDERFLOW;
+	if (touched >= limit && touched < limit + guard)
+		return OPERATION_FAILURE_STACK_OVERFLOW;
+	return OPERATION_SUCCESS;
 }
 
 void stack_destroy(stack *pS) {
-	while (pS->_top != NULL) {
-		stack_pop(pS);
+	if (pS->_base) {
+		pthread_mutex_lock(&pool_lock);
+		bool kept = pooled < STACK_POOL_SIZE;
+		if (kept) {
+			pool[pooled++] = pS->_base;
+		}
+		pthread_mutex_unlock(&pool_lock);
+		if (!kept) {
+			munmap((char *) pS->_base - guard_size(), pS->_mapped);
+		}
 	}
-	pS->_stack_size = 0;
+	pS->_base = NULL;
+	pS->_top = NULL;
+	pS->_mapped = 0;
 }
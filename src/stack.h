@@ -4,29 +4,36 @@
 #include <stdlib.h>
 #include "result.h"
 
-typedef struct stack_node {
-	void *_data;
-	struct stack_node *_lower;
-} stack_node;
+// Operands that fit in a stack. Beyond it a push overflows
+#define STACK_CAPACITY (1 << 20)
 
+/**
+ * Stack of int operands, mapped between two guard pages: pushing into a full
+ * stack or popping an empty one touches them and raises SIGSEGV instead of
+ * being checked, which {@link jvm_fault_run} turns into a failure. The pages
+ * of the stack are only backed by memory once they're used, and the mapping
+ * of a destroyed stack is kept for the next one created
+ */
 typedef struct stack {
 	size_t _elem_size;
-	size_t _stack_size;
-	stack_node *_top;
+	int *_base;
+	int *_top;
+	size_t _mapped;
 } stack;
 
 /**
  * Initializes the {@param pS} received as parameter
  * @pre    {@param pS} pointer to stack already allocated
  * @post   {@param pS} pointer to stack ready to be used
- * @return {@link operation_result} with the result of the operation
+ * @return {@link operation_result} with the result of the operation. Only
+ *         stacks of ints are supported
  */
 operation_result stack_create(stack *pS, size_t elem_size);
 
 /**
  * Pushes the element {@param elem} received as parameter in the {@param pS}
  * @pre    {@param pS} pointer to stack already created
- * @post   {@param elem} is added to the top stack
+ * @post   {@param elem} is added to the top stack. A full stack faults
  * @return {@link operation_result} with the result of the operation
  */
 operation_result stack_push(stack *pS, int *elem);
@@ -34,11 +41,54 @@ operation_result stack_push(stack *pS, int *elem);
 /**
  * Pops the element found in the top of {@param pS} and returns the value
  * @pre    {@param pS} pointer to stack already created
- * @post   - The top element from {@param pS} is extracted and returned
+ * @post   - The top element from {@param pS} is extracted and returned. An
+ *           empty stack faults
  * @return {@link int} with the element
  */
 int stack_pop(stack *pS);
 
+/**
+ * Returns the quantity of elements in {@param pS}
+ * @pre    {@param pS} pointer to stack already created
+ */
+size_t stack_size(const stack *pS);
+
+/**
+ * Copies the elements of {@param pS} in {@param out}, from the top to the
+ * bottom, without extracting them
+ * @pre    - {@param pS} pointer to stack already created
+ *         - {@param out} has room for {@link stack_size} elements
+ */
+void stack_elements(const stack *pS, int *out);
+
+/**
+ * Extracts all the elements of {@param pS}
+ * @pre    {@param pS} pointer to stack already created
+ */
+void stack_clear(stack *pS);
+
+/**
+ * Returns the bytes of memory that {@param pS} keeps once trimmed: the pages
+ * holding its elements
+ * @pre    {@param pS} pointer to stack already created
+ */
+size_t stack_memory(const stack *pS);
+
+/**
+ * Releases the pages of {@param pS} above its elements, which a program that
+ * went deeper left backed by memory, so it keeps only {@link stack_memory}
+ * @pre    {@param pS} pointer to stack already created
+ */
+void stack_trim(stack *pS);
+
+/**
+ * Returns the fault of touching {@param address} if it's in a guard page of
+ * {@param pS}: OPERATION_FAILURE_STACK_OVERFLOW above the stack,
+ * OPERATION_FAILURE_STACK_UNDERFLOW below it and OPERATION_SUCCESS otherwise.
+ * It's safe to call from a signal handler
+ */
+operation_result stack_fault(const stack *pS, const void *address);
+
 /**
  * Frees the memory used by the struct
  * @pre  {@param pS} pointer to stack already created